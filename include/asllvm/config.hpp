@@ -27,6 +27,92 @@ struct JitConfig
 	//!		- Modifying `mutable` variables within the class.
 	bool assume_const_is_pure : 1;
 
+	//! \brief
+	//!		Dangerous, proceed with caution.
+	//!		Allow assuming that system functions never read or write global variables declared by scripts.
+	//! \details
+	//!		This allows script globals to be kept in registers across calls to registered functions, e.g. promoting a
+	//!		global counter or accumulator out of a loop and only writing it back on loop exit or before a script call.
+	//!
+	//!		This is not a valid assumption if a system function:
+	//!		- Accesses script globals through `asIScriptModule::GetAddressOfGlobalVar` or a pointer obtained from it
+	//!		- Is passed a script global by reference, e.g. as an `&inout` parameter
+	//!		- Executes script code, e.g. through a nested context or a callback.
+	//!
+	//!		Global variables registered by the application are never affected by this.
+	bool assume_system_calls_dont_touch_script_globals : 1;
+
+	//! \brief
+	//!		Allow lowering calls to common methods of the `array` and `string` add-ons to inline code, e.g. turning
+	//!		`array<T>::opIndex` into a bounds check and a load from the array buffer.
+	//! \details
+	//!		This relies on the memory layout of `CScriptArray` and `std::string`, so this must only be enabled if the
+	//!		`array` template and `string` type are registered by the unmodified `scriptarray` and `scriptstdstring`
+	//!		add-ons. Strings are only lowered when using libstdc++.
+	bool allow_addon_intrinsics : 1;
+
+	//! \brief
+	//!		Allow replacing explicit null checks of object pointers with the first access through the pointer,
+	//!		raising the null pointer exception from a `SIGSEGV` handler instead.
+	//! \details
+	//!		This makes null checks in field accesses free when the pointer is not null, but makes a null pointer
+	//!		exception much more expensive. Only supported on Linux for x86-64 and AArch64, and ignored otherwise.
+	//!
+	//!		The JIT installs a `SIGSEGV` handler when this is enabled. Faults that do not come from generated code
+	//!		are forwarded to the handler that was installed before, so an application installing its own handler
+	//!		later must forward faults to the previous handler as well.
+	//!		This enables the `-enable-implicit-null-checks` LLVM option, which affects all code generation within the
+	//!		process.
+	bool use_implicit_null_checks : 1;
+
+	//! \brief
+	//!		Instrument generated code to count how conditional branches, `switch` jump tables and virtual calls
+	//!		behave, so that JitInterface::RecompileModule() can optimize modules for the gathered profile.
+	//! \details
+	//!		Instrumented code is slower, so modules are expected to be recompiled after a warm-up period. Recompiled
+	//!		code is never instrumented. Counters are not updated atomically, so the profile is approximate when
+	//!		scripts are executed by several threads.
+	bool instrument_for_profile : 1;
+
+	//! \brief
+	//!		Allow `asIScriptContext::Suspend()` to suspend JIT'd code, by running scripts entered from the VM on a
+	//!		stack owned by their context.
+	//! \details
+	//!		JIT'd code polls the context at function entries and loop back-edges, where it calls the line callback,
+	//!		and handles abort and suspend requests. Suspended scripts resume within the JIT'd code when the context
+	//!		is executed again.
+	//!
+	//!		Without this, line callbacks and `asIScriptContext::Abort()` still work, but a suspend request is only
+	//!		handled once the script returns to the VM. Entering scripts costs a stack switch, and each context
+	//!		reserves 8 MiB of address space for its stack, which bounds how deep scripts can recurse. Overflowing it
+	//!		crashes on a guard page.
+	bool allow_suspend : 1;
+
+	//! \brief
+	//!		Allow limiting how long JIT'd code may run through JitInterface::SetExecutionBudget(), so that runaway
+	//!		scripts, e.g. an endless `while (true)` loop, are aborted.
+	//! \details
+	//!		Loop iterations are counted at their back-edges, and calls at function entries. This is cheap enough to
+	//!		be left enabled, but is not free in tight loops and small functions, so it is disabled by default.
+	bool enforce_execution_budget : 1;
+
+	//! \brief
+	//!		Allow functions the VM is interpreting to switch to JIT'd code at their next loop iteration, e.g. a main
+	//!		loop that started before JitInterface::BuildModules() was called, or a function that left an assumption
+	//!		of recompiled code to the VM.
+	//! \details
+	//!		Functions containing loops are translated a second time, into a variant that is only entered from the
+	//!		VM at loop headers, which roughly doubles the time spent translating them.
+	bool allow_osr : 1;
+
+	//! \brief
+	//!		Generate C calling convention entry points for each JIT'd function, so that the application can call
+	//!		script functions directly rather than through `asIScriptContext::Execute()`.
+	//! \details
+	//!		Each function gets an entry point for single calls and one calling it over an array of arguments.
+	//! \see JitInterface::GetNativeEntry(), JitInterface::GetBatchEntry()
+	bool generate_native_entries : 1;
+
 	//! \brief Whether to emit a lot of diagnostics for debugging.
 	bool verbose : 1;
 
@@ -37,7 +123,47 @@ struct JitConfig
 		allow_fast_math{true},
 		allow_devirtualization{true},
 		assume_const_is_pure{false},
+		assume_system_calls_dont_touch_script_globals{false},
+		allow_addon_intrinsics{false},
+		use_implicit_null_checks{false},
+		instrument_for_profile{false},
+		allow_suspend{false},
+		enforce_execution_budget{false},
+		allow_osr{false},
+		generate_native_entries{false},
 		verbose{false} /*, allow_late_jit_compiles{true}*/
 	{}
 };
+
+//! \brief Operations that calls to registered math functions can be lowered to.
+//! \see JitInterface::SetMathIntrinsic
+enum class MathIntrinsic
+{
+	//! \brief Square root, for `float` or `double`.
+	Sqrt,
+
+	//! \brief Absolute value, for floating-point or signed integer types.
+	Abs,
+
+	//! \brief Round down to an integral value, for `float` or `double`.
+	Floor,
+
+	//! \brief Round up to an integral value, for `float` or `double`.
+	Ceil,
+
+	//! \brief Minimum of two values. For floating-point types, a NaN operand is ignored, as in `fmin`.
+	Min,
+
+	//! \brief Maximum of two values. For floating-point types, a NaN operand is ignored, as in `fmax`.
+	Max,
+
+	//! \brief Sine, for `float` or `double`.
+	Sin,
+
+	//! \brief Cosine, for `float` or `double`.
+	Cos,
+
+	//! \brief First operand raised to the power of the second, for `float` or `double`.
+	Pow
+};
 } // namespace asllvm
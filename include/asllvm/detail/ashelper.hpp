@@ -6,4 +6,50 @@ namespace asllvm::detail
 {
 asCScriptFunction* get_nonvirtual_match(const asCScriptFunction& script_function);
 
+//! \brief Find the method of the script class \p object_type that implements the interface method \p method.
+//! \returns The implementation, or `nullptr` if \p object_type does not implement the interface of \p method.
+asCScriptFunction* get_interface_implementation(const asCObjectType& object_type, const asCScriptFunction& method);
+
+//! \brief Get the index of the interface method \p method within the methods of its interface.
+//! \see runtime::InterfaceTable
+std::size_t get_interface_method_index(const asCScriptFunction& method);
+
+//! \brief
+//!		Determine whether the global variable \p property is initialized to a literal, i.e. whether its initializer
+//!		neither calls functions nor reads memory, so that running it again (e.g. through `ResetGlobalVars`) always
+//!		results in the same value.
+bool has_literal_initializer(asCGlobalProperty& property);
+
+//! \brief Methods of the standard add-ons that can be lowered to inline code rather than called.
+enum class AddonIntrinsic
+{
+	None,
+
+	//! \brief `T& array<T>::opIndex(uint)` (`CScriptArray::At`).
+	ArrayIndex,
+
+	//! \brief `uint array<T>::length()` (`CScriptArray::GetSize`).
+	ArrayLength,
+
+	//! \brief `bool array<T>::isEmpty()` (`CScriptArray::IsEmpty`).
+	ArrayIsEmpty,
+
+	//! \brief `uint8& string::opIndex(uint)` (`StringCharAt`).
+	StringIndex,
+
+	//! \brief `uint string::length()` (`StringLength`).
+	StringLength,
+
+	//! \brief `bool string::isEmpty()` (`StringIsEmpty`).
+	StringIsEmpty
+};
+
+//! \brief
+//!		Determine whether \p function is one of the methods of the `scriptarray` or `scriptstdstring` add-ons that can
+//!		be lowered to inline code.
+//! \details
+//!		The recognition is based on the type and method names, so this assumes that the `array` template and the
+//!		`string` type were registered by the unmodified add-ons.
+AddonIntrinsic get_addon_intrinsic(const asCScriptFunction& function);
+
 }
@@ -12,7 +12,9 @@
 #include <as_typeinfo.h>
 #include <as_objecttype.h>
 #include <as_scriptengine.h>
+#include <as_module.h>
 #include <as_context.h>
+#include <as_thread.h>
 #include <as_texts.h>
 // clang-format on
 #pragma GCC diagnostic pop
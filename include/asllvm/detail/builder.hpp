@@ -30,6 +30,36 @@ struct StandardTypes
 	llvm::Type *pvoid, *pi8, *pi16, *pi32, *pi64, *pf32, *pf64, *piptr;
 };
 
+//! \brief TBAA access tags for memory that generated code accesses directly.
+//! \details
+//!		Each tag describes a distinct class of storage that can never overlap with the others. Accesses through pointers
+//!		of unknown origin (e.g. script references, which may point to locals or globals) must be left untagged, so they
+//!		are treated as aliasing any of these.
+struct StandardTbaa
+{
+	//! \brief Local storage of a function, i.e. the StackFrame storage and the parameter allocas.
+	llvm::MDNode* stack;
+
+	//! \brief Value register of a function.
+	llvm::MDNode* value_register;
+
+	//! \brief Object register of a function.
+	llvm::MDNode* object_register;
+
+	//! \brief Script or application global variables accessed through their known address.
+	llvm::MDNode* global;
+};
+
+//! \brief Alias scopes for memory that generated code accesses directly.
+//! \details
+//!		Accesses are tagged with `!alias.scope` lists and calls known not to access that memory with `!noalias` lists,
+//!		which lets the optimizer keep values in registers across such calls.
+struct StandardAliasScopes
+{
+	//! \brief Global variables declared by script modules.
+	llvm::MDNode* script_globals;
+};
+
 class Builder
 {
 	public:
@@ -37,13 +67,17 @@ class Builder
 
 	llvm::IRBuilder<>&            ir() { return m_ir_builder; }
 	StandardTypes&                standard_types() { return m_types; }
+	StandardTbaa&                 tbaa() { return m_tbaa; }
+	StandardAliasScopes&          alias_scopes() { return m_alias_scopes; }
 	llvm::legacy::PassManager&    optimizer() { return m_pass_manager; }
 	llvm::orc::ThreadSafeContext& llvm_context() { return m_context; }
 
 	llvm::Type* to_llvm_type(const asCDataType& type) const;
 
 	private:
-	StandardTypes setup_standard_types();
+	StandardTypes       setup_standard_types();
+	StandardTbaa        setup_tbaa();
+	StandardAliasScopes setup_alias_scopes();
 
 	std::unique_ptr<llvm::LLVMContext> setup_context();
 	llvm::legacy::PassManager          setup_pass_manager();
@@ -54,7 +88,9 @@ class Builder
 	llvm::legacy::PassManager    m_pass_manager;
 	llvm::IRBuilder<>            m_ir_builder;
 
-	StandardTypes m_types;
+	StandardTypes       m_types;
+	StandardTbaa        m_tbaa;
+	StandardAliasScopes m_alias_scopes;
 
 	mutable std::map<int, llvm::StructType*> m_object_types;
 };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <vector>
+
+namespace asllvm::detail
+{
+//! \brief Whether the host supports implicit null checks, i.e. whether a fault handler is available for it.
+bool are_implicit_null_checks_supported();
+
+//! \brief Install the SIGSEGV handler resuming faulting accesses of generated code at their null check handler.
+//! \details
+//!		Faults that do not come from an instruction registered through a FaultMapListener are forwarded to the
+//!		handler that was installed previously. Installing the handler more than once has no effect.
+void install_fault_handler();
+
+//! \brief
+//!		Registers the LLVM fault map sections (`.llvm_faultmaps`) of the objects loaded by the JIT, and unregisters
+//!		them once the memory of their object is freed, as it may be reused by other code.
+class FaultMapListener final : public llvm::JITEventListener
+{
+	public:
+	//! \brief Register the fault maps of the objects loaded since the last call, once they were linked.
+	void register_pending_fault_maps();
+
+	void notifyObjectLoaded(
+		ObjectKey                                  key,
+		const llvm::object::ObjectFile&            object,
+		const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+
+	void notifyFreeingObject(ObjectKey key) override;
+
+	private:
+	struct PendingFaultMap
+	{
+		ObjectKey                    key;
+		llvm::ArrayRef<std::uint8_t> fault_map;
+	};
+
+	//! \brief Fault map sections of loaded objects, registered once the objects were relocated.
+	std::vector<PendingFaultMap> m_pending_fault_maps;
+};
+} // namespace asllvm::detail
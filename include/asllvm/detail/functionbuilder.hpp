@@ -5,12 +5,17 @@
 #include <asllvm/detail/bytecodeinstruction.hpp>
 #include <asllvm/detail/fwd.hpp>
 #include <asllvm/detail/stackframe.hpp>
+#include <asllvm/detail/vmstate.hpp>
+#include <cstdint>
 #include <functional>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instructions.h>
 #include <map>
+#include <set>
 #include <string_view>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace asllvm::detail
@@ -21,17 +26,74 @@ class FunctionBuilder
 	{
 		long current_switch_offset;
 		bool handling_jump_table = false;
+
+		//! \brief Offsets of the asBC_JitEntry instructions.
+		std::set<long> jit_entries;
+
+		//! \brief Offsets of the headers of loops, along with the offset of their back-edge.
+		std::vector<std::pair<long, long>> loops;
 	};
 
 	enum class GeneratedFunctionType
 	{
 		Implementation,
-		VmEntryThunk
+		VmEntryThunk,
+		NativeEntry,
+		BatchEntry
 	};
 
 	struct VmEntryCallContext
 	{
 		llvm::Value *vm_frame_pointer = nullptr, *value_register = nullptr, *object_register = nullptr;
+
+		//! \brief Function to call instead of the translated script function, e.g. its OSR variant.
+		llvm::Function* target = nullptr;
+	};
+
+	//! \brief Arguments of a call to a function only known at runtime, popped from the stack.
+	struct FunctionPointerArguments
+	{
+		//! \brief Arguments as passed to a script function of the called signature.
+		std::vector<llvm::Value*> values;
+
+		//! \brief Pointer to the arguments as laid out on the VM stack, for calls going through the VM.
+		llvm::Value* vm_arguments = nullptr;
+
+		//! \brief Index where the object of a delegate is inserted within \ref values.
+		std::size_t object_index = 0;
+	};
+
+	//! \brief An object of the stack frame, as its stack offset and its type.
+	using FrameObject = std::pair<StackFrame::AsStackOffset, const asCTypeInfo*>;
+
+	//! \brief Where an exception raised at a given bytecode offset goes, and the objects it releases on the way.
+	//! \see get_exception_handler()
+	struct ExceptionHandler
+	{
+		//! \brief Bytecode offset of the catch block catching the exception, or `-1` if it leaves the function.
+		long catch_offset = -1;
+
+		//! \brief Variables and parameters holding a pointer to an object they own, or null.
+		std::vector<FrameObject> heap_objects;
+
+		//! \brief Value objects allocated within the stack frame that are alive.
+		std::vector<FrameObject> stack_objects;
+
+		//! \brief
+		//!		Objects declared before the try block, which are only released when the catch block does not catch
+		//!		the exception, e.g. when the script is aborted.
+		std::vector<FrameObject> uncaught_heap_objects, uncaught_stack_objects;
+
+		bool operator<(const ExceptionHandler& other) const
+		{
+			return std::tie(catch_offset, heap_objects, stack_objects, uncaught_heap_objects, uncaught_stack_objects)
+				   < std::tie(
+					   other.catch_offset,
+					   other.heap_objects,
+					   other.stack_objects,
+					   other.uncaught_heap_objects,
+					   other.uncaught_stack_objects);
+		}
 	};
 
 	public:
@@ -46,15 +108,53 @@ class FunctionBuilder
 	//!		Depending on the size of the first parameter, the offset of the first local value might be higher than 1.
 	using StackVariableIdentifier = std::int16_t;
 
-	// TODO: exceptions should make more sense than just a std::runtime_error
 	//! \brief Generates the LLVM IR for _an entire function_ given its AngelScript bytecode.
+	//! \throws UnsupportedFeature
+	//!		If the function cannot be translated, in which case the body of the function is left empty, so that
+	//!		create_interpreter_stub() can fill it.
 	llvm::Function* translate_bytecode(asDWORD* bytecode, asUINT length);
 
+	//! \brief Implement the function by calling into the VM, as a nested call of the executing context.
+	//! \details
+	//!		This lets JIT'd code call functions that could not be translated, which are left to the VM. Functions
+	//!		returning a value type on the stack are not supported.
+	llvm::Function* create_interpreter_stub();
+
+	//! \brief Whether the translated function has loops the VM can switch to JIT'd code at.
+	//! \see translate_osr_entries()
+	bool has_osr_entries() const;
+
+	//! \brief
+	//!		Generates the LLVM IR of the on-stack replacement variant of the function, which the VM enters at the
+	//!		header of a loop it was interpreting.
+	//! \details
+	//!		The variant reads the locals from the VM frame and continues at the loop header the VM reached, as told
+	//!		by the program pointer. The code before the first loop is unreachable and left out. The variant never
+	//!		speculates, so that a frame left to the VM by emit_deoptimization() does not bounce between both.
+	llvm::Function* translate_osr_entries(asDWORD* bytecode, asUINT length);
+
 	//! \brief Generates a function of asJITFunction signature.
 	//! \details
 	//!		This interacts with the VM registers in order to dispatch the call to the function generated by
-	//!		read_bytecode() and return to the VM cleanly.
-	llvm::Function* create_vm_entry_thunk();
+	//!		read_bytecode() and return to the VM cleanly. When the VM enters the function at a loop header rather
+	//!		than at its start, \p osr_function is called instead.
+	llvm::Function* create_vm_entry_thunk(llvm::Function* osr_function = nullptr);
+
+	//! \brief Generates the C calling convention entry point the application calls the function through.
+	//! \details
+	//!		This lets the context look like it is executing the function for the duration of the call, see
+	//!		runtime::enter_native_call(), but skips the VM and its stack entirely.
+	//! \returns The entry point, or `nullptr` if objects are passed or returned by value, which is not supported.
+	//! \see JitInterface::GetNativeEntry()
+	llvm::Function* create_native_entry();
+
+	//! \brief Generates the C calling convention entry point calling the function once per element of an array.
+	//! \details
+	//!		The context is entered and left once for the whole batch, and the loop calling the function is generated
+	//!		along with it, so that LLVM can inline the function into it and optimize across iterations.
+	//! \returns The entry point, or `nullptr` if the function has no native entry point.
+	//! \see JitInterface::GetBatchEntry(), create_native_entry()
+	llvm::Function* create_batch_entry();
 
 	private:
 	//! \brief Handle a given bytecode instruction for preprocessing.
@@ -88,6 +188,11 @@ class FunctionBuilder
 		llvm::Type*                source_type,
 		llvm::Type*                destination_type);
 
+	//! \brief
+	//!		Emit a division or remainder binary operation, raising the exceptions the VM raises on division by zero and
+	//!		on signed overflow (`INT_MIN / -1`).
+	void emit_divmod(BytecodeInstruction instruction, llvm::Instruction::BinaryOps op, llvm::Type* type);
+
 	//! \brief Implements an stack arithmetic instruction \p op with of type \p type.
 	//! \details LHS and RHS will be determined from the stack.
 	void emit_binop(BytecodeInstruction instruction, llvm::Instruction::BinaryOps op, llvm::Type* type);
@@ -100,6 +205,14 @@ class FunctionBuilder
 	void
 	emit_binop(BytecodeInstruction instruction, llvm::Instruction::BinaryOps op, llvm::Value* lhs, llvm::Value* rhs);
 
+	//! \brief Emit code for integer `asBC_POW*` instructions, raising an exception on overflow as the VM does.
+	void emit_integer_pow(BytecodeInstruction instruction, llvm::IntegerType* type, bool is_signed);
+
+	//! \brief
+	//!		Emit code for floating-point `asBC_POW*` instructions, raising an exception on an infinite result as the VM
+	//!		does. \p exponent_type may be an integer type, for `asBC_POWdi`.
+	void emit_float_pow(BytecodeInstruction instruction, llvm::Type* type, llvm::Type* exponent_type);
+
 	void emit_neg(BytecodeInstruction instruction, llvm::Type* type);
 	void emit_bit_not(BytecodeInstruction instruction, llvm::Type* type);
 	void emit_condition(llvm::CmpInst::Predicate pred);
@@ -117,25 +230,174 @@ class FunctionBuilder
 	//! \brief Performs the call to a non-script function \p function with parameters read from the stack.
 	void emit_system_call(const asCScriptFunction& function);
 
+	//! \brief
+	//!		Emit inline code for a call to a recognized add-on method \p function, if allowed by
+	//!		JitConfig::allow_addon_intrinsics.
+	//! \param object The already null-checked `this` pointer.
+	//! \param args The arguments, as they would be passed to the system function.
+	//! \returns The return value of the method, or `nullptr` if the call was not lowered and nothing was emitted.
+	llvm::Value*
+	emit_addon_intrinsic(const asCScriptFunction& function, llvm::Value* object, const std::vector<llvm::Value*>& args);
+
+	//! \brief
+	//!		Emit an LLVM intrinsic for a call to \p function, if it was mapped to a MathIntrinsic and its signature
+	//!		suits it.
+	//! \returns The return value of the call, or `nullptr` if the call was not lowered and nothing was emitted.
+	llvm::Value* emit_math_intrinsic(
+		const asCScriptFunction& function, llvm::FunctionType* callee_type, const std::vector<llvm::Value*>& args);
+
 	//! \brief Performs the call to the \p callee script function reading from the currently translated function.
 	//! \returns The amount of DWORDs read.
 	std::size_t emit_script_call(const asCScriptFunction& callee);
 
 	// TODO: seems like this could be moved elsewhere? move vmentry codegen somewhere else?
 	//! \brief Performs the call to the \p callee script function for a vm entry.
+	//! \details
+	//!		If \p is_tail_position is true and the call is compatible with the current function as per
+	//!		is_tail_call_compatible(), the call is emitted as a guaranteed tail call returning from the current
+	//!		function, and the following instructions are emitted into an unreachable block.
 	//! \returns The amount of DWORDs read.
-	std::size_t emit_script_call(const asCScriptFunction& callee, VmEntryCallContext ctx);
+	std::size_t
+	emit_script_call(const asCScriptFunction& callee, VmEntryCallContext ctx, bool is_tail_position = false);
+
+	//! \brief
+	//!		Whether \p ins is only followed by the `asBC_RET` instruction, i.e. whether a call at \p ins is in tail
+	//!		position.
+	bool is_followed_by_return(BytecodeInstruction ins) const;
+
+	//! \brief Whether a call to \p callee can be turned into a tail call from the current function.
+	//! \details
+	//!		The return value must be passed the same way, and no parameter may refer to the frame of the current
+	//!		function, as it is released by a tail call.
+	bool is_tail_call_compatible(const asCScriptFunction& callee) const;
 
 	//! \brief Performs the call to a script or system function \p function.
 	void emit_call(const asCScriptFunction& function);
 
+	//! \brief Get the funcdef of the function pointer stored in the \p variable of the current function.
+	//! \returns The funcdef, or `nullptr` if \p variable is not a known function pointer variable.
+	const asCScriptFunction* get_function_pointer_signature(StackVariableIdentifier variable) const;
+
+	//! \brief
+	//!		Performs the call to the function pointer \p function_pointer of type \p signature, reading the
+	//!		parameters from the stack.
+	//! \details
+	//!		Script functions are called directly through their JIT'd implementation, which is cached per call site.
+	//!		When recompiling, a call site that nearly always calls the same script function calls it directly under a
+	//!		guard, so it may get inlined. Delegates are resolved on every call, and system functions are called
+	//!		through the VM.
+	void emit_function_pointer_call(const asCScriptFunction& signature, llvm::Value* function_pointer);
+
+	//! \brief Performs the call to the imported function \p function_id, i.e. `asBC_CALLBND`.
+	//! \details
+	//!		If the import is already bound to a script function, the call is a direct call to it, guarded by a check
+	//!		that the import was not bound to another function since. Otherwise, the bound function is resolved at
+	//!		runtime and called like a function pointer.
+	void emit_imported_call(int function_id);
+
+	//! \brief Pop the arguments of a call to a function of type \p signature, for calls resolved at runtime.
+	FunctionPointerArguments pop_function_pointer_arguments(const asCScriptFunction& signature);
+
+	//! \brief Call \p function_pointer, of type \p signature, going through the cache of the call site.
+	//! \returns The returned VM state.
+	llvm::Value* emit_function_pointer_dispatch(
+		const asCScriptFunction& signature, llvm::Value* function_pointer, const FunctionPointerArguments& args);
+
+	//! \brief
+	//!		Call the script function \p target directly if the i1 \p condition is true, or emit the call returned by
+	//!		\p emit_fallback otherwise.
+	//! \param weights Branch weights of the condition.
+	//! \param args The arguments, cast as needed to the parameter types of \p target.
+	//! \param emit_fallback
+	//!		Emits the fallback call and returns its VM state, or returns `nullptr` if it left the function instead,
+	//!		e.g. through emit_deoptimization().
+	//! \returns The VM state returned by either call.
+	llvm::Value* emit_guarded_script_call(
+		llvm::Value*                         condition,
+		llvm::MDNode*                        weights,
+		const asCScriptFunction&             target,
+		const std::vector<llvm::Value*>&     args,
+		const std::function<llvm::Value*()>& emit_fallback);
+
 	//! \brief Match for asCScriptEngine::CallObjectMethod, for lack of a better name.
 	void emit_object_method_call(const asCScriptFunction& function, llvm::Value* object);
 
 	void emit_conditional_branch(BytecodeInstruction ins, llvm::CmpInst::Predicate predicate);
 
+	//! \brief Branch to the target of \p ins if the i1 \p condition is true, or to the next instruction otherwise.
+	//! \details
+	//!		Instrumented code counts how often the branch is taken. When recompiling, these counts are used as branch
+	//!		weights.
+	void emit_branch_if(BytecodeInstruction ins, llvm::Value* condition);
+
 	llvm::Value* resolve_virtual_script_function(llvm::Value* script_object, const asCScriptFunction& callee);
 
+	//! \brief Resolve the implementation of the interface method \p callee for the non-null \p script_object.
+	//! \details
+	//!		Compares the class of the object against an inline cache of the call site, which is filled on the first
+	//!		miss from the interface tables of the class, see ModuleBuilder::build_dispatch_tables().
+	llvm::Value* resolve_interface_method(llvm::Value* script_object, const asCScriptFunction& callee);
+
+	//! \brief
+	//!		Cast the handle referenced by the top of the stack to the script class or interface \p target, i.e.
+	//!		`asBC_Cast`, storing it to the object register on success.
+	//! \details
+	//!		The class of the object is compared inline against \p target and against the last class the cast succeeded
+	//!		for at this site. Other classes are checked at runtime against the supertypes of the class, which takes
+	//!		constant time for class targets.
+	void emit_script_object_cast(const asCObjectType& target);
+
+	//! \brief
+	//!		Call \p resolved_function, the resolved implementation of the virtual \p callee, directly if the profile
+	//!		shows it nearly always resolves to the same function.
+	//! \details
+	//!		The direct call is guarded by a comparison against \p resolved_function, with an indirect fallback. When
+	//!		the profile only ever saw one receiver, the fallback leaves the function to the VM instead, see
+	//!		emit_deoptimization(), unless that already happened at this site.
+	//! \param call_stack_pointer The stack pointer before the arguments of the call were popped.
+	//! \returns The returned VM state, or `nullptr` if there was no suitable receiver and nothing was emitted.
+	llvm::Value* emit_guarded_direct_call(
+		const asCScriptFunction&         callee,
+		llvm::FunctionType*              callee_type,
+		llvm::Value*                     resolved_function,
+		const std::vector<llvm::Value*>& args,
+		StackFrame::AsStackOffset        call_stack_pointer);
+
+	//! \brief Whether the frame can be copied between the VM and JIT'd code, as it holds no value object.
+	bool has_relocatable_frame() const;
+
+	//! \brief Whether the function can be called with the C calling convention, see create_native_entry().
+	//! \details
+	//!		Objects passed by value are owned by the callee, and the VM returns value types on its stack, neither of
+	//!		which has a C equivalent.
+	bool has_native_signature() const;
+
+	//! \brief Whether the frame of the function can be resumed in the VM, see emit_deoptimization().
+	//! \details
+	//!		The frame must be relocatable, and functions returning on the stack are not supported, as the VM entry
+	//!		point would have to return the value.
+	bool can_deoptimize() const;
+
+	//! \brief
+	//!		Fill \p block, which the OSR variant of the function starts with, so that it copies the locals from the
+	//!		VM frame and jumps to the loop header the VM is at within \p bytecode.
+	//! \see translate_osr_entries()
+	void emit_osr_dispatch(llvm::BasicBlock* block, const asDWORD* bytecode);
+
+	//! \brief Leave the function to the VM, which resumes it at the current instruction, and return its VM state.
+	//! \details
+	//!		Used when an assumption the code was specialized for does not hold. The locals and the stack up to
+	//!		\p stack_pointer are copied to a VM frame of a nested execution of the context, which then owns the
+	//!		objects they refer to. \p counter is incremented, so that recompiling drops the assumption.
+	//! \see runtime::deoptimize(), runtime::resume_deoptimized()
+	void emit_deoptimization(StackFrame::AsStackOffset stack_pointer, std::uint64_t& counter);
+
+	//! \brief Get a pointer to the \p counter of instrumented code.
+	llvm::Value* get_profile_counter_pointer(std::uint64_t& counter);
+
+	//! \brief Emit an increment of the 64-bit counter at \p counter by the i64 \p amount.
+	void emit_profile_counter_increment(llvm::Value* counter, llvm::Value* amount);
+
 	//! \brief Store \p value into the value register.
 	//! \details
 	//!		Any data can be stored in the value register as long as it is less than 64-bit, otherwise, UB will occur.
@@ -150,6 +412,15 @@ class FunctionBuilder
 	//!		required.
 	llvm::Value* get_value_register_pointer(llvm::Type* type);
 
+	//! \brief Load the `asCObjectType*` of the non-null script object \p script_object as a `void*`.
+	llvm::Value* load_script_object_type(llvm::Value* script_object);
+
+	//! \brief Store \p value into the object register.
+	void store_object_register_value(llvm::Value* value);
+
+	//! \brief Load the object register as a `void*`.
+	llvm::Value* load_object_register_value();
+
 	//! \brief Insert a basic block at bytecode offset \p offset.
 	void insert_label(long offset);
 
@@ -176,17 +447,91 @@ class FunctionBuilder
 
 	void create_function_debug_info(llvm::Function* function, GeneratedFunctionType type);
 
+	//! \brief Load the global variable at \p address as \p type, or fold it if it is a known constant.
 	llvm::Value* load_global(asPWORD address, llvm::Type* type);
+	void         store_global(asPWORD address, llvm::Value* value);
+
+	//! \brief Get a pointer of type `type->getPointerTo()` to the global variable at \p address.
+	llvm::Value* get_global_pointer(asPWORD address, llvm::Type* type);
+
+	//! \brief
+	//!		Mark \p call as not accessing script globals, if allowed by
+	//!		JitConfig::assume_system_calls_dont_touch_script_globals.
+	void mark_no_script_global_access(llvm::CallInst* call);
+
+	//! \brief Tag \p instruction as accessing the script global at \p address, if it is one.
+	void mark_script_global_access(llvm::Instruction* instruction, asPWORD address);
 
 	//! \brief
 	//!		If i1 value is true, then the state_if_true vm state will be set.
-	void emit_check_boolean(llvm::Value* value, llvm::Value* state_if_true);
+	//! \details
+	//!		The branch is marked as unlikely. In script functions, it goes to the handler of the current
+	//!		instruction, which is shared by all the checks releasing the same objects and going to the same catch
+	//!		block, if any. Nothing is emitted if \p value is known to be false.
+	//! \returns The conditional branch of the check, or `nullptr` if nothing was emitted.
+	llvm::BranchInst* emit_check_boolean(llvm::Value* value, llvm::Value* state_if_true);
+
+	//! \brief Shorthand for emit_check_boolean() with a known \p state.
+	llvm::BranchInst* emit_check_exception(llvm::Value* condition, VmState state);
+
+	//! \brief Determine how an exception raised by the instruction at \p offset is handled, as the VM would.
+	//! \details
+	//!		This is decided at compile time from the try blocks and the object variable information of the
+	//!		function, so that code which does not raise exceptions does not do any bookkeeping.
+	ExceptionHandler get_exception_handler(long offset) const;
+
+	//! \brief Parameters of the current function passed by value that hold an object, which the function owns.
+	std::vector<FrameObject> get_object_parameters() const;
 
+	//! \brief
+	//!		Get the state phi of the cold block implementing \p handler, creating it if necessary. Branches to its
+	//!		parent block must add an incoming value.
+	llvm::PHINode* get_exception_handler_state(const ExceptionHandler& handler);
+
+	//! \brief
+	//!		Release the object of type \p type at \p offset in the stack frame, as the VM does when unwinding.
+	//! \param is_on_heap
+	//!		Whether the frame holds a pointer to the object, which may be null, rather than the object itself.
+	void emit_release_frame_object(StackFrame::AsStackOffset offset, const asCTypeInfo& type, bool is_on_heap);
+
+	//! \brief
+	//!		Raise a null pointer exception if \p pointer is null.
+	//!		With JitConfig::use_implicit_null_checks, the check may be folded into the next access through it.
 	void emit_check_null_pointer(llvm::Value* pointer);
 	void emit_check_vm_state(llvm::Value* state); // TODO: better naming for this one <-
 	void emit_check_context_state();
 	void emit_vm_exception_return(llvm::Value* state);
 
+	//! \brief
+	//!		Poll the context for a line callback, suspend or abort request, handling it if there is one.
+	//!		\p bytecode is the instruction the VM would report the script to be at.
+	//! \details
+	//!		This is a single load and branch when nothing is requested. Safepoints are placed at the entry of
+	//!		functions and at loop back-edges, rather than at every line cue like the VM does.
+	void emit_safepoint(const asDWORD* bytecode);
+
+	//! \brief Emit a safepoint for the loop back-edge at \p bytecode, and consume the execution budget if enforced.
+	//! \details
+	//!		Iterations are counted within the frame, and only reported to the context once per
+	//!		\ref runtime::execution_budget_batch_size iterations.
+	void emit_back_edge(const asDWORD* bytecode);
+
+	//! \brief Load the current epoch of call site caches, which only hit when filled during that epoch.
+	//! \see runtime::call_site_cache_epoch
+	llvm::Value* load_call_site_cache_epoch();
+
+	//! \brief
+	//!		Emit whether no function was discarded since this was built, i.e. whether the addresses and IDs of
+	//!		functions seen while building still refer to the same functions.
+	//! \see runtime::function_discard_epoch
+	llvm::Value* emit_is_discard_epoch_current();
+
+	//! \brief
+	//!		Count the entry of the function against the execution budget, if it is enforced, in the counter of the
+	//!		context within runtime::function_entry_counters.
+	//! \see runtime::charge_function_entry()
+	void emit_function_entry_budget();
+
 	FunctionContext m_context;
 
 	//! \brief Kind of the function being generated right now.
@@ -211,6 +556,44 @@ class FunctionBuilder
 	//! \see InstructionContext::offset
 	std::map<long, std::vector<llvm::BasicBlock*>> m_switch_map;
 
+	//! \brief State phis of the handler blocks created so far.
+	//! \see get_exception_handler_state()
+	std::map<ExceptionHandler, llvm::PHINode*> m_exception_handlers;
+
+	//! \brief Counters updated by the generated code, or `nullptr` if it is not instrumented.
+	FunctionProfile* m_instrumentation = nullptr;
+
+	//! \brief Profile the generated code is optimized for, or `nullptr` if there is none.
+	const FunctionProfile* m_profile = nullptr;
+
+	//! \brief Bytecode offset of the instruction being translated.
+	long m_current_offset = 0;
+
+	//! \brief Registers of the context executing the function, passed as the last argument to script functions.
+	//! \see emit_safepoint()
+	llvm::Value* m_vm_registers = nullptr;
+
+	//! \brief Loop iterations left before the execution budget is consumed, or `nullptr` if it is not enforced.
+	//! \see emit_back_edge()
+	llvm::AllocaInst* m_budget_counter = nullptr;
+
+	//! \brief Whether the function may leave to the VM, so that its VM entry thunk has to resume such frames.
+	//! \see emit_deoptimization()
+	bool m_has_deoptimization_points = false;
+
+	//! \brief Whether the asBC_JitEntry the VM enters the function through was patched already.
+	bool m_has_entry_point = false;
+
+	//! \brief Offsets of the first asBC_JitEntry of each loop, where the VM may switch to the OSR variant.
+	//! \see translate_osr_entries()
+	std::set<long> m_osr_candidates;
+
+	//! \brief Blocks of the loop headers the OSR variant can be entered at, by bytecode offset.
+	std::map<long, llvm::BasicBlock*> m_osr_entries;
+
+	//! \brief Whether the OSR variant of the function is being generated.
+	bool m_is_osr_variant = false;
+
 	//! \brief Pointer to the RET instruction.
 	//! \details AngelScript bytecode functions only use RET once, we can thus assume to have only one exit point.
 	asDWORD* m_ret_pointer = nullptr;
@@ -3,13 +3,17 @@
 namespace asllvm
 {
 struct JitConfig;
+struct NativeCallState;
 class JitInterface;
 
 namespace detail
 {
 struct BytecodeInstruction;
+struct CompiledFunction;
+struct FunctionProfile;
 struct LibraryInitializer;
 struct StandardTypes;
+struct SystemFunctionBitcode;
 class JitCompiler;
 class Builder;
 class FunctionBuilder;
@@ -2,11 +2,20 @@
 
 #include <asllvm/config.hpp>
 #include <asllvm/detail/builder.hpp>
+#include <asllvm/detail/faulthandler.hpp>
 #include <asllvm/detail/modulemap.hpp>
+#include <asllvm/detail/profile.hpp>
+#include <asllvm/detail/runtime.hpp>
 #include <angelscript.h>
+#include <chrono>
 #include <llvm/ExecutionEngine/JITEventListener.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace asllvm::detail
 {
@@ -15,6 +24,25 @@ struct LibraryInitializer
 	LibraryInitializer();
 };
 
+//! \brief LLVM bitcode implementing a system function, provided by the application.
+struct SystemFunctionBitcode
+{
+	//! \brief Name of the function implementing the system function within the bitcode.
+	std::string symbol;
+
+	std::unique_ptr<llvm::MemoryBuffer> bitcode;
+};
+
+//! \brief A script function built by the JIT, which may be compiled again.
+struct CompiledFunction
+{
+	asCScriptFunction* function;
+	asJITFunction*     jit_function;
+
+	//! \brief The VM entry point that was assigned to `*jit_function`.
+	asJITFunction entry;
+};
+
 class JitCompiler
 {
 	public:
@@ -32,6 +60,42 @@ class JitCompiler
 
 	void build_modules();
 
+	int set_system_function_bitcode(
+		asIScriptFunction* function, const char* symbol, const void* bitcode, std::size_t size);
+
+	//! \brief Get the bitcode provided for the system function \p function_id, or `nullptr` if there is none.
+	const SystemFunctionBitcode* get_system_function_bitcode(int function_id) const;
+
+	int set_math_intrinsic(asIScriptFunction* function, MathIntrinsic intrinsic);
+
+	//! \brief Get the intrinsic the system function \p function maps to, either set by the application or recognized.
+	std::optional<MathIntrinsic> get_math_intrinsic(const asCScriptFunction& function) const;
+
+	int recompile_module(asIScriptModule* module);
+
+	int set_execution_budget(asIScriptContext* context, asQWORD iterations, std::chrono::nanoseconds time_limit);
+
+	void* get_native_entry(asIScriptFunction* function) const;
+	void* get_batch_entry(asIScriptFunction* function) const;
+
+	//! \brief Record that \p function was built for \p module, so that recompile_module() can build it again.
+	void register_compiled_function(asIScriptModule* module, CompiledFunction function);
+
+	//! \brief Drop the state kept for the script \p function, which is being discarded by the engine.
+	void discard_function(const asCScriptFunction& function);
+
+	//! \brief Drop the dispatch table of the script class \p object_type, which is being discarded by the engine.
+	void discard_type(const asCObjectType& object_type);
+
+	//! \brief Get the counters of the script function \p function_id for instrumented code, creating them if needed.
+	FunctionProfile& get_function_profile(int function_id);
+
+	//! \brief Get the profile gathered for the script function \p function_id, or `nullptr` if there is none.
+	const FunctionProfile* find_function_profile(int function_id) const;
+
+	//! \brief Get the dispatch table of the script class \p object_type, creating them empty if needed.
+	runtime::DispatchTable& get_dispatch_table(const asCObjectType& object_type);
+
 	private:
 	std::unique_ptr<llvm::orc::LLJIT> setup_jit();
 
@@ -43,12 +107,33 @@ class JitCompiler
 #if LLVM_USE_PERF
 	llvm::JITEventListener* m_perf_listener;
 #endif
+	//! \brief Notified by the JIT, so it must outlive it.
+	FaultMapListener                  m_fault_map_listener;
 	std::unique_ptr<llvm::orc::LLJIT> m_jit;
 
 	asCScriptEngine* m_engine = nullptr;
 	JitConfig        m_config;
 	Builder          m_builder;
 	ModuleMap        m_module_map;
+
+	std::map<int, SystemFunctionBitcode> m_system_function_bitcode;
+	std::map<int, MathIntrinsic>         m_math_intrinsics;
+
+	std::map<asIScriptModule*, std::vector<CompiledFunction>> m_compiled_functions;
+
+	//! \brief
+	//!		Profiles by script function ID. Instrumented code refers to the counters, so these are only erased once
+	//!		their function is discarded, see discard_function().
+	std::map<int, FunctionProfile> m_function_profiles;
+
+	//! \brief
+	//!		Dispatch tables by script class, which refer to these through their user data. Only erased once their
+	//!		class is discarded, see discard_type().
+	//! \see ModuleBuilder::build_dispatch_tables()
+	std::map<const asCObjectType*, runtime::DispatchTable> m_dispatch_tables;
+
+	//! \brief Number of recompiled modules, used to name the JIT dylib each recompiled module is loaded in.
+	std::size_t m_recompilation_count = 0;
 };
 
 } // namespace asllvm::detail
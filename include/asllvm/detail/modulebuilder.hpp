@@ -8,12 +8,15 @@
 #include <angelscript.h>
 #include <asllvm/detail/asinternalheaders.hpp>
 #include <asllvm/detail/fwd.hpp>
+#include <llvm/ExecutionEngine/Orc/Core.h>
 #include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/PassManager.h>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 namespace asllvm::detail
@@ -21,12 +24,24 @@ namespace asllvm::detail
 struct StandardFunctions
 {
 	llvm::FunctionCallee alloc, free, new_script_object, script_vtable_lookup, system_vtable_lookup, call_object_method,
-		panic, set_internal_exception, prepare_system_call, check_execution_status;
+		panic, set_internal_exception, prepare_system_call, check_execution_status, profiled_script_vtable_lookup,
+		resolve_function_pointer, call_system_function_pointer, profile_call_target, resolve_imported_function,
+		resolve_interface_method, cast_script_object, catch_exception, process_safepoint, run_suspendable,
+		consume_execution_budget, charge_function_entry, call_interpreted_function, deoptimize, resume_deoptimized,
+		enter_native_call, leave_native_call;
 };
 
 struct GlobalVariables
 {};
 
+struct ScriptGlobal
+{
+	//! \brief
+	//!		Whether this is a primitive `const` variable initialized to a literal, whose current value can be folded
+	//!		into generated code.
+	bool is_foldable_constant;
+};
+
 struct PendingFunction
 {
 	asCScriptFunction* function;
@@ -36,7 +51,7 @@ struct PendingFunction
 struct JitSymbol
 {
 	asCScriptFunction* script_function;
-	std::string        name, entry_name;
+	std::string        name, entry_name, native_entry_name, batch_entry_name;
 	asJITFunction*     jit_function;
 };
 
@@ -59,11 +74,49 @@ class ModuleBuilder
 	llvm::Function*     get_script_function(const asCScriptFunction& function);
 	llvm::FunctionType* get_script_function_type(const asCScriptFunction& script_function);
 
+	//! \brief Create the variant of the script \p function the VM enters at loop headers.
+	//! \see FunctionBuilder::translate_osr_entries()
+	llvm::Function* create_osr_function(const asCScriptFunction& function);
+
 	llvm::Function*     get_system_function(const asCScriptFunction& system_function);
 	llvm::FunctionType* get_system_function_type(const asCScriptFunction& system_function);
 
+	//! \brief Get the declaration of the script or application global variable stored at \p address.
+	//! \details
+	//!		The returned variable is only declared within the module and is bound to \p address by link_symbols().
+	//!		\p type is only used when creating the declaration, callers should cast the pointer as they need.
+	llvm::GlobalVariable* get_global_variable(asPWORD address, llvm::Type* type);
+
+	//! \brief
+	//!		Get the current value of the script `const` global variable at \p address, read as a \p type integer.
+	//! \returns The value as a constant, or `nullptr` if the variable is not a known constant.
+	llvm::Constant* get_constant_global_value(asPWORD address, llvm::IntegerType* type);
+
+	//! \brief Whether \p address is the address of a global variable declared by the script module.
+	bool is_script_global(asPWORD address);
+
+	//! \brief
+	//!		Get the internal function computing `base ** exponent` for an integer \p type, following the semantics of
+	//!		the VM for `asBC_POWi`-like instructions.
+	//! \details
+	//!		The function has the signature `{type, i1} (type base, type exponent)`, where the second value of the
+	//!		returned pair is whether an overflow (or a domain error) occurred, in which case the first value is 0.
+	//!		It is always inlined, so constant exponents end up being strength-reduced into multiplications.
+	llvm::Function* get_integer_pow_function(llvm::IntegerType* type, bool is_signed);
+
 	llvm::DIType* get_debug_type(ModuleDebugInfo::AsTypeIdentifier type);
 
+	//! \brief
+	//!		Build the module as a recompilation of functions that were built before, loading it into \p dylib.
+	//!		Functions are then optimized for the profile gathered so far rather than instrumented.
+	void set_recompilation(llvm::orc::JITDylib& dylib);
+
+	//! \brief Whether the generated code should be instrumented, see JitConfig::instrument_for_profile.
+	bool is_instrumented() const;
+
+	//! \brief Whether the generated code should be optimized for the gathered profile.
+	bool is_recompilation() const { return m_is_recompilation; }
+
 	void build();
 	void link();
 
@@ -83,20 +136,40 @@ class ModuleBuilder
 	StandardFunctions setup_runtime();
 	GlobalVariables   setup_global_variables();
 
+	//! \brief Get the global variables declared by the script module, collecting them on first use.
+	const std::map<asPWORD, ScriptGlobal>& script_globals();
+
+	//! \brief
+	//!		Link the application-provided \p bitcode into the module and define the system function \p declaration as
+	//!		forwarding to it. Leaves \p declaration untouched if the bitcode is not usable.
+	void link_system_function_bitcode(llvm::Function& declaration, const SystemFunctionBitcode& bitcode);
+
 	void build_functions();
 	void link_symbols();
 
-	JitCompiler&                     m_compiler;
-	asIScriptModule*                 m_script_module;
-	std::unique_ptr<llvm::Module>    m_llvm_module;
-	std::unique_ptr<llvm::DIBuilder> m_di_builder;
-	ModuleDebugInfo                  m_debug_info;
-	std::vector<PendingFunction>     m_pending_functions;
-	std::vector<JitSymbol>           m_jit_functions;
-	std::map<int, llvm::Function*>   m_script_functions;
-	std::map<int, llvm::Function*>   m_system_functions;
-	StandardFunctions                m_internal_functions;
-	GlobalVariables                  m_global_variables;
+	//! \brief Build the interface tables and the supertypes of the script classes of the module.
+	//! \see runtime::resolve_interface_method(), runtime::cast_script_object()
+	void build_dispatch_tables();
+
+	JitCompiler&                             m_compiler;
+	asIScriptModule*                         m_script_module;
+	llvm::orc::JITDylib*                     m_dylib;
+	bool                                     m_is_recompilation = false;
+	std::unique_ptr<llvm::Module>            m_llvm_module;
+	std::unique_ptr<llvm::DIBuilder>         m_di_builder;
+	ModuleDebugInfo                          m_debug_info;
+	std::vector<PendingFunction>             m_pending_functions;
+	std::vector<JitSymbol>                   m_jit_functions;
+	std::map<int, llvm::Function*>           m_script_functions;
+	std::map<int, llvm::Function*>           m_system_functions;
+	std::map<asPWORD, llvm::GlobalVariable*> m_global_variables_by_address;
+	std::map<std::pair<llvm::Type*, bool>, llvm::Function*> m_integer_pow_functions;
+	StandardFunctions                        m_internal_functions;
+	GlobalVariables                          m_global_variables;
+
+	//! \brief Global variables declared by the script module, by address.
+	//! \see script_globals()
+	std::optional<std::map<asPWORD, ScriptGlobal>> m_script_globals;
 };
 
 } // namespace asllvm::detail
@@ -9,8 +9,18 @@ namespace asllvm::detail
 std::string make_module_name(const asIScriptModule* module);
 std::string make_function_name(const asIScriptFunction& function);
 std::string make_vm_entry_thunk_name(const asIScriptFunction& function);
+std::string make_osr_function_name(const asIScriptFunction& function);
+std::string make_native_entry_name(const asIScriptFunction& function);
+std::string make_batch_entry_name(const asIScriptFunction& function);
 std::string make_system_function_name(const asIScriptFunction& function);
 std::string make_debug_name(const asIScriptFunction& function);
+std::string make_global_variable_name(asPWORD address);
 
-constexpr asPWORD vtable_userdata_identifier = 0xCAFECAFECAFECAFE;
+constexpr asPWORD vtable_userdata_identifier         = 0xCAFECAFECAFECAFE;
+constexpr asPWORD dispatch_table_userdata_identifier = 0xCAFECAFECAFEFACE;
+constexpr asPWORD execution_userdata_identifier      = 0xCAFECAFECAFEC0DE;
+constexpr asPWORD budget_userdata_identifier         = 0xCAFECAFECAFEB0D6;
+constexpr asPWORD native_entry_userdata_identifier   = 0xCAFECAFECAFE0E17;
+constexpr asPWORD batch_entry_userdata_identifier    = 0xCAFECAFECAFEBA7C;
+constexpr asPWORD compiler_userdata_identifier       = 0xCAFECAFECAFEC0C0;
 } // namespace asllvm::detail
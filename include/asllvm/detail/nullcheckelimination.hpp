@@ -0,0 +1,13 @@
+#pragma once
+
+#include <llvm/Pass.h>
+
+namespace asllvm::detail
+{
+//! \brief Create a pass folding pointer comparisons against null when the pointer is known to be non-null.
+//! \details
+//!		Null checks emitted by the function builder are often redundant: `this` was already checked by the caller,
+//!		and the same object is commonly checked several times within a function. A pointer is considered non-null when it
+//!		carries a `nonnull` or `dereferenceable` attribute, or when a dominating check or memory access proves it.
+llvm::FunctionPass* create_null_check_elimination_pass();
+} // namespace asllvm::detail
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <asllvm/detail/asinternalheaders.hpp>
+#include <array>
+#include <cstdint>
+#include <llvm/ADT/ArrayRef.h>
+#include <map>
+#include <vector>
+
+namespace asllvm::detail
+{
+//! \brief Counters of a conditional branch.
+struct BranchProfile
+{
+	std::uint64_t executions = 0;
+	std::uint64_t taken      = 0;
+};
+
+//! \brief Callees of a virtual script call site or of a function pointer call site, resolved at runtime.
+//! \details
+//!		Only JIT'd script functions are recorded as receivers, as other callees cannot be called directly. These are
+//!		forgotten when they are discarded, see forget().
+struct VirtualCallProfile
+{
+	static constexpr std::size_t max_receivers = 4;
+
+	std::array<asCScriptFunction*, max_receivers> receivers{};
+	std::array<std::uint64_t, max_receivers>      counts{};
+
+	//! \brief Calls to receivers that did not fit within \ref receivers.
+	std::uint64_t other_count = 0;
+
+	//! \brief Times code speculating on a single receiver left to the VM because another receiver was called.
+	//! \see FunctionBuilder::emit_deoptimization()
+	std::uint64_t deoptimizations = 0;
+
+	//! \brief Count a call to \p receiver.
+	void record(asCScriptFunction* receiver);
+
+	//! \brief Count the calls to \p receiver as calls to other receivers, as it is being discarded.
+	void forget(const asCScriptFunction* receiver);
+
+	//! \brief Get the receiver taking at least \p min_ratio of all calls, or `nullptr` if there is none.
+	asCScriptFunction* get_dominant_receiver(double min_ratio) const;
+
+	//! \brief Get the weights of a branch guarding for \p receiver: calls to \p receiver, then all other calls.
+	std::vector<std::uint32_t> get_guard_weights(asCScriptFunction* receiver) const;
+};
+
+//! \brief Execution counts gathered by instrumented code for a script function.
+//! \details
+//!		Counters are keyed by the bytecode offset of the instruction they belong to, so that they can be matched when
+//!		recompiling the function. Generated code refers to the counters by address, so they must never be moved.
+//!		Profiles are dropped once their function is discarded, as its ID may be reused by another function.
+//! \see JitConfig::instrument_for_profile
+struct FunctionProfile
+{
+	std::map<long, BranchProfile> branches;
+
+	//! \brief Counters of `asBC_JMPP` jump table entries. The last counter is for out of range values.
+	std::map<long, std::vector<std::uint64_t>> switches;
+
+	//! \brief Callees of virtual calls and of `asBC_CallPtr` function pointer calls.
+	std::map<long, VirtualCallProfile> virtual_calls;
+};
+
+//! \brief Scale \p counts down to 32-bit weights suitable for `!prof` branch weights, keeping their ratios.
+std::vector<std::uint32_t> to_branch_weights(llvm::ArrayRef<std::uint64_t> counts);
+} // namespace asllvm::detail
@@ -1,16 +1,186 @@
 #pragma once
 
 #include <asllvm/detail/asinternalheaders.hpp>
+#include <asllvm/detail/fwd.hpp>
+#include <asllvm/detail/profile.hpp>
 #include <asllvm/detail/vmstate.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
 
 namespace asllvm::detail::runtime
 {
+//! \brief
+//!		Incremented whenever a script function or class built by the JIT is discarded, or a module is recompiled, so
+//!		that call site and cast caches filled before miss.
+//! \details
+//!		The address of a discarded function or class may be reused by another one, and the entry of a recompiled
+//!		function changes. Caches only hit if their epoch is the current one.
+//! \see invalidate_call_site_caches()
+extern std::atomic<asUINT> call_site_cache_epoch;
+
+//! \brief
+//!		Incremented whenever a script function built by the JIT is discarded, so that code guarding on the address or
+//!		ID of a function seen while building it can tell whether these may refer to another function by now.
+//! \details Unlike \ref call_site_cache_epoch, this is not incremented by recompilations, which do not reuse either.
+extern std::atomic<asUINT> function_discard_epoch;
+
+//! \brief Per call site cache of the script function a function pointer resolves to.
+//! \details
+//!		The generated code accesses this as a `{i8*, i8*, i32}` structure. \ref function is only ever written once,
+//!		after \ref entry and \ref epoch, so that the generated code can read these without locking. Once stale, only
+//!		\ref entry and \ref epoch are refreshed, so that a call site matching \ref function always finds an entry
+//!		for it.
+//! \see FunctionBuilder::emit_function_pointer_call()
+struct FunctionPointerCache
+{
+	std::atomic<asCScriptFunction*> function;
+	std::atomic<void*>              entry;
+	std::atomic<asUINT>             epoch;
+};
+
+//! \brief Methods of a script class implementing an interface, in the order of the methods of the interface.
+//! \see get_interface_method_index()
+struct InterfaceTable
+{
+	const asCObjectType*            interface_type;
+	std::vector<asCScriptFunction*> methods;
+};
+
+//! \brief Interface tables and supertypes of a script class, looked up through the user data of the class.
+//! \see ModuleBuilder::build_dispatch_tables()
+struct DispatchTable
+{
+	std::vector<InterfaceTable> interfaces;
+
+	//! \brief The classes the class derives from, from the root of its hierarchy to the class itself.
+	//! \details A class derives from another class of depth `n` iff the `n`-th entry is that class.
+	std::vector<const asCObjectType*> supertypes;
+};
+
+//! \brief Per call site cache of the method an interface method call resolves to for a given script class.
+//! \details
+//!		Written like \ref FunctionPointerCache, so that monomorphic call sites only miss once per epoch. The class is
+//!		only ever written once.
+//! \see FunctionBuilder::resolve_interface_method()
+struct InterfaceCallCache
+{
+	std::atomic<asCObjectType*> object_type;
+	std::atomic<void*>          entry;
+	std::atomic<asUINT>         epoch;
+};
+
+//! \brief Per call site cache of the last script class a handle cast succeeded for.
+//! \details
+//!		The generated code accesses this as a `{i8*, i32}` structure. \ref epoch is written after \ref object_type,
+//!		so that a cache of the current epoch never holds a class that was discarded.
+//! \see FunctionBuilder::emit_script_object_cast()
+struct CastCache
+{
+	std::atomic<asCObjectType*> object_type;
+	std::atomic<asUINT>         epoch;
+};
+
+//! \brief Remaining execution budget of a context, looked up through its user data.
+//! \see JitCompiler::set_execution_budget()
+struct ExecutionBudget
+{
+	//! \brief Loop iterations left before the script is aborted, if they are limited.
+	std::optional<asQWORD> iterations;
+
+	//! \brief Time after which the script is aborted, if it is limited.
+	std::optional<std::chrono::steady_clock::time_point> deadline;
+};
+
+//! \brief State of a context saved by enter_native_call(), and restored by leave_native_call().
+//! \details The generated code allocates it on its stack as an opaque buffer.
+//! \see FunctionBuilder::create_native_entry()
+struct NativeCallFrame
+{
+	asEContextState    status;
+	asCScriptFunction* current_function;
+	asCScriptFunction* calling_system_function;
+	asDWORD*           program_pointer;
+};
+
+//! \brief
+//!		Number of loop iterations JIT'd code runs between two calls to consume_execution_budget(), and of function
+//!		entries it counts in a \ref FunctionEntryCounter between two.
+constexpr asUINT execution_budget_batch_size = 1024;
+
+//! \brief Function entries left to a context before it is charged a batch of its execution budget.
+//! \details
+//!		The generated code accesses it as `{i8*, i32}` with monotonic atomics. It decrements `entries_left` inline
+//!		while `registers` are those of the running context, and calls charge_function_entry() once it reaches zero
+//!		or when the counter belongs to another context.
+struct FunctionEntryCounter
+{
+	std::atomic<asSVMRegisters*> registers;
+	std::atomic<asUINT>          entries_left;
+};
+
+//! \brief Log2 of the number of \ref function_entry_counters.
+constexpr unsigned function_entry_counter_bits = 8;
+
+//! \brief
+//!		Function entry counters of contexts, indexed by get_function_entry_counter_index(). Contexts sharing a
+//!		counter take it over from each other, dropping the entries counted so far, so that budgets are only
+//!		approximate then.
+extern std::array<FunctionEntryCounter, std::size_t(1) << function_entry_counter_bits> function_entry_counters;
+
+//! \brief Index of the counter of the context owning \p registers within \ref function_entry_counters.
+//! \details
+//!		Contexts are allocated at regular intervals, which Fibonacci hashing spreads across counters.
+//!		FunctionBuilder::emit_function_entry_budget() computes the same index.
+constexpr std::size_t get_function_entry_counter_index(std::uint64_t registers)
+{
+	return std::size_t(((registers >> 4) * 0x9E3779B97F4A7C15ull) >> (64 - function_entry_counter_bits));
+}
+
 void*             script_vtable_lookup(asCScriptObject* object, asCScriptFunction* function);
+void*             profiled_script_vtable_lookup(
+	asCScriptObject* object, asCScriptFunction* function, VirtualCallProfile* profile);
 void*             system_vtable_lookup(void* object, asPWORD func);
+void*             resolve_interface_method(
+	asCScriptObject* object, asCScriptFunction* function, asUINT method_index, InterfaceCallCache* cache);
+void*             cast_script_object(
+	asCScriptObject* object, asCObjectType* target, asUINT target_depth, CastCache* cache);
+void*             resolve_function_pointer(
+	asCScriptFunction* function, void** delegate_object, FunctionPointerCache* cache);
+VmState           call_system_function_pointer(
+	asCScriptFunction* function, asDWORD* arguments, asQWORD* value_register, void** object_register);
+void              invalidate_call_site_caches();
+VmState           call_interpreted_function(
+	asSVMRegisters* registers, asCScriptFunction* function, void* object, asDWORD* arguments, void* return_value);
+VmState           deoptimize(
+	asSVMRegisters*    registers,
+	asCScriptFunction* function,
+	asUINT             offset,
+	asDWORD*           parameters,
+	asDWORD*           frame,
+	asUINT             frame_dwords,
+	asQWORD            value_register,
+	void*              return_value,
+	std::uint64_t*     counter);
+bool              resume_deoptimized(asSVMRegisters* registers, asCScriptFunction* function);
+void*             resolve_imported_function(int function_id);
+void              profile_call_target(asCScriptFunction* function, VirtualCallProfile* profile);
 void              call_object_method(void* object, asCScriptFunction* function);
 void*             new_script_object(asCObjectType* object_type);
 [[noreturn]] void panic();
 void              set_internal_exception(VmState state);
+bool              catch_exception(VmState state);
 void              prepare_system_call(asCScriptFunction* callee);
 VmState           check_execution_status();
+VmState           process_safepoint(asSVMRegisters* registers, asCScriptFunction* function, asDWORD* bytecode);
+void              run_suspendable(asSVMRegisters* registers, asPWORD argument, asJITFunction thunk);
+void              release_execution(asIScriptContext* context);
+VmState           consume_execution_budget(asSVMRegisters* registers, asUINT iterations);
+VmState           charge_function_entry(asSVMRegisters* registers);
+void              release_execution_budget(asIScriptContext* context);
+asSVMRegisters*   enter_native_call(NativeCallState* state, NativeCallFrame* frame, asCScriptFunction* function);
+void              leave_native_call(NativeCallState* state, NativeCallFrame* frame, VmState vm_state);
 } // namespace asllvm::detail::runtime
@@ -64,6 +64,8 @@ class StackFrame
 
 	llvm::AllocaInst* storage_alloca();
 
+	const std::map<AsStackOffset, Parameter>& parameters() const;
+
 	private:
 	void allocate_parameter_storage();
 	void emit_debug_info();
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdexcept>
+
+namespace asllvm::detail
+{
+//! \brief Raised while translating a function that relies on a feature the JIT does not support.
+//! \details The function is then left to the VM, see ModuleBuilder::build_functions().
+class UnsupportedFeature : public std::runtime_error
+{
+	public:
+	using std::runtime_error::runtime_error;
+};
+} // namespace asllvm::detail
@@ -8,6 +8,15 @@ enum class VmState : std::uint8_t
 {
 	Ok = 0,
 	ExceptionExternal,
-	ExceptionNullPointer
+	ExceptionNullPointer,
+	ExceptionArrayOutOfBounds,
+	ExceptionStringOutOfRange,
+	ExceptionPowOverflow,
+	ExceptionDivideByZero,
+	ExceptionDivideOverflow,
+	ExceptionUnboundFunction,
+
+	//! \brief The context was aborted, which unwinds the script without being caught by `catch` blocks.
+	Aborted
 };
 }
@@ -3,10 +3,27 @@
 #include <asllvm/config.hpp>
 #include <asllvm/detail/fwd.hpp>
 #include <angelscript.h>
+#include <chrono>
+#include <cstddef>
 #include <memory>
 
 namespace asllvm
 {
+//! \brief Execution state of a call through an entry point returned by JitInterface::GetNativeEntry().
+struct NativeCallState
+{
+	//! \brief Context the script runs on, which must be set by the application before the call.
+	asIScriptContext* context = nullptr;
+
+	//! \brief
+	//!		`asEXECUTION_FINISHED`, `asEXECUTION_EXCEPTION` or `asEXECUTION_ABORTED` after the call, as returned by
+	//!		`asIScriptContext::Execute()`, or `asEXECUTION_ERROR` if \ref context cannot run the script.
+	int status = asEXECUTION_UNINITIALIZED;
+
+	//! \brief Description of the exception if \ref status is `asEXECUTION_EXCEPTION`, `nullptr` otherwise.
+	const char* exception = nullptr;
+};
+
 class JitInterface final : public asIJITCompiler
 {
 	public:
@@ -17,6 +34,113 @@ class JitInterface final : public asIJITCompiler
 
 	void BuildModules();
 
+	//! \brief Provide the LLVM bitcode implementing the registered application function \p function.
+	//! \details
+	//!		The bitcode, e.g. produced by `clang -emit-llvm -c`, is linked into every module calling \p function.
+	//!		This allows the optimizer to inline it into script code instead of calling it through a function pointer.
+	//!		The function named \p symbol within the bitcode must have the same ABI as the registered function.
+	//!		Bitcode built with `-O0` cannot be inlined, as clang marks functions as `optnone` in that case.
+	//!		Mutable globals referenced by the bitcode are resolved to the symbols exported by the application, so the
+	//!		bitcode is ignored if it references mutable globals with internal linkage (e.g. `static` variables).
+	//!
+	//!		This must be called before the modules calling \p function are built.
+	//! \returns
+	//!		`asINVALID_ARG` if \p function is not a registered function that can be called directly (e.g. virtual
+	//!		methods and generic calling convention functions), `asSUCCESS` otherwise.
+	int
+	SetSystemFunctionBitcode(asIScriptFunction* function, const char* symbol, const void* bitcode, std::size_t size);
+
+	//! \brief Lower calls to the registered function \p function to \p intrinsic rather than calling it.
+	//! \details
+	//!		Well-known C math functions (e.g. `sqrtf`, `fabs` or `fmin`) are recognized automatically when registered
+	//!		directly. This allows mapping other functions, e.g. wrappers registered by the application.
+	//!		Note that the lowered operations do not set `errno`.
+	//! \returns
+	//!		`asINVALID_ARG` if \p function is not a registered global function, `asSUCCESS` otherwise.
+	//!		Functions whose signature does not suit \p intrinsic are called as usual.
+	int SetMathIntrinsic(asIScriptFunction* function, MathIntrinsic intrinsic);
+
+	//! \brief Compile the functions of \p module again, optimizing them for the profile gathered so far.
+	//! \details
+	//!		This requires JitConfig::instrument_for_profile. Branch and jump table counts are used as branch weights,
+	//!		which guide block layout, and virtual calls dominated by a single callee are turned into a guarded direct
+	//!		call, which may then be inlined.
+	//!
+	//!		Functions of \p module must have been built by BuildModules() before. The previous code is kept loaded,
+	//!		so this must not be called while a script of \p module is executing.
+	//! \returns
+	//!		`asINVALID_ARG` if \p module has no functions built by this JIT or if instrumentation is disabled,
+	//!		`asSUCCESS` otherwise.
+	int RecompileModule(asIScriptModule* module);
+
+	//! \brief Limit how long JIT'd code executed by \p context may run before the script is aborted.
+	//! \details
+	//!		This requires JitConfig::enforce_execution_budget. Once the script ran \p iterations loop iterations, or
+	//!		once \p time_limit elapsed since this call, it is aborted as with `asIScriptContext::Abort()`, so that
+	//!		`asIScriptContext::Execute()` returns `asEXECUTION_ABORTED`. A zero value does not limit either.
+	//!
+	//!		The budget is shared by all executions of \p context until it is set again. It is only checked every
+	//!		1024 iterations of a loop, and iterations are counted per call, so that loops iterating fewer times are
+	//!		only accounted for through the loops calling them. Calls to JIT'd functions count as iterations, so that
+	//!		runaway recursion is aborted as well, and are checked every 1024 calls made by \p context. Many contexts
+	//!		running at once may share where they count calls, making that count approximate. Code executed by the VM
+	//!		is not accounted for.
+	//! \returns
+	//!		`asINVALID_ARG` if \p context is `nullptr` or if budgets are not enforced, `asSUCCESS` otherwise.
+	int SetExecutionBudget(
+		asIScriptContext*        context,
+		asQWORD                  iterations,
+		std::chrono::nanoseconds time_limit = std::chrono::nanoseconds::zero());
+
+	//! \brief Get a C function pointer calling the JIT'd script \p function directly, without `Execute()`.
+	//! \details
+	//!		This requires JitConfig::generate_native_entries. The entry point has the signature
+	//!		`R (NativeCallState* state, [T* object,] Params... params)`, where the script types map to C++ types as
+	//!		for application functions registered with `asCALL_CDECL` (or `asCALL_CDECL_OBJFIRST` for methods):
+	//!		references and handles are pointers, and handle parameters and returned handles pass on a reference.
+	//!
+	//!		The script runs on `state->context`, which is left in the state it was in before the call. It must not
+	//!		be executing or suspended, so system functions calling back into scripts must use another context.
+	//!		Exceptions are reported through `state`, in which case the returned value must be ignored, and through
+	//!		the exception callback of the context. As for `Execute()`, a null object raises a null pointer exception.
+	//!		Suspend requests are ignored, but line callbacks, aborts and execution budgets work as for `Execute()`.
+	//!
+	//!		Functions that were not built by BuildModules(), and functions taking or returning objects by value, have
+	//!		no entry point. The entry point stays valid until the module of \p function is discarded.
+	//! \returns The entry point, or `nullptr` if \p function has none.
+	void* GetNativeEntry(asIScriptFunction* function);
+
+	//! \brief Get the entry point of \p function as a \p Signature function pointer.
+	//! \see GetNativeEntry(asIScriptFunction*)
+	template<typename Signature>
+	Signature* GetNativeEntry(asIScriptFunction* function)
+	{
+		return reinterpret_cast<Signature*>(GetNativeEntry(function));
+	}
+
+	//! \brief Get a C function pointer calling the JIT'd script \p function once for each element of an array.
+	//! \details
+	//!		This requires JitConfig::generate_native_entries. The entry point has the signature
+	//!		`asUINT (NativeCallState* state, const Arguments* arguments, R* results, asUINT count)`, where
+	//!		`Arguments` is a struct with a member per parameter, in order, preceded by the object pointer for
+	//!		methods. Types map as for GetNativeEntry(). `results` receives one value per call, and is ignored for
+	//!		`void` functions.
+	//!
+	//!		The context is entered once for the whole batch, with the same requirements as GetNativeEntry(). The
+	//!		batch stops at the first exception, which is reported through `state`.
+	//! \returns
+	//!		The entry point, or `nullptr` if \p function has no native entry point. The entry point returns the
+	//!		number of calls that completed, whose results were written.
+	void* GetBatchEntry(asIScriptFunction* function);
+
+	//! \brief Get the batch entry point of \p function as a \p Signature function pointer.
+	//! \see GetBatchEntry(asIScriptFunction*)
+	template<typename Signature>
+	Signature* GetBatchEntry(asIScriptFunction* function)
+	{
+		return reinterpret_cast<Signature*>(GetBatchEntry(function));
+	}
+
 	private:
 	std::unique_ptr<detail::JitCompiler, void (*)(detail::JitCompiler*)> m_compiler;
 };
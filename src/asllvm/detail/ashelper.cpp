@@ -1,6 +1,7 @@
 #include <asllvm/detail/ashelper.hpp>
 
 #include <string>
+#include <string_view>
 
 asCScriptFunction* asllvm::detail::get_nonvirtual_match(const asCScriptFunction& script_function)
 {
@@ -22,3 +23,137 @@ asCScriptFunction* asllvm::detail::get_nonvirtual_match(const asCScriptFunction&
 
 	return nullptr;
 }
+
+asCScriptFunction*
+asllvm::detail::get_interface_implementation(const asCObjectType& object_type, const asCScriptFunction& method)
+{
+	if (!object_type.Implements(method.objectType))
+	{
+		return nullptr;
+	}
+
+	// Like the VM does, match by signature: the virtual function table holds the most derived implementations
+	for (asUINT i = 0; i < object_type.virtualFunctionTable.GetLength(); ++i)
+	{
+		asCScriptFunction* candidate = object_type.virtualFunctionTable[i];
+		if (candidate->signatureId == method.signatureId)
+		{
+			return candidate;
+		}
+	}
+
+	return nullptr;
+}
+
+std::size_t asllvm::detail::get_interface_method_index(const asCScriptFunction& method)
+{
+	const asCObjectType& interface_type = *method.objectType;
+
+	for (asUINT i = 0; i < interface_type.methods.GetLength(); ++i)
+	{
+		if (interface_type.methods[i] == method.GetId())
+		{
+			return i;
+		}
+	}
+
+	return interface_type.methods.GetLength();
+}
+
+bool asllvm::detail::has_literal_initializer(asCGlobalProperty& property)
+{
+	const asCScriptFunction* initializer = property.GetInitFunc();
+
+	if (initializer == nullptr || initializer->scriptData == nullptr)
+	{
+		return false;
+	}
+
+	const asCArray<asDWORD>& bytecode = initializer->scriptData->byteCode;
+
+	for (asUINT offset = 0; offset < bytecode.GetLength();)
+	{
+		const asEBCInstr op = asEBCInstr(*reinterpret_cast<const asBYTE*>(&bytecode[offset]));
+
+		// Only what stores constants to the variable, anything else could depend on state that may change
+		switch (op)
+		{
+		case asBC_SUSPEND:
+		case asBC_JitEntry:
+		case asBC_SetV1:
+		case asBC_SetV2:
+		case asBC_SetV4:
+		case asBC_SetV8:
+		case asBC_CpyVtoV4:
+		case asBC_CpyVtoV8:
+		case asBC_SetG4:
+		case asBC_CpyVtoG4:
+		case asBC_LDG:
+		case asBC_WRTV1:
+		case asBC_WRTV2:
+		case asBC_WRTV4:
+		case asBC_WRTV8:
+		case asBC_RET: break;
+
+		default: return false;
+		}
+
+		offset += asBCTypeSize[asBCInfo[op].type];
+	}
+
+	return true;
+}
+
+asllvm::detail::AddonIntrinsic asllvm::detail::get_addon_intrinsic(const asCScriptFunction& function)
+{
+	if (function.objectType == nullptr)
+	{
+		return AddonIntrinsic::None;
+	}
+
+	const std::string_view type_name   = function.objectType->GetName();
+	const std::string_view method_name = function.GetName();
+	const asUINT           param_count = function.GetParamCount();
+
+	if (type_name == "array" && (function.objectType->flags & asOBJ_TEMPLATE) != 0)
+	{
+		if (method_name == "opIndex" && param_count == 1)
+		{
+			return AddonIntrinsic::ArrayIndex;
+		}
+
+		if ((method_name == "length" || method_name == "get_length" || method_name == "size") && param_count == 0)
+		{
+			return AddonIntrinsic::ArrayLength;
+		}
+
+		if ((method_name == "isEmpty" || method_name == "empty") && param_count == 0)
+		{
+			return AddonIntrinsic::ArrayIsEmpty;
+		}
+	}
+
+// The inline code for strings relies on the layout of the libstdc++ std::string
+#if defined(__GLIBCXX__) && _GLIBCXX_USE_CXX11_ABI
+	if (type_name == "string" && (function.objectType->flags & asOBJ_VALUE) != 0
+		&& function.objectType->GetSize() == sizeof(std::string))
+	{
+		if (method_name == "opIndex" && param_count == 1)
+		{
+			return AddonIntrinsic::StringIndex;
+		}
+
+		if ((method_name == "length" || method_name == "get_length" || method_name == "size") && param_count == 0)
+		{
+			return AddonIntrinsic::StringLength;
+		}
+
+		if ((method_name == "isEmpty" || method_name == "empty") && param_count == 0)
+		{
+			return AddonIntrinsic::StringIsEmpty;
+		}
+	}
+#endif
+
+	return AddonIntrinsic::None;
+}
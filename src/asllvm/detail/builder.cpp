@@ -6,8 +6,11 @@
 #include <asllvm/detail/jitcompiler.hpp>
 #include <asllvm/detail/llvmglobals.hpp>
 #include <asllvm/detail/modulecommon.hpp>
+#include <asllvm/detail/nullcheckelimination.hpp>
 #include <asllvm/detail/runtime.hpp>
+#include <asllvm/detail/unsupported.hpp>
 #include <fmt/core.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
@@ -19,7 +22,9 @@ Builder::Builder(JitCompiler& compiler) :
 	m_context{setup_context()},
 	m_pass_manager{setup_pass_manager()},
 	m_ir_builder{*m_context.getContext()},
-	m_types{setup_standard_types()}
+	m_types{setup_standard_types()},
+	m_tbaa{setup_tbaa()},
+	m_alias_scopes{setup_alias_scopes()}
 {
 	llvm::FastMathFlags fast_fp;
 
@@ -51,7 +56,7 @@ llvm::Type* Builder::to_llvm_type(const asCDataType& type) const
 		case ttUInt64: base_type = m_types.i64; break;
 		case ttFloat: base_type = m_types.f32; break;
 		case ttDouble: base_type = m_types.f64; break;
-		default: asllvm_assert(false && "provided primitive type not supported");
+		default: throw UnsupportedFeature{"provided primitive type not supported"};
 		}
 
 		if (type.IsReference())
@@ -83,7 +88,7 @@ llvm::Type* Builder::to_llvm_type(const asCDataType& type) const
 		return struct_type->getPointerTo();
 	}
 
-	asllvm_assert(false && "type not supported");
+	throw UnsupportedFeature{"type not supported"};
 }
 
 StandardTypes Builder::setup_standard_types()
@@ -131,6 +136,44 @@ StandardTypes Builder::setup_standard_types()
 	return types;
 }
 
+StandardTbaa Builder::setup_tbaa()
+{
+	StandardTbaa tbaa{};
+
+	auto            context_lock = m_context.getLock();
+	llvm::MDBuilder md{*m_context.getContext()};
+
+	llvm::MDNode* root = md.createTBAARoot("asllvm");
+
+	const auto create_tag = [&](llvm::StringRef name) {
+		llvm::MDNode* type = md.createTBAAScalarTypeNode(name, root);
+		return md.createTBAAStructTagNode(type, type, 0);
+	};
+
+	tbaa.stack           = create_tag("stack");
+	tbaa.value_register  = create_tag("value register");
+	tbaa.object_register = create_tag("object register");
+	tbaa.global          = create_tag("global");
+
+	return tbaa;
+}
+
+StandardAliasScopes Builder::setup_alias_scopes()
+{
+	StandardAliasScopes scopes{};
+
+	auto               context_lock = m_context.getLock();
+	llvm::LLVMContext& context      = *m_context.getContext();
+	llvm::MDBuilder    md{context};
+
+	llvm::MDNode* domain = md.createAnonymousAliasScopeDomain("asllvm");
+
+	// The metadata operands refer to scope lists, not to individual scopes.
+	scopes.script_globals = llvm::MDNode::get(context, {md.createAnonymousAliasScope(domain, "script globals")});
+
+	return scopes;
+}
+
 std::unique_ptr<llvm::LLVMContext> Builder::setup_context() { return std::make_unique<llvm::LLVMContext>(); }
 
 llvm::legacy::PassManager Builder::setup_pass_manager()
@@ -148,7 +191,18 @@ llvm::legacy::PassManager Builder::setup_pass_manager()
 		pmb.DisableUnrollLoops = false;
 		pmb.LoopVectorize      = true;
 		pmb.SLPVectorize       = true;
+
+		// Runs after each instcombine, including the ones following the removal of redundant stack loads
+		pmb.addExtension(
+			llvm::PassManagerBuilder::EP_Peephole,
+			[](const llvm::PassManagerBuilder&, llvm::legacy::PassManagerBase& manager) {
+				manager.add(create_null_check_elimination_pass());
+			});
+
 		pmb.populateModulePassManager(pm);
+
+		// Move the cold exception exits out of the hot paths of script functions
+		pm.add(llvm::createHotColdSplittingPass());
 		pm.add(llvm::createVerifierPass()); // Verify the optimized IR as well
 	}
 
@@ -0,0 +1,263 @@
+#include <asllvm/detail/faulthandler.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Object/ObjectFile.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if LLVM_VERSION_MAJOR >= 13
+#	include <llvm/Object/FaultMapParser.h>
+#else
+#	include <llvm/CodeGen/FaultMaps.h>
+#endif
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#	define ASLLVM_HAS_FAULT_HANDLER 1
+#	include <csignal>
+#	include <ucontext.h>
+#else
+#	define ASLLVM_HAS_FAULT_HANDLER 0
+#endif
+
+namespace asllvm::detail
+{
+namespace
+{
+struct FaultingInstruction
+{
+	std::uintptr_t faulting_pc;
+	std::uintptr_t handler_pc;
+
+	//! \brief Object the instruction was loaded from, which owns the entry.
+	llvm::JITEventListener::ObjectKey object;
+};
+
+//! \brief Faulting instructions of all generated code, sorted by address.
+using FaultTable = std::vector<FaultingInstruction>;
+
+// The table is replaced as a whole whenever entries are registered or unregistered, so that the fault handler never
+// observes a table being modified. Previous tables are retired until no fault handler may still be reading them.
+std::atomic<const FaultTable*> current_fault_table{nullptr};
+std::mutex                     fault_table_mutex;
+
+//! \brief Fault handlers running, which may read any table that was current since they started.
+std::atomic<unsigned> fault_table_readers{0};
+
+//! \brief Tables replaced while fault handlers may have been reading them, guarded by \ref fault_table_mutex.
+std::vector<std::unique_ptr<const FaultTable>> retired_fault_tables;
+
+//! \brief Make \p table the current one, and free the tables no fault handler may be reading anymore.
+//! \details Must be called with \ref fault_table_mutex held.
+void replace_fault_table(std::unique_ptr<const FaultTable> table)
+{
+	retired_fault_tables.emplace_back(current_fault_table.exchange(table.release(), std::memory_order_seq_cst));
+
+	// Handlers starting from now on only see the new table
+	if (fault_table_readers.load(std::memory_order_seq_cst) == 0)
+	{
+		retired_fault_tables.clear();
+	}
+}
+
+#if ASLLVM_HAS_FAULT_HANDLER
+struct sigaction previous_action;
+
+std::uintptr_t get_program_counter(const ucontext_t& context)
+{
+#	if defined(__x86_64__)
+	return std::uintptr_t(context.uc_mcontext.gregs[REG_RIP]);
+#	else
+	return std::uintptr_t(context.uc_mcontext.pc);
+#	endif
+}
+
+void set_program_counter(ucontext_t& context, std::uintptr_t address)
+{
+#	if defined(__x86_64__)
+	context.uc_mcontext.gregs[REG_RIP] = greg_t(address);
+#	else
+	context.uc_mcontext.pc = address;
+#	endif
+}
+
+void handle_fault(int signal_number, siginfo_t* info, void* raw_context)
+{
+	auto& context = *static_cast<ucontext_t*>(raw_context);
+
+	std::uintptr_t handler_pc = 0;
+
+	fault_table_readers.fetch_add(1, std::memory_order_seq_cst);
+	if (const FaultTable* table = current_fault_table.load(std::memory_order_seq_cst); table != nullptr)
+	{
+		const std::uintptr_t pc = get_program_counter(context);
+
+		const auto it = std::lower_bound(
+			table->begin(), table->end(), pc, [](const FaultingInstruction& instruction, std::uintptr_t address) {
+				return instruction.faulting_pc < address;
+			});
+
+		if (it != table->end() && it->faulting_pc == pc)
+		{
+			handler_pc = it->handler_pc;
+		}
+	}
+	fault_table_readers.fetch_sub(1, std::memory_order_seq_cst);
+
+	if (handler_pc != 0)
+	{
+		// Resume execution at the branch the null check would have taken
+		set_program_counter(context, handler_pc);
+		return;
+	}
+
+	if ((previous_action.sa_flags & SA_RESETHAND) != 0)
+	{
+		// Honor the one-shot handler as if it had received the signal directly
+		std::signal(signal_number, SIG_DFL);
+	}
+
+	if ((previous_action.sa_flags & SA_SIGINFO) != 0)
+	{
+		previous_action.sa_sigaction(signal_number, info, raw_context);
+	}
+	else if (previous_action.sa_handler != SIG_DFL && previous_action.sa_handler != SIG_IGN)
+	{
+		previous_action.sa_handler(signal_number);
+	}
+	else
+	{
+		// The faulting instruction is executed again once we return, and the fault is then handled by default
+		std::signal(signal_number, SIG_DFL);
+	}
+}
+#endif
+
+//! \brief Register the entries of a loaded and relocated fault map section of \p object.
+void register_fault_map(llvm::JITEventListener::ObjectKey object, llvm::ArrayRef<std::uint8_t> fault_map)
+{
+	llvm::FaultMapParser parser(fault_map.begin(), fault_map.end());
+
+	if (parser.getFaultMapVersion() != 1 || parser.getNumFunctions() == 0)
+	{
+		return;
+	}
+
+	std::lock_guard lock{fault_table_mutex};
+
+	auto table = std::make_unique<FaultTable>();
+	if (const FaultTable* previous = current_fault_table.load(std::memory_order_acquire); previous != nullptr)
+	{
+		*table = *previous;
+	}
+
+	auto function = parser.getFirstFunctionInfo();
+	for (std::uint32_t i = 0; i < parser.getNumFunctions(); ++i)
+	{
+		if (i != 0)
+		{
+			function = function.getNextFunctionInfo();
+		}
+
+		const std::uintptr_t function_address = function.getFunctionAddr();
+
+		for (std::uint32_t j = 0; j < function.getNumFaultingPCs(); ++j)
+		{
+			const auto fault = function.getFunctionFaultInfoAt(j);
+			table->push_back(
+				{function_address + fault.getFaultingPCOffset(),
+				 function_address + fault.getHandlerPCOffset(),
+				 object});
+		}
+	}
+
+	std::sort(table->begin(), table->end(), [](const FaultingInstruction& a, const FaultingInstruction& b) {
+		return a.faulting_pc < b.faulting_pc;
+	});
+
+	replace_fault_table(std::move(table));
+}
+
+//! \brief Remove the entries of \p object, whose memory is being freed.
+void unregister_fault_maps(llvm::JITEventListener::ObjectKey object)
+{
+	std::lock_guard lock{fault_table_mutex};
+
+	const FaultTable* previous = current_fault_table.load(std::memory_order_acquire);
+	if (previous == nullptr)
+	{
+		return;
+	}
+
+	auto table = std::make_unique<FaultTable>();
+	std::copy_if(
+		previous->begin(), previous->end(), std::back_inserter(*table), [&](const FaultingInstruction& instruction) {
+			return instruction.object != object;
+		});
+
+	replace_fault_table(std::move(table));
+}
+} // namespace
+
+bool are_implicit_null_checks_supported() { return ASLLVM_HAS_FAULT_HANDLER; }
+
+void install_fault_handler()
+{
+#if ASLLVM_HAS_FAULT_HANDLER
+	static const bool installed = [] {
+		struct sigaction action = {};
+		action.sa_sigaction     = handle_fault;
+		action.sa_flags         = SA_SIGINFO | SA_ONSTACK;
+		sigemptyset(&action.sa_mask);
+
+		return sigaction(SIGSEGV, &action, &previous_action) == 0;
+	}();
+
+	(void)installed;
+#endif
+}
+
+void FaultMapListener::register_pending_fault_maps()
+{
+	for (const PendingFaultMap& pending : m_pending_fault_maps)
+	{
+		register_fault_map(pending.key, pending.fault_map);
+	}
+
+	m_pending_fault_maps.clear();
+}
+
+void FaultMapListener::notifyObjectLoaded(
+	ObjectKey key, const llvm::object::ObjectFile& object, const llvm::RuntimeDyld::LoadedObjectInfo& info)
+{
+	// Emitted by codegen for implicit null checks, see JitConfig::use_implicit_null_checks
+	for (const llvm::object::SectionRef& section : object.sections())
+	{
+		if (llvm::Expected<llvm::StringRef> name = section.getName(); name && name->endswith("llvm_faultmaps"))
+		{
+			m_pending_fault_maps.push_back(
+				{key,
+				 {reinterpret_cast<const std::uint8_t*>(info.getSectionLoadAddress(section)), section.getSize()}});
+		}
+		else if (!name)
+		{
+			llvm::consumeError(name.takeError());
+		}
+	}
+}
+
+void FaultMapListener::notifyFreeingObject(ObjectKey key)
+{
+	m_pending_fault_maps.erase(
+		std::remove_if(
+			m_pending_fault_maps.begin(),
+			m_pending_fault_maps.end(),
+			[&](const PendingFaultMap& pending) { return pending.key == key; }),
+		m_pending_fault_maps.end());
+
+	unregister_fault_maps(key);
+}
+} // namespace asllvm::detail
@@ -8,8 +8,15 @@
 #include <asllvm/detail/llvmglobals.hpp>
 #include <asllvm/detail/modulebuilder.hpp>
 #include <asllvm/detail/modulecommon.hpp>
+#include <asllvm/detail/profile.hpp>
+#include <asllvm/detail/unsupported.hpp>
 #include <asllvm/detail/vmstate.hpp>
+#include <algorithm>
 #include <fmt/core.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
+#include <optional>
 
 namespace asllvm::detail
 {
@@ -26,6 +33,15 @@ llvm::Function* FunctionBuilder::translate_bytecode(asDWORD* bytecode, asUINT le
 
 	m_generated_type = GeneratedFunctionType::Implementation;
 
+	if (m_context.module_builder->is_instrumented())
+	{
+		m_instrumentation = &m_context.compiler->get_function_profile(m_context.script_function->GetId());
+	}
+	else if (m_context.module_builder->is_recompilation())
+	{
+		m_profile = m_context.compiler->find_function_profile(m_context.script_function->GetId());
+	}
+
 	ir.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", m_context.llvm_function));
 
 	const auto walk_bytecode = [&](auto&& func) {
@@ -75,11 +91,48 @@ llvm::Function* FunctionBuilder::translate_bytecode(asDWORD* bytecode, asUINT le
 			// TODO: this is a bit dumb
 			PreprocessContext context;
 			walk_bytecode([&](BytecodeInstruction instruction) { preprocess_instruction(instruction, context); });
+
+			// The VM may switch to JIT'd code at the first entry point of each loop
+			if (m_context.compiler->config().allow_osr && has_relocatable_frame())
+			{
+				for (const auto& [header, back_edge] : context.loops)
+				{
+					if (auto it = context.jit_entries.lower_bound(header);
+						it != context.jit_entries.end() && *it < back_edge)
+					{
+						m_osr_candidates.insert(*it);
+					}
+				}
+			}
+		}
+
+		for (const asSTryCatchInfo& info : m_context.script_function->scriptData->tryCatchInfo)
+		{
+			insert_label(info.catchPos);
 		}
 
 		create_function_debug_info(m_context.llvm_function, GeneratedFunctionType::Implementation);
 		emit_allocate_local_structures();
 
+		m_vm_registers = m_context.llvm_function->getArg(m_context.llvm_function->arg_size() - 1);
+		m_vm_registers->setName("vmRegisters");
+
+		ir.SetCurrentDebugLocation(get_debug_location(m_context, 0, m_context.llvm_function->getSubprogram()));
+
+		// The OSR variant is only entered at loop headers, so the code before the first loop is left unreachable
+		llvm::BasicBlock* osr_dispatch_block = nullptr;
+		if (m_is_osr_variant)
+		{
+			osr_dispatch_block = llvm::BasicBlock::Create(context, "osrDispatch", m_context.llvm_function);
+			ir.CreateBr(osr_dispatch_block);
+			ir.SetInsertPoint(llvm::BasicBlock::Create(context, "start", m_context.llvm_function));
+		}
+		else
+		{
+			emit_safepoint(bytecode);
+			emit_function_entry_budget();
+		}
+
 		walk_bytecode([&](BytecodeInstruction instruction) {
 			translate_instruction(instruction);
 
@@ -105,21 +158,111 @@ llvm::Function* FunctionBuilder::translate_bytecode(asDWORD* bytecode, asUINT le
 		});
 
 		m_stack.finalize();
+
+		if (osr_dispatch_block != nullptr)
+		{
+			emit_osr_dispatch(osr_dispatch_block, bytecode);
+		}
 	}
 	catch (std::exception& exception)
 	{
-		m_context.llvm_function->removeFromParent();
+		// Callers translated before may refer to the function, so keep its declaration
+		m_context.llvm_function->deleteBody();
 		throw;
 	}
 
 	return m_context.llvm_function;
 }
 
-llvm::Function* FunctionBuilder::create_vm_entry_thunk()
+bool FunctionBuilder::has_osr_entries() const { return !m_osr_entries.empty(); }
+
+llvm::Function* FunctionBuilder::translate_osr_entries(asDWORD* bytecode, asUINT length)
+{
+	m_is_osr_variant = true;
+	return translate_bytecode(bytecode, length);
+}
+
+llvm::Function* FunctionBuilder::create_interpreter_stub()
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+
+	llvm::orc::ThreadSafeContext& thread_safe_context = builder.llvm_context();
+	auto                          context_lock        = thread_safe_context.getLock();
+	auto&                         context             = *thread_safe_context.getContext();
+
+	const asCScriptFunction& script_function = *m_context.script_function;
+	llvm::Function&          function        = *m_context.llvm_function;
+
+	asllvm_assert(function.empty());
+
+	ir.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", &function));
+	ir.SetCurrentDebugLocation(llvm::DebugLoc());
+
+	auto argument = function.arg_begin();
+
+	// Objects returned on the stack cannot be returned by the VM, which runtime::call_interpreted_function() raises
+	llvm::Value* return_pointer = llvm::Constant::getNullValue(types.pvoid);
+	if (script_function.DoesReturnOnStack())
+	{
+		++argument;
+	}
+	else if (script_function.returnType.GetTokenType() != ttVoid)
+	{
+		return_pointer = ir.CreatePointerCast(&*argument++, types.pvoid, "returnPointer");
+	}
+
+	llvm::Value* object = llvm::Constant::getNullValue(types.pvoid);
+	if (script_function.objectType != nullptr)
+	{
+		object = ir.CreatePointerCast(&*argument++, types.pvoid, "object");
+	}
+
+	// Parameters are laid out like on the VM stack, see runtime::call_interpreted_function()
+	const int         argument_dwords = std::max(script_function.GetSpaceNeededForArguments(), 1);
+	llvm::AllocaInst* arguments
+		= ir.CreateAlloca(llvm::ArrayType::get(types.i32, argument_dwords), nullptr, "arguments");
+
+	std::size_t offset = 0;
+	for (asUINT i = 0; i < script_function.parameterTypes.GetLength(); ++i)
+	{
+		llvm::Value* dword_pointer = ir.CreateInBoundsGEP(
+			arguments, {llvm::ConstantInt::get(types.iptr, 0), llvm::ConstantInt::get(types.iptr, offset)});
+
+		// Arguments are only aligned to dwords on the VM stack
+		llvm::Value* parameter = &*argument++;
+		ir.CreateAlignedStore(
+			parameter,
+			ir.CreatePointerCast(dword_pointer, parameter->getType()->getPointerTo()),
+			llvm::MaybeAlign(4));
+
+		offset += script_function.parameterTypes[i].GetSizeOnStackDWords();
+	}
+
+	llvm::Value* registers = &*argument;
+
+	llvm::CallInst* state = ir.CreateCall(
+		funcs.call_interpreted_function,
+		{registers,
+		 ir.CreateIntToPtr(
+			 llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&script_function)), types.pvoid),
+		 object,
+		 ir.CreatePointerCast(arguments, types.pi32),
+		 return_pointer});
+
+	ir.CreateRet(state);
+
+	return &function;
+}
+
+llvm::Function* FunctionBuilder::create_vm_entry_thunk(llvm::Function* osr_function)
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
 
 	llvm::orc::ThreadSafeContext& thread_safe_context = builder.llvm_context();
 	auto                          context_lock        = thread_safe_context.getLock();
@@ -163,201 +306,641 @@ llvm::Function* FunctionBuilder::create_vm_entry_thunk()
 			registers, {llvm::ConstantInt::get(types.i64, 0), llvm::ConstantInt::get(types.i32, 4)}, "objectRegister");
 	}();
 
-	{
+	llvm::Value* program_pointer = [&] {
+		return ir.CreateInBoundsGEP(
+			registers, {llvm::ConstantInt::get(types.i64, 0), llvm::ConstantInt::get(types.i32, 0)}, "programPointer");
+	}();
+
+	const auto emit_call = [&](llvm::Function* target) {
+		m_vm_registers = registers;
+
 		VmEntryCallContext ctx;
 		ctx.vm_frame_pointer = frame_pointer;
 		ctx.value_register   = value_register;
 		ctx.object_register  = object_register;
+		ctx.target           = target;
 
 		emit_script_call(*m_context.script_function, ctx);
-	}
+	};
 
-	llvm::Value* program_pointer = [&] {
-		return ir.CreateInBoundsGEP(
-			registers, {llvm::ConstantInt::get(types.i64, 0), llvm::ConstantInt::get(types.i32, 0)}, "programPointer");
-	}();
+	llvm::BasicBlock* exit_block = nullptr;
 
-	// Set the program pointer to the RET instruction
-	auto* ret_ptr_value = ir.CreateIntToPtr(
-		llvm::ConstantInt::get(types.i64, reinterpret_cast<std::uintptr_t>(m_ret_pointer)), types.pi32);
-	ir.CreateStore(ret_ptr_value, program_pointer);
+	// The VM enters the function at a loop header when it was interpreting it, see translate_osr_entries()
+	if (osr_function != nullptr)
+	{
+		llvm::BasicBlock* osr_block  = llvm::BasicBlock::Create(context, "osrEntry", wrapper_function);
+		llvm::BasicBlock* call_block = llvm::BasicBlock::Create(context, "call", wrapper_function);
+		exit_block                   = llvm::BasicBlock::Create(context, "exit", wrapper_function);
 
-	ir.CreateRetVoid();
+		llvm::Value* is_function_entry = ir.CreateICmpEQ(
+			ir.CreateLoad(types.pi32, program_pointer),
+			ir.CreateIntToPtr(
+				llvm::ConstantInt::get(
+					types.iptr,
+					reinterpret_cast<asPWORD>(m_context.script_function->scriptData->byteCode.AddressOf())),
+				types.pi32));
 
-	return wrapper_function;
-}
+		ir.CreateCondBr(is_function_entry, call_block, osr_block, llvm::MDBuilder(context).createLikelyBranchWeights());
 
-void FunctionBuilder::preprocess_instruction(BytecodeInstruction instruction, PreprocessContext& ctx)
-{
-	switch (instruction.info->bc)
-	{
-	case asBC_JMPP:
-	{
-		ctx.current_switch_offset = instruction.offset;
-		ctx.handling_jump_table   = true;
-		break;
+		ir.SetInsertPoint(osr_block);
+		emit_call(osr_function);
+		ir.CreateBr(exit_block);
+
+		ir.SetInsertPoint(call_block);
 	}
 
-	case asBC_JMP:
+	// Frames left to the VM reenter the function here, and continue within the VM
+	if (m_has_deoptimization_points)
 	{
-		preprocess_unconditional_branch(instruction);
+		llvm::BasicBlock* resume_block = llvm::BasicBlock::Create(context, "resumeDeoptimized", wrapper_function);
+		llvm::BasicBlock* call_block   = llvm::BasicBlock::Create(context, "callTranslated", wrapper_function);
 
-		if (ctx.handling_jump_table)
-		{
-			insert_label(instruction.offset);
-			auto [it, success]      = m_switch_map.emplace(ctx.current_switch_offset, std::vector<llvm::BasicBlock*>());
-			auto& [offset, targets] = *it;
-			targets.push_back(m_jump_map.at(instruction.offset)); // TODO: map lookup is redundant here
-		}
+		llvm::Value* resumed = ir.CreateCall(
+			funcs.resume_deoptimized,
+			{registers,
+			 ir.CreateIntToPtr(
+				 llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(m_context.script_function)),
+				 types.pvoid)});
 
-		break;
+		ir.CreateCondBr(resumed, resume_block, call_block, llvm::MDBuilder(context).createUnlikelyBranchWeights());
+
+		ir.SetInsertPoint(resume_block);
+		ir.CreateRetVoid();
+
+		ir.SetInsertPoint(call_block);
 	}
 
-	case asBC_JZ:
-	case asBC_JNZ:
-	case asBC_JS:
-	case asBC_JNS:
-	case asBC_JP:
-	case asBC_JNP:
-	case asBC_JLowZ:
-	case asBC_JLowNZ:
+	emit_call(nullptr);
+
+	if (exit_block != nullptr)
 	{
-		ctx.handling_jump_table = false;
-		preprocess_conditional_branch(instruction);
-		break;
+		ir.CreateBr(exit_block);
+		ir.SetInsertPoint(exit_block);
 	}
 
-	default:
+	// Set the program pointer to the RET instruction
+	auto* ret_ptr_value = ir.CreateIntToPtr(
+		llvm::ConstantInt::get(types.i64, reinterpret_cast<std::uintptr_t>(m_ret_pointer)), types.pi32);
+	ir.CreateStore(ret_ptr_value, program_pointer);
+
+	ir.CreateRetVoid();
+
+	if (!m_context.compiler->config().allow_suspend)
 	{
-		ctx.handling_jump_table = false;
-		break;
-	}
+		return wrapper_function;
 	}
+
+	// Run the script on its own stack, which the wrapper switches back from when the script is suspended
+	const std::string entry_name = wrapper_function->getName().str();
+	wrapper_function->setName(entry_name + "!suspendable");
+	wrapper_function->setLinkage(llvm::Function::InternalLinkage);
+
+	llvm::Function* suspendable_function = llvm::Function::Create(
+		wrapper_function->getFunctionType(),
+		llvm::Function::ExternalLinkage,
+		entry_name,
+		m_context.module_builder->module());
+
+	ir.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", suspendable_function));
+	ir.SetCurrentDebugLocation(llvm::DebugLoc());
+	ir.CreateCall(
+		funcs.run_suspendable,
+		{suspendable_function->getArg(0),
+		 suspendable_function->getArg(1),
+		 ir.CreatePointerCast(wrapper_function, types.pvoid)});
+	ir.CreateRetVoid();
+
+	return suspendable_function;
 }
 
-void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
+llvm::Function* FunctionBuilder::create_native_entry()
 {
-	asCScriptEngine&   engine  = m_context.compiler->engine();
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
 	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
 
-	ir.SetCurrentDebugLocation(get_debug_location(m_context, ins.offset, m_context.llvm_function->getSubprogram()));
+	llvm::orc::ThreadSafeContext& thread_safe_context = builder.llvm_context();
+	auto                          context_lock        = thread_safe_context.getLock();
+	auto&                         context             = *thread_safe_context.getContext();
 
-	const auto old_stack_pointer = m_stack.current_stack_pointer();
+	const asCScriptFunction& script_function = *m_context.script_function;
+	llvm::Function&          callee          = *m_context.llvm_function;
 
-	if (auto it = m_jump_map.find(ins.offset); it != m_jump_map.end())
+	if (!has_native_signature())
 	{
-		asllvm_assert(m_stack.empty_stack());
-		switch_to_block(it->second);
+		return nullptr;
 	}
 
-	m_stack.check_stack_pointer_bounds();
+	// Small integers are extended by the caller, as the C ABI expects
+	const auto get_extension = [](const asCDataType& type) {
+		if (type.IsReference())
+		{
+			return llvm::Attribute::None;
+		}
 
-	const auto unimpl = [] { asllvm_assert(false && "unimplemented instruction while translating bytecode"); };
+		switch (type.GetTokenType())
+		{
+		case ttBool:
+		case ttUInt8:
+		case ttUInt16: return llvm::Attribute::ZExt;
+		case ttInt8:
+		case ttInt16: return llvm::Attribute::SExt;
+		default: return llvm::Attribute::None;
+		}
+	};
 
-	// TODO: handle division by zero by setting an exception on the context for ALL div AND rem ops
+	m_generated_type = GeneratedFunctionType::NativeEntry;
 
-	switch (ins.info->bc)
-	{
-	case asBC_PopPtr:
+	const bool  has_return  = script_function.returnType.GetTokenType() != ttVoid;
+	llvm::Type* return_type = has_return ? builder.to_llvm_type(script_function.returnType) : types.tvoid;
+
+	// The script function takes the return pointer first and the VM registers last
+	llvm::ArrayRef<llvm::Type*> script_parameters
+		= callee.getFunctionType()->params().drop_front(has_return ? 1 : 0).drop_back();
+
+	std::vector<llvm::Type*> parameter_types{types.pvoid};
+	parameter_types.insert(parameter_types.end(), script_parameters.begin(), script_parameters.end());
+
+	llvm::Function* native_function = llvm::Function::Create(
+		llvm::FunctionType::get(return_type, parameter_types, false),
+		llvm::Function::ExternalLinkage,
+		make_native_entry_name(script_function),
+		m_context.module_builder->module());
+
+	if (has_return && get_extension(script_function.returnType) != llvm::Attribute::None)
 	{
-		m_stack.pop(AS_PTR_SIZE);
-		break;
+		native_function->addAttribute(llvm::AttributeList::ReturnIndex, get_extension(script_function.returnType));
 	}
 
-	case asBC_PshGPtr:
+	// The parameters of script methods follow the object pointer
+	const unsigned first_parameter = script_function.objectType != nullptr ? 2 : 1;
+	for (asUINT i = 0; i < script_function.parameterTypes.GetLength(); ++i)
 	{
-		m_stack.push(load_global(ins.arg_pword(), types.iptr), AS_PTR_SIZE);
-		break;
+		if (const auto extension = get_extension(script_function.parameterTypes[i]); extension != llvm::Attribute::None)
+		{
+			native_function->addParamAttr(first_parameter + i, extension);
+		}
 	}
 
-	case asBC_PshC4:
+	create_function_debug_info(native_function, GeneratedFunctionType::NativeEntry);
+
+	ir.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", native_function));
+
+	llvm::Argument* state = native_function->getArg(0);
+	state->setName("state");
+
+	llvm::AllocaInst* frame = ir.CreateAlloca(
+		llvm::ArrayType::get(types.i8, sizeof(runtime::NativeCallFrame)), nullptr, "nativeCallFrame");
+	frame->setAlignment(llvm::Align(alignof(runtime::NativeCallFrame)));
+
+	llvm::AllocaInst* return_value = has_return ? ir.CreateAlloca(return_type, nullptr, "returnValue") : nullptr;
+
+	llvm::Value* registers = ir.CreateCall(
+		funcs.enter_native_call,
+		{state,
+		 ir.CreatePointerCast(frame, types.pvoid),
+		 ir.CreateIntToPtr(
+			 llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&script_function)), types.pvoid)},
+		"vmregs");
+
+	llvm::BasicBlock* error_block = llvm::BasicBlock::Create(context, "contextError", native_function);
+	llvm::BasicBlock* call_block  = llvm::BasicBlock::Create(context, "call", native_function);
+
+	ir.CreateCondBr(
+		ir.CreateIsNull(registers), error_block, call_block, llvm::MDBuilder(context).createUnlikelyBranchWeights());
+
+	ir.SetInsertPoint(error_block);
+	if (has_return)
 	{
-		m_stack.push(llvm::ConstantInt::get(types.i32, ins.arg_dword()), 1);
-		break;
+		ir.CreateRet(llvm::Constant::getNullValue(return_type));
+	}
+	else
+	{
+		ir.CreateRetVoid();
 	}
 
-	case asBC_PshV4:
+	ir.SetInsertPoint(call_block);
+
+	if (has_return)
 	{
-		m_stack.push(m_stack.load(ins.arg_sword0(), types.i32), 1);
-		break;
+		ir.CreateStore(llvm::Constant::getNullValue(return_type), return_value);
 	}
 
-	case asBC_PSF:
+	// Methods expect a non-null object, for which the host gets the exception Execute() would raise instead
+	if (script_function.objectType != nullptr)
 	{
-		m_stack.push(m_stack.pointer_to(ins.arg_sword0(), types.iptr), AS_PTR_SIZE);
-		break;
+		llvm::BasicBlock* null_block   = llvm::BasicBlock::Create(context, "nullObject", native_function);
+		llvm::BasicBlock* object_block = llvm::BasicBlock::Create(context, "objectChecked", native_function);
+
+		ir.CreateCondBr(
+			ir.CreateIsNull(native_function->getArg(1)),
+			null_block,
+			object_block,
+			llvm::MDBuilder(context).createUnlikelyBranchWeights());
+
+		ir.SetInsertPoint(null_block);
+		ir.CreateCall(
+			funcs.leave_native_call,
+			{state,
+			 ir.CreatePointerCast(frame, types.pvoid),
+			 llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::ExceptionNullPointer))});
+
+		if (has_return)
+		{
+			ir.CreateRet(ir.CreateLoad(return_type, return_value));
+		}
+		else
+		{
+			ir.CreateRetVoid();
+		}
+
+		ir.SetInsertPoint(object_block);
 	}
 
-	case asBC_SwapPtr: unimpl(); break;
+	std::vector<llvm::Value*> arguments;
 
-	case asBC_NOT:
+	if (has_return)
 	{
-		llvm::Value* source = m_stack.load(ins.arg_sword0(), types.i1);
-		llvm::Value* result
-			= ir.CreateSelect(source, llvm::ConstantInt::get(types.i32, 0), llvm::ConstantInt::get(types.i32, 1));
-		m_stack.store(ins.arg_sword0(), result);
-		break;
+		arguments.push_back(return_value);
 	}
 
-	case asBC_PshG4:
+	for (auto argument = native_function->arg_begin() + 1; argument != native_function->arg_end(); ++argument)
 	{
-		m_stack.push(load_global(ins.arg_pword(), types.i32), 1);
-		break;
+		arguments.push_back(&*argument);
 	}
 
-	case asBC_LdGRdR4: unimpl(); break;
+	arguments.push_back(registers);
 
-	case asBC_CALL:
+	llvm::CallInst* vm_state = ir.CreateCall(&callee, arguments, "vmState");
+	vm_state->setCallingConv(callee.getCallingConv());
+
+	ir.CreateCall(funcs.leave_native_call, {state, ir.CreatePointerCast(frame, types.pvoid), vm_state});
+
+	if (has_return)
 	{
-		auto& function = static_cast<asCScriptFunction&>(*engine.GetFunctionById(ins.arg_int()));
-		emit_script_call(function);
-		break;
+		ir.CreateRet(ir.CreateLoad(return_type, return_value));
 	}
-
-	case asBC_RET:
+	else
 	{
-		const asCDataType& type = m_context.script_function->returnType;
+		ir.CreateRetVoid();
+	}
 
-		if (type.GetTokenType() != ttVoid && !m_context.script_function->DoesReturnOnStack())
-		{
-			llvm::Value* return_pointer = &*(m_context.llvm_function->arg_begin() + 0);
-			llvm::Type*  llvm_type      = builder.to_llvm_type(type);
+	return native_function;
+}
 
-			if (type.IsObjectHandle() || type.IsObject())
-			{
-				ir.CreateStore(
-					ir.CreatePointerCast(ir.CreateLoad(types.pvoid, m_object_register), llvm_type), return_pointer);
-			}
-			else
-			{
-				ir.CreateStore(load_value_register_value(llvm_type), return_pointer);
-			}
-		}
+llvm::Function* FunctionBuilder::create_batch_entry()
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
 
-		ir.CreateRet(llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::Ok)));
+	llvm::orc::ThreadSafeContext& thread_safe_context = builder.llvm_context();
+	auto                          context_lock        = thread_safe_context.getLock();
+	auto&                         context             = *thread_safe_context.getContext();
 
-		m_ret_pointer = ins.pointer;
-		break;
-	}
+	const asCScriptFunction& script_function = *m_context.script_function;
+	llvm::Function&          callee          = *m_context.llvm_function;
 
-	case asBC_JMP:
+	if (!has_native_signature())
 	{
-		ir.CreateBr(get_branch_target(ins));
-		break;
+		return nullptr;
 	}
 
-	case asBC_JZ: emit_conditional_branch(ins, llvm::CmpInst::ICMP_EQ); break;
-	case asBC_JNZ: emit_conditional_branch(ins, llvm::CmpInst::ICMP_NE); break;
-	case asBC_JS: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SLT); break;
-	case asBC_JNS: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SGE); break;
-	case asBC_JP: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SGT); break;
-	case asBC_JNP: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SLE); break;
+	m_generated_type = GeneratedFunctionType::BatchEntry;
 
-	case asBC_TZ: emit_condition(llvm::CmpInst::ICMP_EQ); break;
-	case asBC_TNZ: emit_condition(llvm::CmpInst::ICMP_NE); break;
+	const bool  has_return  = script_function.returnType.GetTokenType() != ttVoid;
+	llvm::Type* return_type = has_return ? builder.to_llvm_type(script_function.returnType) : types.i8;
+
+	// Each element holds the arguments like a C struct would, the object pointer first for methods
+	llvm::StructType* arguments_type = llvm::StructType::get(
+		context, callee.getFunctionType()->params().drop_front(has_return ? 1 : 0).drop_back());
+
+	llvm::Function* batch_function = llvm::Function::Create(
+		llvm::FunctionType::get(
+			types.i32, {types.pvoid, arguments_type->getPointerTo(), return_type->getPointerTo(), types.i32}, false),
+		llvm::Function::ExternalLinkage,
+		make_batch_entry_name(script_function),
+		m_context.module_builder->module());
+
+	create_function_debug_info(batch_function, GeneratedFunctionType::BatchEntry);
+
+	llvm::Argument* state = batch_function->getArg(0);
+	state->setName("state");
+
+	llvm::Argument* arguments = batch_function->getArg(1);
+	arguments->setName("arguments");
+
+	llvm::Argument* results = batch_function->getArg(2);
+	results->setName("results");
+
+	llvm::Argument* count = batch_function->getArg(3);
+	count->setName("count");
+
+	ir.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", batch_function));
+
+	llvm::AllocaInst* frame = ir.CreateAlloca(
+		llvm::ArrayType::get(types.i8, sizeof(runtime::NativeCallFrame)), nullptr, "nativeCallFrame");
+	frame->setAlignment(llvm::Align(alignof(runtime::NativeCallFrame)));
+
+	llvm::Value* registers = ir.CreateCall(
+		funcs.enter_native_call,
+		{state,
+		 ir.CreatePointerCast(frame, types.pvoid),
+		 ir.CreateIntToPtr(
+			 llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&script_function)), types.pvoid)},
+		"vmregs");
+
+	llvm::BasicBlock* error_block = llvm::BasicBlock::Create(context, "contextError", batch_function);
+	llvm::BasicBlock* check_block = llvm::BasicBlock::Create(context, "checkEmpty", batch_function);
+	llvm::BasicBlock* loop_block  = llvm::BasicBlock::Create(context, "loop", batch_function);
+	llvm::BasicBlock* next_block  = llvm::BasicBlock::Create(context, "next", batch_function);
+	llvm::BasicBlock* exit_block  = llvm::BasicBlock::Create(context, "exit", batch_function);
+
+	ir.CreateCondBr(
+		ir.CreateIsNull(registers), error_block, check_block, llvm::MDBuilder(context).createUnlikelyBranchWeights());
+
+	ir.SetInsertPoint(error_block);
+	ir.CreateRet(llvm::ConstantInt::get(types.i32, 0));
+
+	ir.SetInsertPoint(check_block);
+	ir.CreateCondBr(ir.CreateICmpEQ(count, llvm::ConstantInt::get(types.i32, 0)), exit_block, loop_block);
+
+	ir.SetInsertPoint(loop_block);
+	llvm::PHINode* index = ir.CreatePHI(types.i32, 2, "index");
+	index->addIncoming(llvm::ConstantInt::get(types.i32, 0), check_block);
+
+	std::vector<llvm::Value*> call_arguments;
+
+	// Results are written in place, as the function writes its return value through a pointer
+	if (has_return)
+	{
+		call_arguments.push_back(ir.CreateInBoundsGEP(results, {index}, "result"));
+	}
+
+	llvm::Value* element = ir.CreateInBoundsGEP(arguments, {index}, "element");
+	for (unsigned i = 0; i < arguments_type->getNumElements(); ++i)
+	{
+		call_arguments.push_back(ir.CreateLoad(arguments_type->getElementType(i), ir.CreateStructGEP(element, i)));
+	}
+
+	call_arguments.push_back(registers);
+
+	// Like the native entry, a null object stops the batch with the exception Execute() would raise
+	llvm::BasicBlock* call_block = loop_block;
+	llvm::BasicBlock* null_block = nullptr;
+
+	if (script_function.objectType != nullptr)
+	{
+		null_block = llvm::BasicBlock::Create(context, "nullObject", batch_function);
+		call_block = llvm::BasicBlock::Create(context, "call", batch_function);
+
+		ir.CreateCondBr(
+			ir.CreateIsNull(call_arguments[has_return ? 1 : 0]),
+			null_block,
+			call_block,
+			llvm::MDBuilder(context).createUnlikelyBranchWeights());
+
+		ir.SetInsertPoint(null_block);
+		ir.CreateBr(exit_block);
+
+		ir.SetInsertPoint(call_block);
+	}
+
+	llvm::CallInst* vm_state = ir.CreateCall(&callee, call_arguments, "vmState");
+	vm_state->setCallingConv(callee.getCallingConv());
+
+	// The batch stops at the first exception, whose state is handled once the loop is left
+	ir.CreateCondBr(
+		ir.CreateICmpEQ(vm_state, llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::Ok))),
+		next_block,
+		exit_block,
+		llvm::MDBuilder(context).createLikelyBranchWeights());
+
+	ir.SetInsertPoint(next_block);
+	llvm::Value* next_index = ir.CreateAdd(index, llvm::ConstantInt::get(types.i32, 1), "nextIndex", true, true);
+	index->addIncoming(next_index, next_block);
+	ir.CreateCondBr(ir.CreateICmpULT(next_index, count), loop_block, exit_block);
+
+	ir.SetInsertPoint(exit_block);
+
+	llvm::PHINode* completed = ir.CreatePHI(types.i32, 4, "completed");
+	completed->addIncoming(llvm::ConstantInt::get(types.i32, 0), check_block);
+	completed->addIncoming(index, call_block);
+	completed->addIncoming(next_index, next_block);
+
+	llvm::PHINode* final_state = ir.CreatePHI(types.vm_state, 4, "finalState");
+	final_state->addIncoming(llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::Ok)), check_block);
+	final_state->addIncoming(vm_state, call_block);
+	final_state->addIncoming(llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::Ok)), next_block);
+
+	if (null_block != nullptr)
+	{
+		completed->addIncoming(index, null_block);
+		final_state->addIncoming(
+			llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::ExceptionNullPointer)), null_block);
+	}
+
+	ir.CreateCall(funcs.leave_native_call, {state, ir.CreatePointerCast(frame, types.pvoid), final_state});
+	ir.CreateRet(completed);
+
+	return batch_function;
+}
+
+void FunctionBuilder::preprocess_instruction(BytecodeInstruction instruction, PreprocessContext& ctx)
+{
+	switch (instruction.info->bc)
+	{
+	case asBC_JMPP:
+	{
+		ctx.current_switch_offset = instruction.offset;
+		ctx.handling_jump_table   = true;
+		break;
+	}
+
+	case asBC_JMP:
+	{
+		preprocess_unconditional_branch(instruction);
+
+		if (instruction.arg_int() < 0)
+		{
+			ctx.loops.emplace_back(instruction.offset + 2 + instruction.arg_int(), instruction.offset);
+		}
+
+		if (ctx.handling_jump_table)
+		{
+			insert_label(instruction.offset);
+			auto [it, success]      = m_switch_map.emplace(ctx.current_switch_offset, std::vector<llvm::BasicBlock*>());
+			auto& [offset, targets] = *it;
+			targets.push_back(m_jump_map.at(instruction.offset)); // TODO: map lookup is redundant here
+		}
+
+		break;
+	}
+
+	case asBC_JZ:
+	case asBC_JNZ:
+	case asBC_JS:
+	case asBC_JNS:
+	case asBC_JP:
+	case asBC_JNP:
+	case asBC_JLowZ:
+	case asBC_JLowNZ:
+	{
+		ctx.handling_jump_table = false;
+		preprocess_conditional_branch(instruction);
+
+		if (instruction.arg_int() < 0)
+		{
+			ctx.loops.emplace_back(instruction.offset + 2 + instruction.arg_int(), instruction.offset);
+		}
+
+		break;
+	}
+
+	case asBC_JitEntry:
+	{
+		ctx.handling_jump_table = false;
+		ctx.jit_entries.insert(instruction.offset);
+		break;
+	}
+
+	default:
+	{
+		ctx.handling_jump_table = false;
+		break;
+	}
+	}
+}
+
+void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
+{
+	asCScriptEngine&   engine  = m_context.compiler->engine();
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+
+	ir.SetCurrentDebugLocation(get_debug_location(m_context, ins.offset, m_context.llvm_function->getSubprogram()));
+
+	const auto old_stack_pointer = m_stack.current_stack_pointer();
+	m_current_offset             = ins.offset;
+
+	if (auto it = m_jump_map.find(ins.offset); it != m_jump_map.end())
+	{
+		asllvm_assert(m_stack.empty_stack());
+		switch_to_block(it->second);
+	}
+
+	m_stack.check_stack_pointer_bounds();
+
+	const auto unimpl = [&] { throw UnsupportedFeature{fmt::format("unimplemented instruction {}", ins.info->name)}; };
+
+	switch (ins.info->bc)
+	{
+	case asBC_PopPtr:
+	{
+		m_stack.pop(AS_PTR_SIZE);
+		break;
+	}
+
+	case asBC_PshGPtr:
+	{
+		m_stack.push(load_global(ins.arg_pword(), types.iptr), AS_PTR_SIZE);
+		break;
+	}
+
+	case asBC_PshC4:
+	{
+		m_stack.push(llvm::ConstantInt::get(types.i32, ins.arg_dword()), 1);
+		break;
+	}
+
+	case asBC_PshV4:
+	{
+		m_stack.push(m_stack.load(ins.arg_sword0(), types.i32), 1);
+		break;
+	}
+
+	case asBC_PSF:
+	{
+		m_stack.push(m_stack.pointer_to(ins.arg_sword0(), types.iptr), AS_PTR_SIZE);
+		break;
+	}
+
+	case asBC_SwapPtr: unimpl(); break;
+
+	case asBC_NOT:
+	{
+		llvm::Value* source = m_stack.load(ins.arg_sword0(), types.i1);
+		llvm::Value* result
+			= ir.CreateSelect(source, llvm::ConstantInt::get(types.i32, 0), llvm::ConstantInt::get(types.i32, 1));
+		m_stack.store(ins.arg_sword0(), result);
+		break;
+	}
+
+	case asBC_PshG4:
+	{
+		m_stack.push(load_global(ins.arg_pword(), types.i32), 1);
+		break;
+	}
+
+	case asBC_LdGRdR4: unimpl(); break;
+
+	case asBC_CALL:
+	{
+		auto& function = static_cast<asCScriptFunction&>(*engine.GetFunctionById(ins.arg_int()));
+		emit_script_call(function, {}, is_followed_by_return(ins));
+		break;
+	}
+
+	case asBC_RET:
+	{
+		const asCDataType& type = m_context.script_function->returnType;
+
+		if (type.GetTokenType() != ttVoid && !m_context.script_function->DoesReturnOnStack())
+		{
+			llvm::Value* return_pointer = &*(m_context.llvm_function->arg_begin() + 0);
+			llvm::Type*  llvm_type      = builder.to_llvm_type(type);
+
+			if (type.IsObjectHandle() || type.IsObject())
+			{
+				ir.CreateStore(
+					ir.CreatePointerCast(load_object_register_value(), llvm_type), return_pointer);
+			}
+			else
+			{
+				ir.CreateStore(load_value_register_value(llvm_type), return_pointer);
+			}
+		}
+
+		ir.CreateRet(llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::Ok)));
+
+		m_ret_pointer = ins.pointer;
+		break;
+	}
+
+	case asBC_JMP:
+	{
+		if (ins.arg_int() < 0)
+		{
+			emit_back_edge(ins.pointer);
+		}
+
+		ir.CreateBr(get_branch_target(ins));
+		break;
+	}
+
+	case asBC_JZ: emit_conditional_branch(ins, llvm::CmpInst::ICMP_EQ); break;
+	case asBC_JNZ: emit_conditional_branch(ins, llvm::CmpInst::ICMP_NE); break;
+	case asBC_JS: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SLT); break;
+	case asBC_JNS: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SGE); break;
+	case asBC_JP: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SGT); break;
+	case asBC_JNP: emit_conditional_branch(ins, llvm::CmpInst::ICMP_SLE); break;
+
+	case asBC_TZ: emit_condition(llvm::CmpInst::ICMP_EQ); break;
+	case asBC_TNZ: emit_condition(llvm::CmpInst::ICMP_NE); break;
 	case asBC_TS: emit_condition(llvm::CmpInst::ICMP_SLT); break;
 	case asBC_TNS: emit_condition(llvm::CmpInst::ICMP_SGE); break;
 	case asBC_TP: emit_condition(llvm::CmpInst::ICMP_SGT); break;
@@ -486,14 +1069,51 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 		auto& targets = m_switch_map.at(ins.offset);
 		asllvm_assert(!targets.empty());
 
-		llvm::SwitchInst* inst
-			= ir.CreateSwitch(m_stack.load(ins.arg_sword0(), types.i32), targets.back(), targets.size());
+		llvm::Value* value = m_stack.load(ins.arg_sword0(), types.i32);
+		llvm::Value* size  = llvm::ConstantInt::get(types.i32, targets.size());
+
+		if (m_instrumentation != nullptr)
+		{
+			std::vector<std::uint64_t>& counters
+				= m_instrumentation->switches.try_emplace(ins.offset, targets.size() + 1).first->second;
+
+			// Profiles are dropped with their function, so counters at the same offset belong to the same switch. Code
+			// emitted before refers to them, so they are never resized: a mismatch leaves the switch uncounted.
+			asllvm_assert(counters.size() == targets.size() + 1);
+
+			if (counters.size() == targets.size() + 1)
+			{
+				// Out of range values are all counted by the last counter
+				llvm::Value* index   = ir.CreateSelect(ir.CreateICmpULT(value, size), value, size);
+				llvm::Value* counter = ir.CreateInBoundsGEP(
+					get_profile_counter_pointer(counters.front()), {ir.CreateZExt(index, types.iptr)});
+
+				emit_profile_counter_increment(counter, llvm::ConstantInt::get(types.i64, 1));
+			}
+		}
+
+		llvm::SwitchInst* inst = ir.CreateSwitch(value, targets.back(), targets.size());
 
 		for (std::size_t i = 0; i < targets.size(); ++i)
 		{
 			inst->addCase(llvm::ConstantInt::get(types.i32, i), targets[i]);
 		}
 
+		if (m_profile != nullptr)
+		{
+			if (auto it = m_profile->switches.find(ins.offset);
+				it != m_profile->switches.end() && it->second.size() == targets.size() + 1)
+			{
+				// The weight of the default destination comes first, followed by the ones of the cases
+				std::vector<std::uint64_t> counts{it->second.back()};
+				counts.insert(counts.end(), it->second.begin(), it->second.end() - 1);
+
+				inst->setMetadata(
+					llvm::LLVMContext::MD_prof,
+					llvm::MDBuilder(ir.getContext()).createBranchWeights(to_branch_weights(counts)));
+			}
+		}
+
 		break;
 	}
 
@@ -521,15 +1141,15 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 		break;
 	}
 
-	case asBC_CALLBND: unimpl(); break;
+	case asBC_CALLBND:
+	{
+		emit_imported_call(ins.arg_int());
+		break;
+	}
 
 	case asBC_SUSPEND:
 	{
-		if (m_context.compiler->config().verbose)
-		{
-			m_context.compiler->diagnostic("Found VM suspend, these are unsupported and ignored", asMSGTYPE_WARNING);
-		}
-
+		// Line cues are polled less often, see emit_safepoint()
 		break;
 	}
 
@@ -541,10 +1161,14 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 		if (type.flags & asOBJ_SCRIPT_OBJECT)
 		{
 			// Initialize stuff using the scriptobject constructor
-			llvm::Value* object_memory_pointer = ir.CreateCall(
+			llvm::CallInst* object_memory_pointer = ir.CreateCall(
 				funcs.new_script_object,
 				{ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&type)), types.pvoid)},
 				fmt::format("dynamic.{}", type.GetName()));
+			if (type.size > 0)
+			{
+				object_memory_pointer->addDereferenceableAttr(llvm::AttributeList::ReturnIndex, type.size);
+			}
 
 			// Constructor
 			asCScriptFunction& constructor = *static_cast<asCScriptEngine&>(engine).scriptFunctions[constructor_id];
@@ -565,8 +1189,12 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 		{
 			// Allocate memory for the object
 			// TODO: align type.size to 4 bytes
-			llvm::Value* object_memory_pointer = ir.CreateCall(
+			llvm::CallInst* object_memory_pointer = ir.CreateCall(
 				funcs.alloc, {llvm::ConstantInt::get(types.iptr, type.size)}, fmt::format("heap.{}", type.GetName()));
+			if (type.size > 0)
+			{
+				object_memory_pointer->addDereferenceableAttr(llvm::AttributeList::ReturnIndex, type.size);
+			}
 
 			if (constructor_id != 0)
 			{
@@ -620,13 +1248,16 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 			ir.CreateCall(funcs.free, {object_pointer});
 		}
 
+		// Exception handlers release variables that are not null
+		ir.CreateStore(llvm::Constant::getNullValue(types.pvoid), variable_pointer);
+
 		break;
 	}
 
 	case asBC_LOADOBJ:
 	{
 		llvm::Value* pointer_to_object = m_stack.load(ins.arg_sword0(), types.pvoid);
-		ir.CreateStore(pointer_to_object, m_object_register);
+		store_object_register_value(pointer_to_object);
 		m_stack.store(ins.arg_sword0(), ir.CreatePtrToInt(llvm::ConstantInt::get(types.iptr, 0), types.pvoid));
 
 		break;
@@ -634,8 +1265,8 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_STOREOBJ:
 	{
-		m_stack.store(ins.arg_sword0(), ir.CreateLoad(types.pvoid, m_object_register));
-		ir.CreateStore(ir.CreatePtrToInt(llvm::ConstantInt::get(types.iptr, 0), types.pvoid), m_object_register);
+		m_stack.store(ins.arg_sword0(), load_object_register_value());
+		store_object_register_value(llvm::Constant::getNullValue(types.pvoid));
 		break;
 	}
 
@@ -740,9 +1371,13 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 	}
 
 	case asBC_PshNull: unimpl(); break;
-	case asBC_ClrVPtr: unimpl(); break;
-
-	case asBC_OBJTYPE:
+	case asBC_ClrVPtr:
+	{
+		m_stack.store(ins.arg_sword0(), llvm::Constant::getNullValue(types.pvoid));
+		break;
+	}
+
+	case asBC_OBJTYPE:
 	{
 		m_stack.push(llvm::ConstantInt::get(types.iptr, ins.arg_pword()), AS_PTR_SIZE);
 		break;
@@ -811,9 +1446,7 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_CpyVtoG4:
 	{
-		llvm::Value* global_ptr = ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, ins.arg_pword()), types.pi32);
-		llvm::Value* value      = m_stack.load(ins.arg_sword0(), types.i32);
-		ir.CreateStore(value, global_ptr);
+		store_global(ins.arg_pword(), m_stack.load(ins.arg_sword0(), types.i32));
 		break;
 	}
 
@@ -831,8 +1464,7 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_CpyGtoV4:
 	{
-		llvm::Value* global_ptr = ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, ins.arg_pword()), types.pi32);
-		m_stack.store(ins.arg_sword0(), ir.CreateLoad(global_ptr, types.i32));
+		m_stack.store(ins.arg_sword0(), load_global(ins.arg_pword(), types.i32));
 		break;
 	}
 
@@ -904,7 +1536,7 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_LDG:
 	{
-		store_value_register_value(ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, ins.arg_pword()), types.pvoid));
+		store_value_register_value(get_global_pointer(ins.arg_pword(), types.i8));
 		break;
 	}
 
@@ -916,11 +1548,17 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_PGA:
 	{
-		m_stack.push(llvm::ConstantInt::get(types.i64, ins.arg_pword()), AS_PTR_SIZE);
+		m_stack.push(ir.CreatePtrToInt(get_global_pointer(ins.arg_pword(), types.i8), types.iptr), AS_PTR_SIZE);
 		break;
 	}
 
-	case asBC_CmpPtr: unimpl(); break;
+	case asBC_CmpPtr:
+	{
+		llvm::Value* lhs = m_stack.load(ins.arg_sword0(), types.iptr);
+		llvm::Value* rhs = m_stack.load(ins.arg_sword1(), types.iptr);
+		emit_compare(lhs, rhs, false);
+		break;
+	}
 
 	case asBC_VAR:
 	{
@@ -949,20 +1587,20 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 	case asBC_ADDi: emit_binop(ins, llvm::Instruction::Add, types.i32); break;
 	case asBC_SUBi: emit_binop(ins, llvm::Instruction::Sub, types.i32); break;
 	case asBC_MULi: emit_binop(ins, llvm::Instruction::Mul, types.i32); break;
-	case asBC_DIVi: emit_binop(ins, llvm::Instruction::SDiv, types.i32); break;
-	case asBC_MODi: emit_binop(ins, llvm::Instruction::SRem, types.i32); break;
+	case asBC_DIVi: emit_divmod(ins, llvm::Instruction::SDiv, types.i32); break;
+	case asBC_MODi: emit_divmod(ins, llvm::Instruction::SRem, types.i32); break;
 
 	case asBC_ADDf: emit_binop(ins, llvm::Instruction::FAdd, types.f32); break;
 	case asBC_SUBf: emit_binop(ins, llvm::Instruction::FSub, types.f32); break;
 	case asBC_MULf: emit_binop(ins, llvm::Instruction::FMul, types.f32); break;
-	case asBC_DIVf: emit_binop(ins, llvm::Instruction::FDiv, types.f32); break;
-	case asBC_MODf: emit_binop(ins, llvm::Instruction::FRem, types.f32); break;
+	case asBC_DIVf: emit_divmod(ins, llvm::Instruction::FDiv, types.f32); break;
+	case asBC_MODf: emit_divmod(ins, llvm::Instruction::FRem, types.f32); break;
 
 	case asBC_ADDd: emit_binop(ins, llvm::Instruction::FAdd, types.f64); break;
 	case asBC_SUBd: emit_binop(ins, llvm::Instruction::FSub, types.f64); break;
 	case asBC_MULd: emit_binop(ins, llvm::Instruction::FMul, types.f64); break;
-	case asBC_DIVd: emit_binop(ins, llvm::Instruction::FDiv, types.f64); break;
-	case asBC_MODd: emit_binop(ins, llvm::Instruction::FRem, types.f64); break;
+	case asBC_DIVd: emit_divmod(ins, llvm::Instruction::FDiv, types.f64); break;
+	case asBC_MODd: emit_divmod(ins, llvm::Instruction::FRem, types.f64); break;
 
 	case asBC_ADDIi: emit_binop(ins, llvm::Instruction::Add, llvm::ConstantInt::get(types.i32, ins.arg_int(1))); break;
 	case asBC_SUBIi: emit_binop(ins, llvm::Instruction::Sub, llvm::ConstantInt::get(types.i32, ins.arg_int(1))); break;
@@ -980,9 +1618,7 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_SetG4:
 	{
-		llvm::Value* pointer = ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, ins.arg_pword()), types.pi32);
-		llvm::Value* value   = llvm::ConstantInt::get(types.i32, ins.arg_dword(AS_PTR_SIZE));
-		ir.CreateStore(value, pointer);
+		store_global(ins.arg_pword(), llvm::ConstantInt::get(types.i32, ins.arg_dword(AS_PTR_SIZE)));
 		break;
 	}
 
@@ -998,14 +1634,21 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 	case asBC_CALLINTF:
 	{
 		auto& function = static_cast<asCScriptFunction&>(*engine.GetFunctionById(ins.arg_int()));
-		emit_script_call(function);
+		emit_script_call(function, {}, is_followed_by_return(ins));
 		break;
 	}
 
 	case asBC_iTOb: emit_cast(ins, llvm::Instruction::Trunc, types.i32, types.i8); break;
 	case asBC_iTOw: emit_cast(ins, llvm::Instruction::Trunc, types.i32, types.i16); break;
 
-	case asBC_Cast: unimpl(); break;
+	case asBC_Cast:
+	{
+		asCObjectType* target = CastToObjectType(engine.GetTypeInfoFromTypeId(ins.arg_dword()));
+		asllvm_assert(target != nullptr && (target->flags & asOBJ_SCRIPT_OBJECT) != 0);
+
+		emit_script_object_cast(*target);
+		break;
+	}
 
 	case asBC_i64TOi: emit_cast(ins, llvm::Instruction::Trunc, types.i64, types.i32); break;
 	case asBC_uTOi64: emit_cast(ins, llvm::Instruction::ZExt, types.i32, types.i64); break;
@@ -1029,8 +1672,8 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 	case asBC_ADDi64: emit_binop(ins, llvm::Instruction::Add, types.i64); break;
 	case asBC_SUBi64: emit_binop(ins, llvm::Instruction::Sub, types.i64); break;
 	case asBC_MULi64: emit_binop(ins, llvm::Instruction::Mul, types.i64); break;
-	case asBC_DIVi64: emit_binop(ins, llvm::Instruction::SDiv, types.i64); break;
-	case asBC_MODi64: emit_binop(ins, llvm::Instruction::SRem, types.i64); break;
+	case asBC_DIVi64: emit_divmod(ins, llvm::Instruction::SDiv, types.i64); break;
+	case asBC_MODi64: emit_divmod(ins, llvm::Instruction::SRem, types.i64); break;
 
 	case asBC_BAND64: emit_binop(ins, llvm::Instruction::And, types.i64); break;
 	case asBC_BOR64: emit_binop(ins, llvm::Instruction::Or, types.i64); break;
@@ -1075,12 +1718,32 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 		// Pass the JitCompiler as the jitArg value, which can be used by lazy_jit_compiler().
 		// TODO: this is probably UB
-		ins.arg_pword() = reinterpret_cast<asPWORD>(m_context.compiler);
+		// Only the entry of the function and the headers of its loops are patched: frames left to the VM must not
+		// enter the function again at the entries following calls. See emit_deoptimization().
+		const bool is_osr_entry = m_osr_candidates.count(ins.offset) != 0 && m_stack.empty_stack();
+
+		ins.arg_pword()   = !m_has_entry_point || is_osr_entry ? reinterpret_cast<asPWORD>(m_context.compiler) : 0;
+		m_has_entry_point = true;
+
+		if (is_osr_entry)
+		{
+			llvm::BasicBlock* block = llvm::BasicBlock::Create(
+				ir.getContext(), fmt::format("osr_entry_{:04x}", ins.offset), m_context.llvm_function);
+			switch_to_block(block);
+
+			m_osr_entries.emplace(ins.offset, block);
+		}
 
 		break;
 	}
 
-	case asBC_CallPtr: unimpl(); break;
+	case asBC_CallPtr:
+	{
+		const asCScriptFunction* signature = get_function_pointer_signature(ins.arg_sword0());
+		asllvm_assert(signature != nullptr && "could not find the type of the function pointer variable");
+		emit_function_pointer_call(*signature, m_stack.load(ins.arg_sword0(), types.pvoid));
+		break;
+	}
 
 	case asBC_FuncPtr:
 	{
@@ -1090,8 +1753,12 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_LoadThisR:
 	{
+		// In methods, `this` was checked by the caller and is known to be non-null, see get_script_function()
 		llvm::Value* object = m_stack.load(0, types.pvoid);
-		emit_check_null_pointer(object);
+		if (m_context.script_function->objectType == nullptr)
+		{
+			emit_check_null_pointer(object);
+		}
 
 		llvm::Value* field = ir.CreateInBoundsGEP(object, {llvm::ConstantInt::get(types.iptr, ins.arg_sword0())});
 
@@ -1102,11 +1769,11 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 
 	case asBC_PshV8: m_stack.push(m_stack.load(ins.arg_sword0(), types.i64), 2); break;
 
-	case asBC_DIVu: emit_binop(ins, llvm::Instruction::UDiv, types.i32); break;
-	case asBC_MODu: emit_binop(ins, llvm::Instruction::URem, types.i32); break;
+	case asBC_DIVu: emit_divmod(ins, llvm::Instruction::UDiv, types.i32); break;
+	case asBC_MODu: emit_divmod(ins, llvm::Instruction::URem, types.i32); break;
 
-	case asBC_DIVu64: emit_binop(ins, llvm::Instruction::UDiv, types.i64); break;
-	case asBC_MODu64: emit_binop(ins, llvm::Instruction::URem, types.i64); break;
+	case asBC_DIVu64: emit_divmod(ins, llvm::Instruction::UDiv, types.i64); break;
+	case asBC_MODu64: emit_divmod(ins, llvm::Instruction::URem, types.i64); break;
 
 	case asBC_LoadRObjR:
 	{
@@ -1160,7 +1827,7 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 		llvm::Value* condition = ir.CreateICmp(
 			llvm::CmpInst::ICMP_EQ, load_value_register_value(types.i8), llvm::ConstantInt::get(types.i8, 0));
 
-		ir.CreateCondBr(condition, get_branch_target(ins), get_conditional_fail_branch_target(ins));
+		emit_branch_if(ins, condition);
 
 		break;
 	}
@@ -1170,7 +1837,7 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 		llvm::Value* condition = ir.CreateICmp(
 			llvm::CmpInst::ICMP_NE, load_value_register_value(types.i8), llvm::ConstantInt::get(types.i8, 0));
 
-		ir.CreateCondBr(condition, get_branch_target(ins), get_conditional_fail_branch_target(ins));
+		emit_branch_if(ins, condition);
 
 		break;
 	}
@@ -1212,17 +1879,17 @@ void FunctionBuilder::translate_instruction(BytecodeInstruction ins)
 	}
 
 	case asBC_SetListType: unimpl(); break;
-	case asBC_POWi: unimpl(); break;
-	case asBC_POWu: unimpl(); break;
-	case asBC_POWf: unimpl(); break;
-	case asBC_POWd: unimpl(); break;
-	case asBC_POWdi: unimpl(); break;
-	case asBC_POWi64: unimpl(); break;
-	case asBC_POWu64: unimpl(); break;
+	case asBC_POWi: emit_integer_pow(ins, types.i32, true); break;
+	case asBC_POWu: emit_integer_pow(ins, types.i32, false); break;
+	case asBC_POWf: emit_float_pow(ins, types.f32, types.f32); break;
+	case asBC_POWd: emit_float_pow(ins, types.f64, types.f64); break;
+	case asBC_POWdi: emit_float_pow(ins, types.f64, types.i32); break;
+	case asBC_POWi64: emit_integer_pow(ins, types.i64, true); break;
+	case asBC_POWu64: emit_integer_pow(ins, types.i64, false); break;
 
 	default:
 	{
-		asllvm_assert(false && "unrecognized instruction - are you using an unsupported AS version?");
+		throw UnsupportedFeature{"unrecognized instruction - are you using an unsupported AS version?"};
 	}
 	}
 
@@ -1368,8 +2035,14 @@ void FunctionBuilder::emit_allocate_local_structures()
 	m_object_register = ir.CreateAlloca(types.pvoid, nullptr, "objectRegister");
 	m_stack.setup();
 
-	ir.CreateStore(llvm::ConstantInt::get(types.i64, 0), m_value_register);
-	ir.CreateStore(ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, 0), types.pvoid), m_object_register);
+	store_value_register_value(llvm::ConstantInt::get(types.i64, 0));
+	store_object_register_value(llvm::Constant::getNullValue(types.pvoid));
+
+	if (m_context.compiler->config().enforce_execution_budget)
+	{
+		m_budget_counter = ir.CreateAlloca(types.i32, nullptr, "budgetCounter");
+		ir.CreateStore(llvm::ConstantInt::get(types.i32, runtime::execution_budget_batch_size), m_budget_counter);
+	}
 	ir.CreateMemSet(
 		m_stack.storage_alloca(),
 		llvm::ConstantInt::get(types.i8, 0),
@@ -1417,6 +2090,86 @@ void FunctionBuilder::emit_binop(
 	m_stack.store(instruction.arg_sword0(), ir.CreateBinOp(op, lhs, rhs));
 }
 
+void FunctionBuilder::emit_divmod(BytecodeInstruction instruction, llvm::Instruction::BinaryOps op, llvm::Type* type)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	llvm::Value* lhs = m_stack.load(instruction.arg_sword1(), type);
+	llvm::Value* rhs = m_stack.load(instruction.arg_sword2(), type);
+
+	// The VM raises an exception on floating-point division by zero as well
+	if (type->isFloatingPointTy())
+	{
+		emit_check_exception(ir.CreateFCmpOEQ(rhs, llvm::ConstantFP::get(type, 0.0)), VmState::ExceptionDivideByZero);
+	}
+	else
+	{
+		emit_check_exception(ir.CreateICmpEQ(rhs, llvm::ConstantInt::get(type, 0)), VmState::ExceptionDivideByZero);
+	}
+
+	if (op == llvm::Instruction::SDiv || op == llvm::Instruction::SRem)
+	{
+		const unsigned bits = type->getIntegerBitWidth();
+
+		emit_check_exception(
+			ir.CreateAnd(
+				ir.CreateICmpEQ(rhs, llvm::ConstantInt::get(type, -1, true)),
+				ir.CreateICmpEQ(lhs, ir.getInt(llvm::APInt::getSignedMinValue(bits)))),
+			VmState::ExceptionDivideOverflow);
+	}
+
+	emit_binop(instruction, op, lhs, rhs);
+}
+
+void FunctionBuilder::emit_integer_pow(BytecodeInstruction instruction, llvm::IntegerType* type, bool is_signed)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	llvm::Value* base     = m_stack.load(instruction.arg_sword1(), type);
+	llvm::Value* exponent = m_stack.load(instruction.arg_sword2(), type);
+
+	llvm::Value* result
+		= ir.CreateCall(m_context.module_builder->get_integer_pow_function(type, is_signed), {base, exponent});
+
+	m_stack.store(instruction.arg_sword0(), ir.CreateExtractValue(result, 0));
+
+	emit_check_exception(ir.CreateExtractValue(result, 1), VmState::ExceptionPowOverflow);
+}
+
+void FunctionBuilder::emit_float_pow(BytecodeInstruction instruction, llvm::Type* type, llvm::Type* exponent_type)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	// The VM checks for an infinite result, which fast-math flags would allow to optimize away
+	llvm::IRBuilder<>::FastMathFlagGuard fast_math_guard{ir};
+	ir.clearFastMathFlags();
+
+	llvm::Value* base     = m_stack.load(instruction.arg_sword1(), type);
+	llvm::Value* exponent = m_stack.load(instruction.arg_sword2(), exponent_type);
+
+	llvm::Value* result = nullptr;
+
+	if (exponent_type->isIntegerTy())
+	{
+#if LLVM_VERSION_MAJOR >= 13
+		result = ir.CreateIntrinsic(llvm::Intrinsic::powi, {type, exponent_type}, {base, exponent});
+#else
+		result = ir.CreateIntrinsic(llvm::Intrinsic::powi, {type}, {base, exponent});
+#endif
+	}
+	else
+	{
+		result = ir.CreateBinaryIntrinsic(llvm::Intrinsic::pow, base, exponent);
+	}
+
+	m_stack.store(instruction.arg_sword0(), result);
+
+	emit_check_exception(ir.CreateFCmpOEQ(result, llvm::ConstantFP::getInfinity(type)), VmState::ExceptionPowOverflow);
+}
+
 void FunctionBuilder::emit_neg(BytecodeInstruction instruction, llvm::Type* type)
 {
 	Builder&           builder = m_context.compiler->builder();
@@ -1620,7 +2373,7 @@ void FunctionBuilder::emit_system_call(const asCScriptFunction& function)
 
 		default:
 		{
-			asllvm_assert(false && "unhandled calling convention");
+			throw UnsupportedFeature{"unhandled calling convention"};
 		}
 		}
 	}
@@ -1632,6 +2385,18 @@ void FunctionBuilder::emit_system_call(const asCScriptFunction& function)
 		emit_check_null_pointer(object);
 	}
 
+	if (llvm::Value* value = emit_addon_intrinsic(function, object, args); value != nullptr)
+	{
+		store_value_register_value(ir.CreateBitOrPointerCast(value, return_type));
+		return;
+	}
+
+	if (llvm::Value* value = emit_math_intrinsic(function, callee_type, args); value != nullptr)
+	{
+		store_value_register_value(value);
+		return;
+	}
+
 	switch (intf.callConv)
 	{
 	// Virtual
@@ -1639,13 +2404,13 @@ void FunctionBuilder::emit_system_call(const asCScriptFunction& function)
 	{
 		asllvm_assert(object != nullptr);
 
-		callee = ir.CreatePointerCast(
-			ir.CreateCall(
-				funcs.system_vtable_lookup,
-				{object,
-				 ir.CreateIntToPtr(
-					 llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(intf.func)), types.pvoid)}),
-			callee_type->getPointerTo());
+		llvm::CallInst* lookup = ir.CreateCall(
+			funcs.system_vtable_lookup,
+			{object,
+			 ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(intf.func)), types.pvoid)});
+		mark_no_script_global_access(lookup);
+
+		callee = ir.CreatePointerCast(lookup, callee_type->getPointerTo());
 
 		break;
 	}
@@ -1657,10 +2422,11 @@ void FunctionBuilder::emit_system_call(const asCScriptFunction& function)
 	}
 	}
 
-	ir.CreateCall(
-		funcs.prepare_system_call,
-		{ir.CreatePointerCast(callee, types.pvoid)});
-	llvm::Value* result = ir.CreateCall(callee_type, callee, args);
+	mark_no_script_global_access(ir.CreateCall(funcs.prepare_system_call, {ir.CreatePointerCast(callee, types.pvoid)}));
+
+	llvm::CallInst* result = ir.CreateCall(callee_type, callee, args);
+	mark_no_script_global_access(result);
+
 	emit_check_context_state();
 
 	if (return_pointer == nullptr)
@@ -1669,9 +2435,7 @@ void FunctionBuilder::emit_system_call(const asCScriptFunction& function)
 		{
 			if (function.returnType.IsObjectHandle())
 			{
-				llvm::Value* typed_object_register
-					= ir.CreatePointerCast(m_object_register, return_type->getPointerTo());
-				ir.CreateStore(result, typed_object_register);
+				store_object_register_value(ir.CreatePointerCast(result, types.pvoid));
 			}
 			else
 			{
@@ -1689,35 +2453,243 @@ void FunctionBuilder::emit_system_call(const asCScriptFunction& function)
 	m_stack.ugly_hack_stack_pointer_within_bounds();
 }
 
+llvm::Value* FunctionBuilder::emit_addon_intrinsic(
+	const asCScriptFunction& function, llvm::Value* object, const std::vector<llvm::Value*>& args)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	asCScriptEngine&   engine  = m_context.compiler->engine();
+
+	if (!m_context.compiler->config().allow_addon_intrinsics || object == nullptr)
+	{
+		return nullptr;
+	}
+
+	const AddonIntrinsic intrinsic = get_addon_intrinsic(function);
+
+	if (intrinsic == AddonIntrinsic::None)
+	{
+		return nullptr;
+	}
+
+	// The only non-'this' parameter, if any
+	llvm::Value* index = nullptr;
+
+	switch (function.sysFuncIntf->callConv)
+	{
+	case ICC_THISCALL: index = args.size() > 1 ? args[1] : nullptr; break;
+	case ICC_CDECL_OBJLAST: index = args.size() > 1 ? args[0] : nullptr; break;
+	default: return nullptr;
+	}
+
+	// Layout of CScriptArray (which has a vtable) and of its SArrayBuffer
+	constexpr std::uint64_t array_buffer_offset      = 3 * sizeof(void*);
+	constexpr std::uint64_t array_buffer_size_offset = 4;
+	constexpr std::uint64_t array_buffer_data_offset = 8;
+	constexpr std::uint64_t string_data_offset       = 0;
+	constexpr std::uint64_t string_size_offset       = sizeof(void*);
+
+	const auto load_field = [&](llvm::Value* base, std::uint64_t offset, llvm::Type* type) {
+		llvm::Value* field = ir.CreateInBoundsGEP(
+			ir.CreatePointerCast(base, types.pi8), llvm::ConstantInt::get(types.iptr, offset));
+		return ir.CreateLoad(type, ir.CreatePointerCast(field, type->getPointerTo()));
+	};
+
+	// Array buffers are always allocated by the constructors, CScriptArray::GetSize() does not check it either.
+	const auto load_array_buffer = [&] { return load_field(object, array_buffer_offset, types.pi8); };
+
+	switch (intrinsic)
+	{
+	case AddonIntrinsic::ArrayIndex:
+	{
+		asCDataType element_type = function.returnType;
+		element_type.MakeReference(false);
+		element_type.MakeReadOnly(false);
+
+		// Template methods that were not instantiated for a concrete subtype
+		if (element_type.GetTypeInfo() != nullptr
+			&& (element_type.GetTypeInfo()->flags & asOBJ_TEMPLATE_SUBTYPE) != 0)
+		{
+			return nullptr;
+		}
+
+		// Same logic as CScriptArray::Precache() and CScriptArray::At()
+		const int  subtype_id   = engine.GetTypeIdFromDataType(element_type);
+		const bool is_object    = (subtype_id & asTYPEID_MASK_OBJECT) != 0;
+		const bool is_indirect  = is_object && (subtype_id & asTYPEID_OBJHANDLE) == 0;
+		const int  element_size = is_object ? int(sizeof(asPWORD)) : engine.GetSizeOfPrimitiveType(subtype_id);
+
+		llvm::Value* buffer = load_array_buffer();
+		llvm::Value* size   = load_field(buffer, array_buffer_size_offset, types.i32);
+
+		emit_check_exception(ir.CreateICmpUGE(index, size), VmState::ExceptionArrayOutOfBounds);
+
+		llvm::Value* element_offset = ir.CreateAdd(
+			ir.CreateMul(ir.CreateZExt(index, types.iptr), llvm::ConstantInt::get(types.iptr, element_size)),
+			llvm::ConstantInt::get(types.iptr, array_buffer_data_offset));
+
+		llvm::Value* element = ir.CreateInBoundsGEP(buffer, element_offset);
+
+		return is_indirect ? ir.CreateLoad(types.pvoid, ir.CreatePointerCast(element, types.pvoid->getPointerTo()))
+						   : element;
+	}
+
+	case AddonIntrinsic::ArrayLength:
+	{
+		return load_field(load_array_buffer(), array_buffer_size_offset, types.i32);
+	}
+
+	case AddonIntrinsic::ArrayIsEmpty:
+	{
+		llvm::Value* size = load_field(load_array_buffer(), array_buffer_size_offset, types.i32);
+		return ir.CreateICmpEQ(size, llvm::ConstantInt::get(types.i32, 0));
+	}
+
+	case AddonIntrinsic::StringIndex:
+	{
+		llvm::Value* size = load_field(object, string_size_offset, types.iptr);
+
+		emit_check_exception(
+			ir.CreateICmpUGE(ir.CreateZExt(index, types.iptr), size), VmState::ExceptionStringOutOfRange);
+
+		llvm::Value* data = load_field(object, string_data_offset, types.pi8);
+		return ir.CreateInBoundsGEP(data, ir.CreateZExt(index, types.iptr));
+	}
+
+	case AddonIntrinsic::StringLength:
+	{
+		return ir.CreateTrunc(load_field(object, string_size_offset, types.iptr), types.i32);
+	}
+
+	case AddonIntrinsic::StringIsEmpty:
+	{
+		llvm::Value* size = load_field(object, string_size_offset, types.iptr);
+		return ir.CreateICmpEQ(size, llvm::ConstantInt::get(types.iptr, 0));
+	}
+
+	default: return nullptr;
+	}
+}
+
+llvm::Value* FunctionBuilder::emit_math_intrinsic(
+	const asCScriptFunction& function, llvm::FunctionType* callee_type, const std::vector<llvm::Value*>& args)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	const std::optional<MathIntrinsic> intrinsic = m_context.compiler->get_math_intrinsic(function);
+
+	if (!intrinsic.has_value() || function.sysFuncIntf->hostReturnInMemory)
+	{
+		return nullptr;
+	}
+
+	// All the intrinsics operate on a single type for both the parameters and the return value
+	llvm::Type* type = callee_type->getReturnType();
+
+	for (llvm::Type* param_type : callee_type->params())
+	{
+		if (param_type != type)
+		{
+			return nullptr;
+		}
+	}
+
+	const bool is_float   = type->isFloatingPointTy();
+	const bool is_integer = type->isIntegerTy() && type != llvm::Type::getInt1Ty(type->getContext());
+	const bool is_signed  = is_integer && !function.returnType.IsUnsignedType();
+
+	const auto unary = [&](llvm::Intrinsic::ID id) -> llvm::Value* {
+		return args.size() == 1 ? ir.CreateUnaryIntrinsic(id, args[0]) : nullptr;
+	};
+
+	const auto binary = [&](llvm::Intrinsic::ID id) -> llvm::Value* {
+		return args.size() == 2 ? ir.CreateBinaryIntrinsic(id, args[0], args[1]) : nullptr;
+	};
+
+	switch (*intrinsic)
+	{
+	case MathIntrinsic::Sqrt: return is_float ? unary(llvm::Intrinsic::sqrt) : nullptr;
+	case MathIntrinsic::Floor: return is_float ? unary(llvm::Intrinsic::floor) : nullptr;
+	case MathIntrinsic::Ceil: return is_float ? unary(llvm::Intrinsic::ceil) : nullptr;
+	case MathIntrinsic::Sin: return is_float ? unary(llvm::Intrinsic::sin) : nullptr;
+	case MathIntrinsic::Cos: return is_float ? unary(llvm::Intrinsic::cos) : nullptr;
+	case MathIntrinsic::Pow: return is_float ? binary(llvm::Intrinsic::pow) : nullptr;
+
+	case MathIntrinsic::Abs:
+	{
+		if (is_float)
+		{
+			return unary(llvm::Intrinsic::fabs);
+		}
+
+		// abs(INT_MIN) == INT_MIN, as with the C functions in practice
+		return is_signed && args.size() == 1 ? ir.CreateBinaryIntrinsic(llvm::Intrinsic::abs, args[0], ir.getFalse())
+											 : nullptr;
+	}
+
+	case MathIntrinsic::Min:
+	{
+		if (is_float)
+		{
+			return binary(llvm::Intrinsic::minnum);
+		}
+
+		return is_integer ? binary(is_signed ? llvm::Intrinsic::smin : llvm::Intrinsic::umin) : nullptr;
+	}
+
+	case MathIntrinsic::Max:
+	{
+		if (is_float)
+		{
+			return binary(llvm::Intrinsic::maxnum);
+		}
+
+		return is_integer ? binary(is_signed ? llvm::Intrinsic::smax : llvm::Intrinsic::umax) : nullptr;
+	}
+
+	default: return nullptr;
+	}
+}
+
 std::size_t FunctionBuilder::emit_script_call(const asCScriptFunction& callee) { return emit_script_call(callee, {}); }
 
-std::size_t FunctionBuilder::emit_script_call(const asCScriptFunction& callee, FunctionBuilder::VmEntryCallContext ctx)
+std::size_t FunctionBuilder::emit_script_call(
+	const asCScriptFunction& callee, FunctionBuilder::VmEntryCallContext ctx, bool is_tail_position)
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
 
-	const bool is_vm_entry = ctx.vm_frame_pointer != nullptr;
+	const bool is_vm_entry  = ctx.vm_frame_pointer != nullptr;
+	const bool is_tail_call = is_tail_position && !is_vm_entry && is_tail_call_compatible(callee);
+
+	// The VM resumes frames at the call, with the arguments still pushed, see emit_deoptimization()
+	const StackFrame::AsStackOffset call_stack_pointer = is_vm_entry ? 0 : m_stack.current_stack_pointer();
 
 	// Check supported calls
 	switch (callee.funcType)
 	{
+	case asFUNC_INTERFACE:
 	case asFUNC_VIRTUAL:
 	case asFUNC_SCRIPT: break;
-	default: asllvm_assert(false && "unsupported script type for script function call");
+	default: throw UnsupportedFeature{"unsupported script type for script function call"};
 	}
 
 	llvm::FunctionType* callee_type = m_context.module_builder->get_script_function_type(callee);
 
+	// Interface methods are resolved once the object was popped
 	llvm::Value* resolved_function = nullptr;
 
 	if (callee.funcType == asFUNC_VIRTUAL)
 	{
 		resolved_function = resolve_virtual_script_function(m_stack.top(types.pvoid), callee);
 	}
-	else
+	else if (callee.funcType == asFUNC_SCRIPT)
 	{
-		resolved_function = m_context.module_builder->get_script_function(callee);
+		resolved_function
+			= ctx.target != nullptr ? ctx.target : m_context.module_builder->get_script_function(callee);
 	}
 
 	std::size_t read_dword_count = 0;
@@ -1770,7 +2742,7 @@ std::size_t FunctionBuilder::emit_script_call(const asCScriptFunction& callee, F
 			}
 			else
 			{
-				asllvm_assert(false && "unhandled return type");
+				throw UnsupportedFeature{"unhandled return type"};
 			}
 		}
 	}
@@ -1780,6 +2752,11 @@ std::size_t FunctionBuilder::emit_script_call(const asCScriptFunction& callee, F
 		llvm::Value* object = pop(m_context.compiler->engine().GetDataTypeFromTypeId(callee.objectType->GetTypeId()));
 		emit_check_null_pointer(object);
 		args.push_back(object);
+
+		if (callee.funcType == asFUNC_INTERFACE)
+		{
+			resolved_function = resolve_interface_method(object, callee);
+		}
 	}
 
 	{
@@ -1790,12 +2767,132 @@ std::size_t FunctionBuilder::emit_script_call(const asCScriptFunction& callee, F
 		}
 	}
 
-	llvm::CallInst* vm_state = ir.CreateCall(callee_type, resolved_function, args);
+	args.push_back(m_vm_registers);
+
+	// The callee owns its object arguments from now on, so the VM must not release them again when unwinding
+	if (is_vm_entry)
+	{
+		for (const auto& [offset, type] : get_object_parameters())
+		{
+			llvm::Value* dword_pointer
+				= ir.CreateInBoundsGEP(ctx.vm_frame_pointer, {llvm::ConstantInt::get(types.iptr, offset)});
+			ir.CreateStore(
+				llvm::Constant::getNullValue(types.pvoid),
+				ir.CreatePointerCast(dword_pointer, types.pvoid->getPointerTo()));
+		}
+	}
+
+	if (is_tail_call)
+	{
+		// The callee writes its return value straight to where our caller expects ours
+		if (callee.returnType.GetTokenType() != ttVoid)
+		{
+			args[0] = ir.CreatePointerCast(m_context.llvm_function->getArg(0), callee_type->getParamType(0));
+		}
+
+		// Returning the state of the callee makes the state check redundant: we would propagate it anyway.
+		// tailcc guarantees the tail call even when the prototypes differ, musttail additionally has it verified.
+		llvm::CallInst* call = ir.CreateCall(callee_type, resolved_function, args);
+		call->setCallingConv(llvm::CallingConv::Tail);
+		call->setTailCallKind(
+			callee_type == m_context.llvm_function->getFunctionType() ? llvm::CallInst::TCK_MustTail
+																	  : llvm::CallInst::TCK_Tail);
+		ir.CreateRet(call);
+
+		ir.SetInsertPoint(llvm::BasicBlock::Create(ir.getContext(), "afterTailCall", m_context.llvm_function));
+
+		return read_dword_count;
+	}
+
+	llvm::Value* vm_state = nullptr;
+
+	if (callee.funcType == asFUNC_VIRTUAL)
+	{
+		vm_state = emit_guarded_direct_call(callee, callee_type, resolved_function, args, call_stack_pointer);
+	}
+
+	if (vm_state == nullptr)
+	{
+		llvm::CallInst* call = ir.CreateCall(callee_type, resolved_function, args);
+		call->setCallingConv(llvm::CallingConv::Tail);
+		vm_state = call;
+	}
+
 	emit_check_vm_state(vm_state);
 
 	return read_dword_count;
 }
 
+bool FunctionBuilder::is_followed_by_return(BytecodeInstruction ins) const
+{
+	// Bounded, so that we do not hang on e.g. an infinite loop made of a single jump
+	constexpr int max_followed_instructions = 16;
+
+	const asDWORD* pointer = ins.pointer + asBCTypeSize[ins.info->type];
+
+	for (int i = 0; i < max_followed_instructions; ++i)
+	{
+		const asBYTE   op   = *reinterpret_cast<const asBYTE*>(pointer);
+		const asDWORD* next = pointer + asBCTypeSize[asBCInfo[op].type];
+
+		switch (op)
+		{
+		// Functions have a single RET, so returning from elsewhere jumps to it
+		case asBC_JMP: pointer = next + asBC_INTARG(pointer); break;
+
+		// Neither of these emit any code
+		case asBC_JitEntry:
+		case asBC_SUSPEND: pointer = next; break;
+
+		case asBC_RET: return true;
+		default: return false;
+		}
+	}
+
+	return false;
+}
+
+bool FunctionBuilder::is_tail_call_compatible(const asCScriptFunction& callee) const
+{
+	Builder& builder = m_context.compiler->builder();
+
+	const asCScriptFunction& caller = *m_context.script_function;
+
+	const bool caller_returns = caller.returnType.GetTokenType() != ttVoid;
+	const bool callee_returns = callee.returnType.GetTokenType() != ttVoid;
+
+	if (caller_returns != callee_returns)
+	{
+		return false;
+	}
+
+	// Values returned on the stack are written to memory owned by the frame of the caller
+	if (caller_returns
+		&& (caller.DoesReturnOnStack() || callee.DoesReturnOnStack()
+			|| builder.to_llvm_type(caller.returnType) != builder.to_llvm_type(callee.returnType)))
+	{
+		return false;
+	}
+
+	// References may point to variables of the current frame, e.g. temporaries for `&in` parameters
+	for (asUINT i = 0; i < callee.parameterTypes.GetLength(); ++i)
+	{
+		const asCDataType& type = callee.parameterTypes[i];
+		if (type.IsReference() || !(type.IsPrimitive() || type.IsObjectHandle()))
+		{
+			return false;
+		}
+	}
+
+	// Exceptions raised by the callee must still reach the catch block of the current frame
+	if (get_exception_handler(m_current_offset).catch_offset != -1)
+	{
+		return false;
+	}
+
+	return true;
+}
+
 void FunctionBuilder::emit_call(const asCScriptFunction& function)
 {
 	switch (function.funcType)
@@ -1816,272 +2913,1714 @@ void FunctionBuilder::emit_call(const asCScriptFunction& function)
 
 	default:
 	{
-		asllvm_assert(false && "unhandled function type in emit_call");
-		break;
+		throw UnsupportedFeature{"unhandled function type in emit_call"};
 	}
 	}
 }
 
-void FunctionBuilder::emit_object_method_call(const asCScriptFunction& function, llvm::Value* object)
+const asCScriptFunction* FunctionBuilder::get_function_pointer_signature(StackVariableIdentifier variable) const
 {
-	Builder&           builder = m_context.compiler->builder();
-	llvm::IRBuilder<>& ir      = builder.ir();
-	StandardTypes&     types   = builder.standard_types();
-	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	const auto& data = *m_context.script_function->scriptData;
 
-	ir.CreateCall(
-		funcs.call_object_method,
-		{object,
-		 ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&function)), types.pvoid)});
-}
+	const auto get_funcdef = [](asCTypeInfo* type) -> const asCScriptFunction* {
+		asCFuncdefType* funcdef_type = CastToFuncdefType(type);
+		return funcdef_type != nullptr ? funcdef_type->funcdef : nullptr;
+	};
 
-void FunctionBuilder::emit_conditional_branch(BytecodeInstruction ins, llvm::CmpInst::Predicate predicate)
-{
+	// Parameters and declared variables
+	for (asUINT i = 0; i < data.variables.GetLength(); ++i)
+	{
+		const asSScriptVariable& var = *data.variables[i];
+		if (var.stackOffset == variable && !var.type.IsReference())
+		{
+			if (const asCScriptFunction* funcdef = get_funcdef(var.type.GetTypeInfo()); funcdef != nullptr)
+			{
+				return funcdef;
+			}
+		}
+	}
+
+	// Temporary variables, e.g. holding a function pointer returned by a call or read from an object
+	for (asUINT i = 0; i < data.objVariablePos.GetLength(); ++i)
+	{
+		if (data.objVariablePos[i] == variable)
+		{
+			if (const asCScriptFunction* funcdef = get_funcdef(data.objVariableTypes[i]); funcdef != nullptr)
+			{
+				return funcdef;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+void FunctionBuilder::emit_function_pointer_call(const asCScriptFunction& signature, llvm::Value* function_pointer)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	// Call targets taking at least this ratio of the calls of the site directly
+	constexpr double min_target_ratio = 0.9;
+
+	emit_check_null_pointer(function_pointer);
+
+	if (m_instrumentation != nullptr)
+	{
+		VirtualCallProfile& profile = m_instrumentation->virtual_calls[m_current_offset];
+
+		ir.CreateCall(
+			funcs.profile_call_target,
+			{function_pointer,
+			 ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&profile)), types.pvoid)});
+	}
+
+	const FunctionPointerArguments args = pop_function_pointer_arguments(signature);
+
+	const auto emit_dispatch = [&] { return emit_function_pointer_dispatch(signature, function_pointer, args); };
+
+	llvm::Value* state = nullptr;
+
+	if (m_profile != nullptr)
+	{
+		if (auto it = m_profile->virtual_calls.find(m_current_offset); it != m_profile->virtual_calls.end())
+		{
+			const VirtualCallProfile& profile = it->second;
+			asCScriptFunction*        target  = profile.get_dominant_receiver(min_target_ratio);
+
+			if (target != nullptr && target->funcType == asFUNC_SCRIPT)
+			{
+				if (m_context.compiler->config().verbose)
+				{
+					m_context.compiler->diagnostic(fmt::format(
+						"promoting function pointer call at offset {} to {}",
+						m_current_offset,
+						target->GetDeclaration()));
+				}
+
+				const auto weights = profile.get_guard_weights(target);
+
+				// The addresses of discarded functions may be reused by other functions
+				state = emit_guarded_script_call(
+					ir.CreateAnd(
+						ir.CreateICmpEQ(
+							function_pointer,
+							ir.CreateIntToPtr(
+								llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(target)), types.pvoid)),
+						emit_is_discard_epoch_current()),
+					llvm::MDBuilder(context).createBranchWeights(weights[0], weights[1]),
+					*target,
+					args.values,
+					emit_dispatch);
+			}
+		}
+	}
+
+	if (state == nullptr)
+	{
+		state = emit_dispatch();
+	}
+
+	emit_check_vm_state(state);
+}
+
+void FunctionBuilder::emit_imported_call(int function_id)
+{
+	asCScriptEngine&   engine  = m_context.compiler->engine();
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	sBindInfo&               binding   = *engine.importedFunctions[function_id & ~FUNC_IMPORTED];
+	const asCScriptFunction& signature = *binding.importedFunctionSignature;
+
+	const FunctionPointerArguments args = pop_function_pointer_arguments(signature);
+
+	// Resolving the binding at runtime handles unbound and rebound imports, and imports bound to non-script functions
+	const auto emit_resolved_call = [&] {
+		llvm::CallInst* function = ir.CreateCall(
+			funcs.resolve_imported_function, {llvm::ConstantInt::get(types.i32, function_id)}, "boundFunction");
+		mark_no_script_global_access(function);
+
+		emit_check_exception(
+			ir.CreateICmpEQ(function, llvm::Constant::getNullValue(types.pvoid)), VmState::ExceptionUnboundFunction);
+
+		return emit_function_pointer_dispatch(signature, function, args);
+	};
+
+	// Script functions are all JIT'd, so a function bound by now is defined once all the modules are linked
+	asCScriptFunction* target
+		= binding.boundFunctionId >= 0 ? engine.scriptFunctions[binding.boundFunctionId] : nullptr;
+
+	llvm::Value* state = nullptr;
+
+	if (target != nullptr && target->funcType == asFUNC_SCRIPT)
+	{
+		llvm::Value* bound_id = ir.CreateLoad(
+			types.i32,
+			ir.CreateIntToPtr(
+				llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&binding.boundFunctionId)), types.pi32),
+			"boundFunctionId");
+
+		// The IDs of discarded functions are reused
+		state = emit_guarded_script_call(
+			ir.CreateAnd(
+				ir.CreateICmpEQ(bound_id, llvm::ConstantInt::get(types.i32, target->GetId())),
+				emit_is_discard_epoch_current()),
+			llvm::MDBuilder(context).createLikelyBranchWeights(),
+			*target,
+			args.values,
+			emit_resolved_call);
+	}
+	else
+	{
+		if (m_context.compiler->config().verbose)
+		{
+			m_context.compiler->diagnostic(fmt::format(
+				"import {} is not bound to a script function, calls to it are resolved at runtime",
+				signature.GetDeclaration()));
+		}
+
+		state = emit_resolved_call();
+	}
+
+	emit_check_vm_state(state);
+}
+
+FunctionBuilder::FunctionPointerArguments
+FunctionBuilder::pop_function_pointer_arguments(const asCScriptFunction& signature)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+
+	FunctionPointerArguments args;
+
+	// System functions are called through the VM, which expects the arguments exactly where they were pushed
+	args.vm_arguments = ir.CreatePointerCast(m_stack.pointer_to(m_stack.current_stack_pointer()), types.pvoid);
+
+	llvm::FunctionType* function_type = m_context.module_builder->get_script_function_type(signature);
+
+	if (signature.returnType.GetTokenType() != ttVoid)
+	{
+		if (signature.DoesReturnOnStack())
+		{
+			args.values.push_back(m_stack.pop(AS_PTR_SIZE, function_type->getParamType(0)));
+		}
+		else if (signature.returnType.IsObjectHandle() || signature.returnType.IsObject())
+		{
+			args.values.push_back(ir.CreatePointerCast(m_object_register, function_type->getParamType(0)));
+		}
+		else
+		{
+			args.values.push_back(ir.CreatePointerCast(m_value_register, function_type->getParamType(0)));
+		}
+
+		args.object_index = 1;
+	}
+
+	for (asUINT i = 0; i < signature.parameterTypes.GetLength(); ++i)
+	{
+		const asCDataType& type = signature.parameterTypes[i];
+		args.values.push_back(m_stack.pop(type.GetSizeOnStackDWords(), builder.to_llvm_type(type)));
+	}
+
+	args.values.push_back(m_vm_registers);
+
+	return args;
+}
+
+llvm::Value* FunctionBuilder::emit_function_pointer_dispatch(
+	const asCScriptFunction& signature, llvm::Value* function_pointer, const FunctionPointerArguments& args)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	llvm::FunctionType* function_type = m_context.module_builder->get_script_function_type(signature);
+
+	// Delegates call a method, with the object inserted where script methods expect it
+	std::vector<llvm::Type*> method_params(function_type->param_begin(), function_type->param_end());
+	method_params.insert(method_params.begin() + args.object_index, types.pvoid);
+	llvm::FunctionType* method_type = llvm::FunctionType::get(types.vm_state, method_params, false);
+
+	auto* cache_type = llvm::StructType::get(context, {types.pvoid, types.pvoid, types.i32});
+	auto* cache      = new llvm::GlobalVariable(
+		m_context.module_builder->module(),
+		cache_type,
+		false,
+		llvm::GlobalValue::InternalLinkage,
+		llvm::ConstantAggregateZero::get(cache_type),
+		"funcPtrCache");
+
+	llvm::BasicBlock* hit_block      = llvm::BasicBlock::Create(context, "funcPtrCacheHit", m_context.llvm_function);
+	llvm::BasicBlock* miss_block     = llvm::BasicBlock::Create(context, "funcPtrCacheMiss", m_context.llvm_function);
+	llvm::BasicBlock* resolved_block = llvm::BasicBlock::Create(context, "funcPtrResolved", m_context.llvm_function);
+	llvm::BasicBlock* function_block = llvm::BasicBlock::Create(context, "funcPtrCall", m_context.llvm_function);
+	llvm::BasicBlock* delegate_block = llvm::BasicBlock::Create(context, "delegateCall", m_context.llvm_function);
+	llvm::BasicBlock* system_block   = llvm::BasicBlock::Create(context, "systemFuncPtrCall", m_context.llvm_function);
+	llvm::BasicBlock* merge_block    = llvm::BasicBlock::Create(context, "afterFuncPtrCall", m_context.llvm_function);
+
+	std::vector<std::pair<llvm::Value*, llvm::BasicBlock*>> states;
+
+	const auto add_state = [&](llvm::CallInst* state) {
+		states.emplace_back(state, ir.GetInsertBlock());
+		ir.CreateBr(merge_block);
+	};
+
+	// See runtime::FunctionPointerCache: the entry and epoch are written before the function, which is only ever
+	// written once
+	llvm::LoadInst* cached_function = ir.CreateAlignedLoad(
+		types.pvoid, ir.CreateStructGEP(cache_type, cache, 0), llvm::MaybeAlign(alignof(void*)), "cachedFunction");
+	cached_function->setAtomic(llvm::AtomicOrdering::Acquire);
+
+	llvm::LoadInst* cached_epoch = ir.CreateAlignedLoad(
+		types.i32, ir.CreateStructGEP(cache_type, cache, 2), llvm::MaybeAlign(alignof(asUINT)), "cachedEpoch");
+	cached_epoch->setAtomic(llvm::AtomicOrdering::Acquire);
+
+	ir.CreateCondBr(
+		ir.CreateAnd(
+			ir.CreateICmpEQ(cached_function, function_pointer),
+			ir.CreateICmpEQ(cached_epoch, load_call_site_cache_epoch())),
+		hit_block,
+		miss_block);
+
+	ir.SetInsertPoint(hit_block);
+	llvm::Value* cached_entry = ir.CreateLoad(types.pvoid, ir.CreateStructGEP(cache_type, cache, 1), "cachedEntry");
+	ir.CreateBr(function_block);
+
+	ir.SetInsertPoint(miss_block);
+
+	llvm::AllocaInst* delegate_object_pointer = nullptr;
+
+	{
+		llvm::BasicBlock& entry_block = m_context.llvm_function->getEntryBlock();
+		llvm::IRBuilder<> entry_ir{&entry_block, entry_block.begin()};
+		delegate_object_pointer = entry_ir.CreateAlloca(types.pvoid, nullptr, "delegateObject");
+	}
+
+	llvm::Value* resolved_entry = ir.CreateCall(
+		funcs.resolve_function_pointer,
+		{function_pointer, delegate_object_pointer, ir.CreatePointerCast(cache, types.pvoid)},
+		"resolvedEntry");
+	llvm::Value* delegate_object = ir.CreateLoad(types.pvoid, delegate_object_pointer);
+
+	ir.CreateCondBr(
+		ir.CreateICmpEQ(resolved_entry, llvm::Constant::getNullValue(types.pvoid)), system_block, resolved_block);
+
+	ir.SetInsertPoint(resolved_block);
+	ir.CreateCondBr(
+		ir.CreateICmpEQ(delegate_object, llvm::Constant::getNullValue(types.pvoid)), function_block, delegate_block);
+
+	ir.SetInsertPoint(function_block);
+	llvm::PHINode* entry = ir.CreatePHI(types.pvoid, 2);
+	entry->addIncoming(cached_entry, hit_block);
+	entry->addIncoming(resolved_entry, resolved_block);
+
+	llvm::CallInst* function_state
+		= ir.CreateCall(function_type, ir.CreatePointerCast(entry, function_type->getPointerTo()), args.values);
+	function_state->setCallingConv(llvm::CallingConv::Tail);
+	add_state(function_state);
+
+	ir.SetInsertPoint(delegate_block);
+	std::vector<llvm::Value*> method_args = args.values;
+	method_args.insert(method_args.begin() + args.object_index, delegate_object);
+
+	llvm::CallInst* delegate_state
+		= ir.CreateCall(method_type, ir.CreatePointerCast(resolved_entry, method_type->getPointerTo()), method_args);
+	delegate_state->setCallingConv(llvm::CallingConv::Tail);
+	add_state(delegate_state);
+
+	ir.SetInsertPoint(system_block);
+	add_state(ir.CreateCall(
+		funcs.call_system_function_pointer,
+		{function_pointer,
+		 args.vm_arguments,
+		 ir.CreatePointerCast(m_value_register, types.pi64),
+		 ir.CreatePointerCast(m_object_register, types.pvoid)}));
+
+	ir.SetInsertPoint(merge_block);
+	llvm::PHINode* state = ir.CreatePHI(types.vm_state, states.size());
+	for (const auto& [value, block] : states)
+	{
+		state->addIncoming(value, block);
+	}
+
+	return state;
+}
+
+llvm::Value* FunctionBuilder::emit_guarded_script_call(
+	llvm::Value*                         condition,
+	llvm::MDNode*                        weights,
+	const asCScriptFunction&             target,
+	const std::vector<llvm::Value*>&     args,
+	const std::function<llvm::Value*()>& emit_fallback)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	llvm::Function* direct_function = m_context.module_builder->get_script_function(target);
+
+	llvm::BasicBlock* direct_block   = llvm::BasicBlock::Create(context, "directCall", m_context.llvm_function);
+	llvm::BasicBlock* fallback_block = llvm::BasicBlock::Create(context, "fallbackCall", m_context.llvm_function);
+	llvm::BasicBlock* merge_block    = llvm::BasicBlock::Create(context, "afterCall", m_context.llvm_function);
+
+	ir.CreateCondBr(condition, direct_block, fallback_block, weights);
+
+	ir.SetInsertPoint(direct_block);
+
+	// Parameter types may differ nominally, e.g. `this` between a virtual method and its implementation
+	std::vector<llvm::Value*> direct_args;
+	for (std::size_t i = 0; i < args.size(); ++i)
+	{
+		direct_args.push_back(ir.CreateBitOrPointerCast(args[i], direct_function->getFunctionType()->getParamType(i)));
+	}
+
+	llvm::CallInst* direct_state = ir.CreateCall(direct_function, direct_args);
+	direct_state->setCallingConv(llvm::CallingConv::Tail);
+	ir.CreateBr(merge_block);
+
+	ir.SetInsertPoint(fallback_block);
+	llvm::Value*      fallback_state     = emit_fallback();
+	llvm::BasicBlock* fallback_end_block = ir.GetInsertBlock();
+	if (fallback_state != nullptr)
+	{
+		ir.CreateBr(merge_block);
+	}
+
+	ir.SetInsertPoint(merge_block);
+	llvm::PHINode* state = ir.CreatePHI(types.vm_state, 2);
+	state->addIncoming(direct_state, direct_block);
+	if (fallback_state != nullptr)
+	{
+		state->addIncoming(fallback_state, fallback_end_block);
+	}
+
+	return state;
+}
+
+void FunctionBuilder::emit_object_method_call(const asCScriptFunction& function, llvm::Value* object)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+
+	ir.CreateCall(
+		funcs.call_object_method,
+		{object,
+		 ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&function)), types.pvoid)});
+}
+
+void FunctionBuilder::emit_conditional_branch(BytecodeInstruction ins, llvm::CmpInst::Predicate predicate)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+
+	llvm::Value* condition
+		= ir.CreateICmp(predicate, load_value_register_value(types.i32), llvm::ConstantInt::get(types.i32, 0));
+
+	emit_branch_if(ins, condition);
+}
+
+void FunctionBuilder::emit_branch_if(BytecodeInstruction ins, llvm::Value* condition)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	// Loops may not call any function for a long time, so they are interrupted at their back-edges
+	if (ins.arg_int() < 0)
+	{
+		emit_back_edge(ins.pointer);
+	}
+
+	if (m_instrumentation != nullptr)
+	{
+		BranchProfile& profile = m_instrumentation->branches[ins.offset];
+		emit_profile_counter_increment(
+			get_profile_counter_pointer(profile.executions), llvm::ConstantInt::get(types.i64, 1));
+		emit_profile_counter_increment(get_profile_counter_pointer(profile.taken), ir.CreateZExt(condition, types.i64));
+	}
+
+	llvm::BranchInst* branch
+		= ir.CreateCondBr(condition, get_branch_target(ins), get_conditional_fail_branch_target(ins));
+
+	if (m_profile != nullptr)
+	{
+		if (auto it = m_profile->branches.find(ins.offset);
+			it != m_profile->branches.end() && it->second.executions != 0)
+		{
+			const BranchProfile& profile = it->second;
+			const auto           weights = to_branch_weights({profile.taken, profile.executions - profile.taken});
+
+			branch->setMetadata(
+				llvm::LLVMContext::MD_prof, llvm::MDBuilder(context).createBranchWeights(weights[0], weights[1]));
+		}
+	}
+}
+
+llvm::Value*
+FunctionBuilder::resolve_virtual_script_function(llvm::Value* script_object, const asCScriptFunction& callee)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+
+	emit_check_null_pointer(script_object);
+
+	const bool is_final = callee.IsFinal() || ((callee.objectType->flags & asOBJ_NOINHERIT) != 0);
+
+	if (m_context.compiler->config().allow_devirtualization && is_final)
+	{
+		asCScriptFunction* resolved_script_function = get_nonvirtual_match(callee);
+		asllvm_assert(resolved_script_function != nullptr);
+
+		return m_context.module_builder->get_script_function(*resolved_script_function);
+	}
+	else
+	{
+		llvm::Value* function_value = ir.CreateIntToPtr(
+			llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&callee)),
+			types.pvoid,
+			"virtual_script_function");
+
+		llvm::CallInst* lookup = nullptr;
+
+		if (m_instrumentation != nullptr)
+		{
+			VirtualCallProfile& profile = m_instrumentation->virtual_calls[m_current_offset];
+
+			lookup = ir.CreateCall(
+				funcs.profiled_script_vtable_lookup,
+				{script_object,
+				 function_value,
+				 ir.CreateIntToPtr(
+					 llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&profile)), types.pvoid)});
+		}
+		else
+		{
+			lookup = ir.CreateCall(funcs.script_vtable_lookup, {script_object, function_value});
+		}
+
+		return ir.CreatePointerCast(
+			lookup, m_context.module_builder->get_script_function_type(callee)->getPointerTo(), "resolved_vcall");
+	}
+}
+
+llvm::Value* FunctionBuilder::resolve_interface_method(llvm::Value* script_object, const asCScriptFunction& callee)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	const std::size_t method_index = get_interface_method_index(callee);
+	asllvm_assert(method_index < callee.objectType->methods.GetLength());
+
+	auto* cache_type = llvm::StructType::get(context, {types.pvoid, types.pvoid, types.i32});
+	auto* cache      = new llvm::GlobalVariable(
+		m_context.module_builder->module(),
+		cache_type,
+		false,
+		llvm::GlobalValue::InternalLinkage,
+		llvm::ConstantAggregateZero::get(cache_type),
+		"intfCallCache");
+
+	llvm::BasicBlock* hit_block      = llvm::BasicBlock::Create(context, "intfCacheHit", m_context.llvm_function);
+	llvm::BasicBlock* miss_block     = llvm::BasicBlock::Create(context, "intfCacheMiss", m_context.llvm_function);
+	llvm::BasicBlock* resolved_block = llvm::BasicBlock::Create(context, "intfResolved", m_context.llvm_function);
+
+	llvm::Value* object_type = load_script_object_type(script_object);
+
+	// See runtime::InterfaceCallCache: the entry and epoch are written before the class, which is only ever written
+	// once
+	llvm::LoadInst* cached_object_type = ir.CreateAlignedLoad(
+		types.pvoid, ir.CreateStructGEP(cache_type, cache, 0), llvm::MaybeAlign(alignof(void*)), "cachedObjectType");
+	cached_object_type->setAtomic(llvm::AtomicOrdering::Acquire);
+
+	llvm::LoadInst* cached_epoch = ir.CreateAlignedLoad(
+		types.i32, ir.CreateStructGEP(cache_type, cache, 2), llvm::MaybeAlign(alignof(asUINT)), "cachedEpoch");
+	cached_epoch->setAtomic(llvm::AtomicOrdering::Acquire);
+
+	ir.CreateCondBr(
+		ir.CreateAnd(
+			ir.CreateICmpEQ(cached_object_type, object_type),
+			ir.CreateICmpEQ(cached_epoch, load_call_site_cache_epoch())),
+		hit_block,
+		miss_block,
+		llvm::MDBuilder(context).createLikelyBranchWeights());
+
+	ir.SetInsertPoint(hit_block);
+	llvm::Value* cached_entry = ir.CreateLoad(types.pvoid, ir.CreateStructGEP(cache_type, cache, 1), "cachedEntry");
+	ir.CreateBr(resolved_block);
+
+	ir.SetInsertPoint(miss_block);
+	llvm::Value* resolved_entry = ir.CreateCall(
+		funcs.resolve_interface_method,
+		{ir.CreatePointerCast(script_object, types.pvoid),
+		 ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&callee)), types.pvoid),
+		 llvm::ConstantInt::get(types.i32, method_index),
+		 ir.CreatePointerCast(cache, types.pvoid)},
+		"resolvedEntry");
+	ir.CreateBr(resolved_block);
+
+	ir.SetInsertPoint(resolved_block);
+	llvm::PHINode* entry = ir.CreatePHI(types.pvoid, 2);
+	entry->addIncoming(cached_entry, hit_block);
+	entry->addIncoming(resolved_entry, miss_block);
+
+	return ir.CreatePointerCast(
+		entry, m_context.module_builder->get_script_function_type(callee)->getPointerTo(), "resolved_icall");
+}
+
+void FunctionBuilder::emit_script_object_cast(const asCObjectType& target)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+	asCScriptEngine&   engine  = m_context.compiler->engine();
+
+	const bool is_interface = target.IsInterface();
+	const bool is_final     = !is_interface && (target.flags & asOBJ_NOINHERIT) != 0;
+
+	// Index of the target class in the supertypes of its subclasses, see runtime::DispatchTable
+	std::uint32_t target_depth = 0;
+	for (const asCObjectType* base = target.derivedFrom; base != nullptr; base = base->derivedFrom)
+	{
+		++target_depth;
+	}
+
+	llvm::BasicBlock* load_block    = llvm::BasicBlock::Create(context, "castLoadHandle", m_context.llvm_function);
+	llvm::BasicBlock* check_block   = llvm::BasicBlock::Create(context, "castCheck", m_context.llvm_function);
+	llvm::BasicBlock* success_block = llvm::BasicBlock::Create(context, "castSuccess", m_context.llvm_function);
+	llvm::BasicBlock* merge_block   = llvm::BasicBlock::Create(context, "afterCast", m_context.llvm_function);
+
+	llvm::Value* null = llvm::Constant::getNullValue(types.pvoid);
+
+	// Like in the VM, casting a null reference or a null handle leaves the object register null
+	llvm::Value* handle_pointer = m_stack.pop(AS_PTR_SIZE, types.pvoid->getPointerTo());
+	ir.CreateCondBr(
+		ir.CreateICmpEQ(handle_pointer, llvm::Constant::getNullValue(handle_pointer->getType())),
+		merge_block,
+		load_block);
+
+	ir.SetInsertPoint(load_block);
+	llvm::Value* object = ir.CreateLoad(types.pvoid, handle_pointer, "castedObject");
+	ir.CreateCondBr(ir.CreateICmpEQ(object, null), merge_block, check_block);
+
+	ir.SetInsertPoint(check_block);
+	llvm::Value* object_type = load_script_object_type(object);
+	llvm::Value* target_type
+		= ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&target)), types.pvoid);
+
+	if (is_final)
+	{
+		// Nothing can derive from the target, so this is the whole subtype test
+		ir.CreateCondBr(ir.CreateICmpEQ(object_type, target_type), success_block, merge_block);
+	}
+	else
+	{
+		llvm::BasicBlock* cache_block = llvm::BasicBlock::Create(context, "castCacheCheck", m_context.llvm_function);
+		llvm::BasicBlock* slow_block  = llvm::BasicBlock::Create(context, "castSubtypeCheck", m_context.llvm_function);
+
+		auto* cache_type = llvm::StructType::get(context, {types.pvoid, types.i32});
+		auto* cache      = new llvm::GlobalVariable(
+			m_context.module_builder->module(),
+			cache_type,
+			false,
+			llvm::GlobalValue::InternalLinkage,
+			llvm::ConstantAggregateZero::get(cache_type),
+			"castCache");
+
+		// Objects are never exactly of an interface type
+		if (is_interface)
+		{
+			ir.CreateBr(cache_block);
+		}
+		else
+		{
+			ir.CreateCondBr(ir.CreateICmpEQ(object_type, target_type), success_block, cache_block);
+		}
+
+		// See runtime::CastCache: any class found there during the current epoch is a subtype of the target
+		ir.SetInsertPoint(cache_block);
+		llvm::LoadInst* cached_epoch = ir.CreateAlignedLoad(
+			types.i32, ir.CreateStructGEP(cache_type, cache, 1), llvm::MaybeAlign(alignof(asUINT)), "cachedEpoch");
+		cached_epoch->setAtomic(llvm::AtomicOrdering::Acquire);
+
+		llvm::LoadInst* cached_object_type = ir.CreateAlignedLoad(
+			types.pvoid,
+			ir.CreateStructGEP(cache_type, cache, 0),
+			llvm::MaybeAlign(alignof(void*)),
+			"cachedObjectType");
+		cached_object_type->setAtomic(llvm::AtomicOrdering::Monotonic);
+
+		ir.CreateCondBr(
+			ir.CreateAnd(
+				ir.CreateICmpEQ(cached_object_type, object_type),
+				ir.CreateICmpEQ(cached_epoch, load_call_site_cache_epoch())),
+			success_block,
+			slow_block,
+			llvm::MDBuilder(context).createLikelyBranchWeights());
+
+		ir.SetInsertPoint(slow_block);
+		llvm::Value* result = ir.CreateCall(
+			funcs.cast_script_object,
+			{object,
+			 target_type,
+			 llvm::ConstantInt::get(types.i32, target_depth),
+			 ir.CreatePointerCast(cache, types.pvoid)},
+			"castResult");
+		ir.CreateCondBr(ir.CreateICmpEQ(result, null), merge_block, success_block);
+	}
+
+	// All script objects share the behaviours of script classes
+	ir.SetInsertPoint(success_block);
+	emit_object_method_call(*engine.scriptFunctions[engine.scriptTypeBehaviours.beh.addref], object);
+	store_object_register_value(object);
+	ir.CreateBr(merge_block);
+
+	ir.SetInsertPoint(merge_block);
+}
+
+llvm::Value* FunctionBuilder::emit_guarded_direct_call(
+	const asCScriptFunction&         callee,
+	llvm::FunctionType*              callee_type,
+	llvm::Value*                     resolved_function,
+	const std::vector<llvm::Value*>& args)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	// Promote calls taking at least this ratio of the calls of the site
+	constexpr double min_receiver_ratio = 0.9;
+
+	if (m_profile == nullptr || llvm::isa<llvm::Function>(resolved_function))
+	{
+		return nullptr;
+	}
+
+	auto it = m_profile->virtual_calls.find(m_current_offset);
+	if (it == m_profile->virtual_calls.end())
+	{
+		return nullptr;
+	}
+
+	const VirtualCallProfile& profile  = it->second;
+	asCScriptFunction*        receiver = profile.get_dominant_receiver(min_receiver_ratio);
+
+	if (receiver == nullptr || receiver->funcType != asFUNC_SCRIPT)
+	{
+		return nullptr;
+	}
+
+	// Speculate that no other receiver is ever called, unless that turned out wrong before
+	const bool is_speculative = !m_is_osr_variant && profile.get_dominant_receiver(1.0) != nullptr
+								&& profile.deoptimizations == 0 && can_deoptimize();
+
+	if (m_context.compiler->config().verbose)
+	{
+		m_context.compiler->diagnostic(fmt::format(
+			"promoting virtual call to {} at offset {} to {}{}",
+			callee.GetDeclaration(),
+			m_current_offset,
+			receiver->GetDeclaration(),
+			is_speculative ? ", leaving other receivers to the VM" : ""));
+	}
+
+	llvm::Function* direct_function = m_context.module_builder->get_script_function(*receiver);
+	const auto      weights         = profile.get_guard_weights(receiver);
+
+	return emit_guarded_script_call(
+		ir.CreateICmpEQ(resolved_function, ir.CreatePointerCast(direct_function, resolved_function->getType())),
+		is_speculative ? llvm::MDBuilder(context).createLikelyBranchWeights()
+					   : llvm::MDBuilder(context).createBranchWeights(weights[0], weights[1]),
+		*receiver,
+		args,
+		[&]() -> llvm::Value* {
+			if (is_speculative)
+			{
+				// The profile counters are never moved, and are shared with the profile this was compiled for
+				FunctionProfile& function_profile
+					= m_context.compiler->get_function_profile(m_context.script_function->GetId());
+
+				emit_deoptimization(
+					call_stack_pointer, function_profile.virtual_calls[m_current_offset].deoptimizations);
+				return nullptr;
+			}
+
+			llvm::CallInst* indirect_state = ir.CreateCall(callee_type, resolved_function, args);
+			indirect_state->setCallingConv(llvm::CallingConv::Tail);
+			return indirect_state;
+		});
+}
+
+bool FunctionBuilder::has_relocatable_frame() const
+{
+	const asSScriptFunctionData& script_data = *m_context.script_function->scriptData;
+	return script_data.objVariablesOnHeap == script_data.objVariablePos.GetLength();
+}
+
+bool FunctionBuilder::can_deoptimize() const
+{
+	return !m_context.script_function->DoesReturnOnStack() && has_relocatable_frame();
+}
+
+bool FunctionBuilder::has_native_signature() const
+{
+	const asCScriptFunction& script_function = *m_context.script_function;
+
+	const auto is_object_by_value
+		= [](const asCDataType& type) { return type.IsObject() && !type.IsObjectHandle() && !type.IsReference(); };
+
+	if (is_object_by_value(script_function.returnType))
+	{
+		return false;
+	}
+
+	for (asUINT i = 0; i < script_function.parameterTypes.GetLength(); ++i)
+	{
+		if (is_object_by_value(script_function.parameterTypes[i]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FunctionBuilder::emit_osr_dispatch(llvm::BasicBlock* block, const asDWORD* bytecode)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	const asSScriptFunctionData& script_data = *m_context.script_function->scriptData;
+
+	ir.SetInsertPoint(block);
+	ir.SetCurrentDebugLocation(get_debug_location(m_context, 0, m_context.llvm_function->getSubprogram()));
+
+	llvm::Value* frame_pointer = ir.CreateLoad(
+		types.pi32,
+		ir.CreateInBoundsGEP(
+			m_vm_registers, {llvm::ConstantInt::get(types.i64, 0), llvm::ConstantInt::get(types.i32, 1)}),
+		"vmFramePointer");
+
+	llvm::Value* program_pointer = ir.CreateLoad(
+		types.pi32,
+		ir.CreateInBoundsGEP(
+			m_vm_registers, {llvm::ConstantInt::get(types.i64, 0), llvm::ConstantInt::get(types.i32, 0)}),
+		"vmProgramPointer");
+
+	// Loops are entered with an empty stack, so only the variables are copied. They end right below `l_fp`, like
+	// they end the storage. Parameters were passed by the VM entry thunk.
+	const long variable_space = m_stack.variable_space();
+	if (variable_space > 0)
+	{
+		ir.CreateMemCpy(
+			m_stack.pointer_to(variable_space, types.i32),
+			llvm::MaybeAlign(4),
+			ir.CreateInBoundsGEP(frame_pointer, {llvm::ConstantInt::get(types.iptr, -variable_space)}),
+			llvm::MaybeAlign(4),
+			variable_space * sizeof(asDWORD));
+	}
+
+	// The JIT'd code owns the objects of the frame from now on, so the VM must not release them again when unwinding
+	for (asUINT i = 0; i < script_data.objVariablesOnHeap; ++i)
+	{
+		llvm::Value* dword_pointer = ir.CreateInBoundsGEP(
+			frame_pointer, {llvm::ConstantInt::get(types.iptr, -long(script_data.objVariablePos[i]))});
+		ir.CreateStore(
+			llvm::Constant::getNullValue(types.pvoid),
+			ir.CreatePointerCast(dword_pointer, types.pvoid->getPointerTo()));
+	}
+
+	// The VM only ever enters the variant at the asBC_JitEntry of a loop header. Anything else is a bug, which must
+	// not be left undefined: the objects of the frame were taken over already, so it cannot be resumed in the VM.
+	llvm::BasicBlock* invalid_block = llvm::BasicBlock::Create(context, "invalidOsrEntry", m_context.llvm_function);
+
+	llvm::SwitchInst* dispatch
+		= ir.CreateSwitch(ir.CreatePtrToInt(program_pointer, types.iptr), invalid_block, m_osr_entries.size());
+
+	for (const auto& [offset, entry_block] : m_osr_entries)
+	{
+		dispatch->addCase(
+			llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(bytecode + offset)), entry_block);
+	}
+
+	ir.SetInsertPoint(invalid_block);
+	ir.CreateCall(funcs.panic);
+	ir.CreateUnreachable();
+}
+
+void FunctionBuilder::emit_deoptimization(StackFrame::AsStackOffset stack_pointer, std::uint64_t& counter)
+{
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+
+	m_has_deoptimization_points = true;
+
+	const asCScriptFunction& function = *m_context.script_function;
+
+	// Parameters are laid out like on the VM stack, where the parameter at stack offset `-n` is at `l_fp[n]`
+	const long parameter_dwords
+		= function.GetSpaceNeededForArguments() + (function.objectType != nullptr ? AS_PTR_SIZE : 0);
+	llvm::AllocaInst* parameters = nullptr;
+
+	{
+		llvm::BasicBlock& entry_block = m_context.llvm_function->getEntryBlock();
+		llvm::IRBuilder<> entry_ir{&entry_block, entry_block.begin()};
+		parameters = entry_ir.CreateAlloca(
+			llvm::ArrayType::get(types.i32, std::max(parameter_dwords, 1L)), nullptr, "deoptimizedParameters");
+	}
+
+	for (const auto& [offset, parameter] : m_stack.parameters())
+	{
+		llvm::Value* dword_pointer = ir.CreateInBoundsGEP(
+			parameters, {llvm::ConstantInt::get(types.iptr, 0), llvm::ConstantInt::get(types.iptr, -offset)});
+
+		llvm::Type*  type  = parameter.local_alloca->getAllocatedType();
+		llvm::Value* value = ir.CreateLoad(type, parameter.local_alloca);
+		ir.CreateAlignedStore(value, ir.CreatePointerCast(dword_pointer, type->getPointerTo()), llvm::MaybeAlign(4));
+	}
+
+	// The storage ends with the variable at stack offset 1, like the VM frame ends right below `l_fp`
+	llvm::Value* frame = m_stack.pointer_to(stack_pointer, types.i32);
+
+	llvm::Value* return_pointer = function.returnType.GetTokenType() != ttVoid
+									  ? ir.CreatePointerCast(m_context.llvm_function->getArg(0), types.pvoid)
+									  : llvm::Constant::getNullValue(types.pvoid);
+
+	llvm::Value* state = ir.CreateCall(
+		funcs.deoptimize,
+		{m_vm_registers,
+		 ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&function)), types.pvoid),
+		 llvm::ConstantInt::get(types.i32, m_current_offset),
+		 ir.CreatePointerCast(parameters, types.pi32),
+		 frame,
+		 llvm::ConstantInt::get(types.i32, stack_pointer),
+		 load_value_register_value(types.i64),
+		 return_pointer,
+		 get_profile_counter_pointer(counter)});
+
+	ir.CreateRet(state);
+}
+
+llvm::Value* FunctionBuilder::get_profile_counter_pointer(std::uint64_t& counter)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+
+	return ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&counter)), types.pi64);
+}
+
+void FunctionBuilder::emit_profile_counter_increment(llvm::Value* counter, llvm::Value* amount)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+
+	ir.CreateStore(ir.CreateAdd(ir.CreateLoad(types.i64, counter), amount), counter);
+}
+
+void FunctionBuilder::store_value_register_value(llvm::Value* value)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	llvm::StoreInst* store = ir.CreateStore(value, get_value_register_pointer(value->getType()));
+	store->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().value_register);
+}
+
+llvm::Value* FunctionBuilder::load_value_register_value(llvm::Type* type)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	llvm::LoadInst* load = ir.CreateLoad(type, get_value_register_pointer(type));
+	load->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().value_register);
+	return load;
+}
+
+llvm::Value* FunctionBuilder::get_value_register_pointer(llvm::Type* type)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	return ir.CreatePointerCast(m_value_register, type->getPointerTo());
+}
+
+llvm::Value* FunctionBuilder::load_script_object_type(llvm::Value* script_object)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+
+	// Layout of asCScriptObject: its type follows the vtable pointer of asIScriptObject
+	constexpr std::uint64_t object_type_offset = sizeof(void*);
+
+	llvm::Value* pointer = ir.CreateInBoundsGEP(
+		ir.CreatePointerCast(script_object, types.pi8), llvm::ConstantInt::get(types.iptr, object_type_offset));
+	return ir.CreateLoad(types.pvoid, ir.CreatePointerCast(pointer, types.pvoid->getPointerTo()), "objectType");
+}
+
+void FunctionBuilder::store_object_register_value(llvm::Value* value)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	llvm::StoreInst* store = ir.CreateStore(value, m_object_register);
+	store->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().object_register);
+}
+
+llvm::Value* FunctionBuilder::load_object_register_value()
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+
+	llvm::LoadInst* load = ir.CreateLoad(types.pvoid, m_object_register);
+	load->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().object_register);
+	return load;
+}
+
+void FunctionBuilder::insert_label(long offset)
+{
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext(); // long boi
+
+	auto       emplace_result = m_jump_map.emplace(offset, nullptr);
+	const bool success        = emplace_result.second;
+
+	if (!success)
+	{
+		// there was a label here already; no need to recreate one
+		return;
+	}
+
+	auto it    = emplace_result.first;
+	it->second = llvm::BasicBlock::Create(context, fmt::format("branch_to_{:04x}", offset), m_context.llvm_function);
+}
+
+void FunctionBuilder::preprocess_conditional_branch(BytecodeInstruction instruction)
+{
+	insert_label(instruction.offset + 2);
+	preprocess_unconditional_branch(instruction);
+}
+
+void FunctionBuilder::preprocess_unconditional_branch(BytecodeInstruction instruction)
+{
+	insert_label(instruction.offset + 2 + instruction.arg_int());
+}
+
+llvm::BasicBlock* FunctionBuilder::get_branch_target(BytecodeInstruction instruction)
+{
+	return m_jump_map.at(instruction.offset + 2 + instruction.arg_int());
+}
+
+llvm::BasicBlock* FunctionBuilder::get_conditional_fail_branch_target(BytecodeInstruction instruction)
+{
+	return m_jump_map.at(instruction.offset + 2);
+}
+
+void FunctionBuilder::switch_to_block(llvm::BasicBlock* block)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	if (auto* current_terminator = ir.GetInsertBlock()->getTerminator(); current_terminator == nullptr)
+	{
+		// The current block has no terminator: insert a branch to the current one, which immediately follows it.
+		ir.CreateBr(block);
+	}
+
+	ir.SetInsertPoint(block);
+}
+
+void FunctionBuilder::create_function_debug_info(llvm::Function* function, GeneratedFunctionType type)
+{
+	asCScriptEngine&   engine            = m_context.compiler->engine();
+	llvm::IRBuilder<>& ir                = m_context.compiler->builder().ir();
+	llvm::DIBuilder&   di                = m_context.module_builder->di_builder();
+	ModuleDebugInfo&   module_debug_info = m_context.module_builder->debug_info();
+
+	std::vector<llvm::Metadata*> types;
+	{
+		types.push_back(m_context.module_builder->get_debug_type(asTYPEID_INT8)); // TODO: make a separate type for ret
+
+		types.push_back(m_context.module_builder->get_debug_type(
+			engine.GetTypeIdFromDataType(m_context.script_function->returnType)));
+
+		if (m_context.script_function->objectType != nullptr)
+		{
+			types.push_back(m_context.module_builder->get_debug_type(m_context.script_function->objectType->typeId));
+		}
+
+		const std::size_t count = m_context.script_function->GetParamCount();
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			int type_id = 0;
+			m_context.script_function->GetParam(i, &type_id);
+			types.push_back(m_context.module_builder->get_debug_type(type_id));
+		}
+	}
+
+	llvm::DIFile* file = di.createFile(m_context.script_function->GetScriptSectionName(), ".");
+
+	const auto location = get_source_location(m_context);
+
+	std::string_view symbol_suffix;
+
+	switch (type)
+	{
+	case GeneratedFunctionType::Implementation: break;
+	case GeneratedFunctionType::VmEntryThunk: symbol_suffix = "!vmthunk"; break;
+	case GeneratedFunctionType::NativeEntry: symbol_suffix = "!native"; break;
+	case GeneratedFunctionType::BatchEntry: symbol_suffix = "!batch"; break;
+	}
+
+	llvm::DISubprogram* sp = di.createFunction(
+		module_debug_info.compile_unit,
+		fmt::format("{}{}", make_debug_name(*m_context.script_function), symbol_suffix),
+		llvm::StringRef{},
+		file,
+		location.line,
+		di.createSubroutineType(di.getOrCreateTypeArray(types)),
+		location.line,
+		llvm::DINode::FlagPrototyped | llvm::DINode::FlagThunk,
+		llvm::DISubprogram::SPFlagDefinition);
+
+	function->setSubprogram(sp);
+
+	ir.SetCurrentDebugLocation(get_debug_location(m_context, 0, sp));
+}
+
+llvm::Value* FunctionBuilder::load_global(asPWORD address, llvm::Type* type)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	if (auto* integer_type = llvm::dyn_cast<llvm::IntegerType>(type); integer_type != nullptr)
+	{
+		if (llvm::Constant* value = m_context.module_builder->get_constant_global_value(address, integer_type);
+			value != nullptr)
+		{
+			return value;
+		}
+	}
+
+	llvm::LoadInst* load = ir.CreateLoad(type, get_global_pointer(address, type));
+	load->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().global);
+	mark_script_global_access(load, address);
+	return load;
+}
+
+void FunctionBuilder::store_global(asPWORD address, llvm::Value* value)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	llvm::StoreInst* store = ir.CreateStore(value, get_global_pointer(address, value->getType()));
+	store->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().global);
+	mark_script_global_access(store, address);
+}
+
+llvm::Value* FunctionBuilder::get_global_pointer(asPWORD address, llvm::Type* type)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+
+	return ir.CreatePointerCast(m_context.module_builder->get_global_variable(address, type), type->getPointerTo());
+}
+
+void FunctionBuilder::mark_no_script_global_access(llvm::CallInst* call)
+{
+	Builder& builder = m_context.compiler->builder();
+
+	if (m_context.compiler->config().assume_system_calls_dont_touch_script_globals)
+	{
+		call->setMetadata(llvm::LLVMContext::MD_noalias, builder.alias_scopes().script_globals);
+	}
+}
+
+void FunctionBuilder::mark_script_global_access(llvm::Instruction* instruction, asPWORD address)
+{
+	Builder& builder = m_context.compiler->builder();
+
+	// Only useful to disambiguate against calls marked by mark_no_script_global_access
+	if (m_context.compiler->config().assume_system_calls_dont_touch_script_globals
+		&& m_context.module_builder->is_script_global(address))
+	{
+		instruction->setMetadata(llvm::LLVMContext::MD_alias_scope, builder.alias_scopes().script_globals);
+	}
+}
+
+llvm::BranchInst* FunctionBuilder::emit_check_boolean(llvm::Value* value, llvm::Value* state_if_true)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	// e.g. when checking a constant divisor
+	if (auto* constant = llvm::dyn_cast<llvm::ConstantInt>(value); constant != nullptr && constant->isZero())
+	{
+		return nullptr;
+	}
+
+	llvm::Function* parent         = ir.GetInsertBlock()->getParent();
+	llvm::MDNode*   branch_weights = llvm::MDBuilder(context).createBranchWeights(1, 2000);
+
+	llvm::BasicBlock* on_false = llvm::BasicBlock::Create(context, "doNotSetVmException", parent);
+
+	if (m_generated_type == GeneratedFunctionType::Implementation)
+	{
+		llvm::PHINode* raised_state = get_exception_handler_state(get_exception_handler(m_current_offset));
+		raised_state->addIncoming(state_if_true, ir.GetInsertBlock());
+
+		llvm::BranchInst* branch = ir.CreateCondBr(value, raised_state->getParent(), on_false, branch_weights);
+		ir.SetInsertPoint(on_false);
+		return branch;
+	}
+
+	llvm::BasicBlock* on_true = llvm::BasicBlock::Create(context, "setVmException", parent);
+
+	llvm::BranchInst* branch = ir.CreateCondBr(value, on_true, on_false, branch_weights);
+
+	ir.SetInsertPoint(on_true);
+	emit_vm_exception_return(state_if_true);
+
+	if (m_generated_type == GeneratedFunctionType::VmEntryThunk)
+	{
+		ir.CreateBr(on_false);
+	}
+
+	ir.SetInsertPoint(on_false);
+	return branch;
+}
+
+llvm::BranchInst* FunctionBuilder::emit_check_exception(llvm::Value* condition, VmState state)
+{
+	Builder&       builder = m_context.compiler->builder();
+	StandardTypes& types   = builder.standard_types();
+
+	return emit_check_boolean(condition, llvm::ConstantInt::get(types.vm_state, std::uint64_t(state)));
+}
+
+FunctionBuilder::ExceptionHandler FunctionBuilder::get_exception_handler(long offset) const
+{
+	const asCScriptFunction&     function    = *m_context.script_function;
+	const asSScriptFunctionData& script_data = *function.scriptData;
+
+	ExceptionHandler handler;
+
+	// Try blocks are listed from the outermost, so the last one enclosing the instruction catches
+	long try_offset = -1;
+	for (const asSTryCatchInfo& info : script_data.tryCatchInfo)
+	{
+		if (long(info.tryPos) <= offset && offset < long(info.catchPos))
+		{
+			try_offset           = info.tryPos;
+			handler.catch_offset = info.catchPos;
+		}
+	}
 
-	llvm::Value* condition
-		= ir.CreateICmp(predicate, load_value_register_value(types.i32), llvm::ConstantInt::get(types.i32, 0));
+	const bool is_caught = handler.catch_offset != -1;
+
+	// When caught, only the variables declared within the try block are cleaned up, see asCContext::CleanStackFrame
+	const auto is_declared_within_try = [&](int variable_offset) {
+		for (const asSObjectVariableInfo& info : script_data.objVariableInfo)
+		{
+			if (info.option != asOBJ_VARDECL || info.variableOffset != variable_offset)
+			{
+				continue;
+			}
+
+			if (long(info.programPos) < try_offset)
+			{
+				return false;
+			}
+
+			if (long(info.programPos) < offset)
+			{
+				return true;
+			}
+		}
+
+		// Temporary variables are not declared
+		return true;
+	};
+
+	// Whether a value object on the stack was constructed, see asCContext::DetermineLiveObjects
+	const auto is_alive = [&](int variable_offset) {
+		int liveness = 0;
+
+		for (long i = long(script_data.objVariableInfo.GetLength()) - 1; i >= 0; --i)
+		{
+			const asSObjectVariableInfo& info = script_data.objVariableInfo[i];
+
+			if (long(info.programPos) > offset)
+			{
+				continue;
+			}
+
+			if (info.option == asBLOCK_END)
+			{
+				// Variables of a block that has ended were already destroyed
+				for (int nesting = 1; nesting > 0 && i > 0;)
+				{
+					--i;
+					nesting += script_data.objVariableInfo[i].option == asBLOCK_END ? 1 : 0;
+					nesting -= script_data.objVariableInfo[i].option == asBLOCK_BEGIN ? 1 : 0;
+				}
+			}
+			else if (info.variableOffset == variable_offset)
+			{
+				liveness += info.option == asOBJ_INIT ? 1 : 0;
+				liveness -= info.option == asOBJ_UNINIT ? 1 : 0;
+			}
+		}
+
+		return liveness > 0;
+	};
+
+	for (asUINT i = 0; i < script_data.objVariablePos.GetLength(); ++i)
+	{
+		const int  variable_offset = script_data.objVariablePos[i];
+		const bool is_released     = !is_caught || is_declared_within_try(variable_offset);
+
+		if (i < script_data.objVariablesOnHeap)
+		{
+			(is_released ? handler.heap_objects : handler.uncaught_heap_objects)
+				.emplace_back(variable_offset, script_data.objVariableTypes[i]);
+		}
+		else if (is_alive(variable_offset))
+		{
+			(is_released ? handler.stack_objects : handler.uncaught_stack_objects)
+				.emplace_back(variable_offset, script_data.objVariableTypes[i]);
+		}
+	}
+
+	// Parameters are owned by the callee, which releases them when returning, or here when unwinding
+	const std::vector<FrameObject> parameters     = get_object_parameters();
+	std::vector<FrameObject>&      parameter_slots = is_caught ? handler.uncaught_heap_objects : handler.heap_objects;
+	parameter_slots.insert(parameter_slots.end(), parameters.begin(), parameters.end());
 
-	ir.CreateCondBr(condition, get_branch_target(ins), get_conditional_fail_branch_target(ins));
+	return handler;
 }
 
-llvm::Value*
-FunctionBuilder::resolve_virtual_script_function(llvm::Value* script_object, const asCScriptFunction& callee)
+std::vector<FunctionBuilder::FrameObject> FunctionBuilder::get_object_parameters() const
 {
-	Builder&           builder = m_context.compiler->builder();
-	llvm::IRBuilder<>& ir      = builder.ir();
-	StandardTypes&     types   = builder.standard_types();
-	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	const asCScriptFunction& function = *m_context.script_function;
 
-	emit_check_null_pointer(script_object);
+	std::vector<FrameObject> parameters;
 
-	const bool is_final = callee.IsFinal() || ((callee.objectType->flags & asOBJ_NOINHERIT) != 0);
+	// Same layout as the parameters of the stack frame, see StackFrame::allocate_parameter_storage
+	StackFrame::AsStackOffset offset = 0;
 
-	if (m_context.compiler->config().allow_devirtualization && is_final)
+	if (function.DoesReturnOnStack())
 	{
-		asCScriptFunction* resolved_script_function = get_nonvirtual_match(callee);
-		asllvm_assert(resolved_script_function != nullptr);
+		offset -= AS_PTR_SIZE;
+	}
 
-		return m_context.module_builder->get_script_function(*resolved_script_function);
+	if (function.objectType != nullptr)
+	{
+		offset -= AS_PTR_SIZE;
 	}
-	else
+
+	for (asUINT i = 0; i < function.parameterTypes.GetLength(); ++i)
 	{
-		llvm::Value* function_value = ir.CreateIntToPtr(
-			llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&callee)),
-			types.pvoid,
-			"virtual_script_function");
+		const asCDataType& type = function.parameterTypes[i];
 
-		return ir.CreatePointerCast(
-			ir.CreateCall(funcs.script_vtable_lookup, {script_object, function_value}),
-			m_context.module_builder->get_script_function_type(callee)->getPointerTo(),
-			"resolved_vcall");
+		if (type.IsObject() && !type.IsReference())
+		{
+			parameters.emplace_back(offset, type.GetTypeInfo());
+		}
+
+		offset -= type.GetSizeOnStackDWords();
 	}
+
+	return parameters;
 }
 
-void FunctionBuilder::store_value_register_value(llvm::Value* value)
+llvm::PHINode* FunctionBuilder::get_exception_handler_state(const ExceptionHandler& handler)
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
 
-	ir.CreateStore(value, get_value_register_pointer(value->getType()));
-}
+	if (auto it = m_exception_handlers.find(handler); it != m_exception_handlers.end())
+	{
+		return it->second;
+	}
 
-llvm::Value* FunctionBuilder::load_value_register_value(llvm::Type* type)
-{
-	Builder&           builder = m_context.compiler->builder();
-	llvm::IRBuilder<>& ir      = builder.ir();
+	llvm::BasicBlock* block = llvm::BasicBlock::Create(context, "vmException", m_context.llvm_function);
 
-	return ir.CreateLoad(type, get_value_register_pointer(type));
-}
+	llvm::PHINode* state = nullptr;
 
-llvm::Value* FunctionBuilder::get_value_register_pointer(llvm::Type* type)
-{
-	Builder&           builder = m_context.compiler->builder();
-	llvm::IRBuilder<>& ir      = builder.ir();
+	{
+		llvm::IRBuilderBase::InsertPointGuard guard{ir};
 
-	return ir.CreatePointerCast(m_value_register, type->getPointerTo());
-}
+		// Shared between several call sites, so this does not belong to any specific line
+		ir.SetInsertPoint(block);
+		ir.SetCurrentDebugLocation(llvm::DebugLoc());
+		state = ir.CreatePHI(types.vm_state, 0, "raisedState");
 
-void FunctionBuilder::insert_label(long offset)
-{
-	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext(); // long boi
+		for (const auto& [offset, type] : handler.heap_objects)
+		{
+			emit_release_frame_object(offset, *type, true);
+		}
 
-	auto       emplace_result = m_jump_map.emplace(offset, nullptr);
-	const bool success        = emplace_result.second;
+		for (const auto& [offset, type] : handler.stack_objects)
+		{
+			emit_release_frame_object(offset, *type, false);
+		}
 
-	if (!success)
-	{
-		// there was a label here already; no need to recreate one
-		return;
-	}
+		if (handler.catch_offset != -1)
+		{
+			llvm::BasicBlock* uncaught_block = llvm::BasicBlock::Create(context, "uncaught", m_context.llvm_function);
 
-	auto it    = emplace_result.first;
-	it->second = llvm::BasicBlock::Create(context, fmt::format("branch_to_{:04x}", offset), m_context.llvm_function);
-}
+			llvm::CallInst* is_caught = ir.CreateCall(funcs.catch_exception, {state}, "isCaught");
+			ir.CreateCondBr(is_caught, m_jump_map.at(handler.catch_offset), uncaught_block);
 
-void FunctionBuilder::preprocess_conditional_branch(BytecodeInstruction instruction)
-{
-	insert_label(instruction.offset + 2);
-	preprocess_unconditional_branch(instruction);
-}
+			ir.SetInsertPoint(uncaught_block);
 
-void FunctionBuilder::preprocess_unconditional_branch(BytecodeInstruction instruction)
-{
-	insert_label(instruction.offset + 2 + instruction.arg_int());
-}
+			for (const auto& [offset, type] : handler.uncaught_heap_objects)
+			{
+				emit_release_frame_object(offset, *type, true);
+			}
 
-llvm::BasicBlock* FunctionBuilder::get_branch_target(BytecodeInstruction instruction)
-{
-	return m_jump_map.at(instruction.offset + 2 + instruction.arg_int());
-}
+			for (const auto& [offset, type] : handler.uncaught_stack_objects)
+			{
+				emit_release_frame_object(offset, *type, false);
+			}
+		}
 
-llvm::BasicBlock* FunctionBuilder::get_conditional_fail_branch_target(BytecodeInstruction instruction)
-{
-	return m_jump_map.at(instruction.offset + 2);
+		emit_vm_exception_return(state);
+	}
+
+	m_exception_handlers.emplace(handler, state);
+	return state;
 }
 
-void FunctionBuilder::switch_to_block(llvm::BasicBlock* block)
+void FunctionBuilder::emit_release_frame_object(
+	StackFrame::AsStackOffset offset, const asCTypeInfo& type, bool is_on_heap)
 {
+	asCScriptEngine&   engine  = m_context.compiler->engine();
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
 
-	if (auto* current_terminator = ir.GetInsertBlock()->getTerminator(); current_terminator == nullptr)
+	// Funcdef handles are released through the behaviours shared by all functions, as asBC_FREE does for them
+	const asCObjectType* object_type = CastToFuncdefType(const_cast<asCTypeInfo*>(&type)) != nullptr
+		? &engine.functionBehaviours
+		: CastToObjectType(const_cast<asCTypeInfo*>(&type));
+	if (object_type == nullptr)
 	{
-		// The current block has no terminator: insert a branch to the current one, which immediately follows it.
-		ir.CreateBr(block);
+		return;
 	}
 
-	ir.SetInsertPoint(block);
-}
-
-void FunctionBuilder::create_function_debug_info(llvm::Function* function, GeneratedFunctionType type)
-{
-	asCScriptEngine&   engine            = m_context.compiler->engine();
-	llvm::IRBuilder<>& ir                = m_context.compiler->builder().ir();
-	llvm::DIBuilder&   di                = m_context.module_builder->di_builder();
-	ModuleDebugInfo&   module_debug_info = m_context.module_builder->debug_info();
+	const asSTypeBehaviour& beh = object_type->beh;
 
-	std::vector<llvm::Metadata*> types;
+	if (!is_on_heap)
 	{
-		types.push_back(m_context.module_builder->get_debug_type(asTYPEID_INT8)); // TODO: make a separate type for ret
+		if (beh.destruct != 0)
+		{
+			emit_object_method_call(*engine.scriptFunctions[beh.destruct], m_stack.pointer_to(offset, types.i8));
+		}
 
-		types.push_back(m_context.module_builder->get_debug_type(
-			engine.GetTypeIdFromDataType(m_context.script_function->returnType)));
+		return;
+	}
 
-		if (m_context.script_function->objectType != nullptr)
+	llvm::Value* variable_pointer = m_stack.pointer_to(offset, types.pvoid);
+	llvm::Value* object_pointer   = ir.CreateLoad(types.pvoid, variable_pointer);
+
+	llvm::BasicBlock* release_block = llvm::BasicBlock::Create(context, "releaseObject", m_context.llvm_function);
+	llvm::BasicBlock* next_block    = llvm::BasicBlock::Create(context, "objectReleased", m_context.llvm_function);
+
+	ir.CreateCondBr(ir.CreateIsNull(object_pointer), next_block, release_block);
+	ir.SetInsertPoint(release_block);
+
+	if ((object_type->flags & asOBJ_REF) != 0)
+	{
+		if (beh.release != 0)
 		{
-			types.push_back(m_context.module_builder->get_debug_type(m_context.script_function->objectType->typeId));
+			emit_object_method_call(*engine.scriptFunctions[beh.release], object_pointer);
 		}
-
-		const std::size_t count = m_context.script_function->GetParamCount();
-		for (std::size_t i = 0; i < count; ++i)
+	}
+	else
+	{
+		if (beh.destruct != 0)
 		{
-			int type_id = 0;
-			m_context.script_function->GetParam(i, &type_id);
-			types.push_back(m_context.module_builder->get_debug_type(type_id));
+			emit_object_method_call(*engine.scriptFunctions[beh.destruct], object_pointer);
 		}
+
+		ir.CreateCall(funcs.free, {object_pointer});
 	}
 
-	llvm::DIFile* file = di.createFile(m_context.script_function->GetScriptSectionName(), ".");
+	ir.CreateStore(llvm::Constant::getNullValue(types.pvoid), variable_pointer);
+	ir.CreateBr(next_block);
 
-	const auto location = get_source_location(m_context);
+	ir.SetInsertPoint(next_block);
+}
 
-	std::string_view symbol_suffix;
+void FunctionBuilder::emit_check_null_pointer(llvm::Value* pointer)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
 
-	switch (type)
+	llvm::BranchInst* branch = emit_check_exception(
+		ir.CreateICmp(llvm::CmpInst::ICMP_EQ, pointer, llvm::ConstantInt::getNullValue(pointer->getType()), "isNull"),
+		VmState::ExceptionNullPointer);
+
+	// Let codegen replace the check with a faulting access, when one closely follows the check, see faulthandler.hpp
+	if (branch != nullptr && m_context.compiler->config().use_implicit_null_checks)
 	{
-	case GeneratedFunctionType::Implementation: break;
-	case GeneratedFunctionType::VmEntryThunk: symbol_suffix = "!vmthunk"; break;
+		branch->setMetadata(llvm::LLVMContext::MD_make_implicit, llvm::MDNode::get(context, {}));
 	}
+}
 
-	llvm::DISubprogram* sp = di.createFunction(
-		module_debug_info.compile_unit,
-		fmt::format("{}{}", make_debug_name(*m_context.script_function), symbol_suffix),
-		llvm::StringRef{},
-		file,
-		location.line,
-		di.createSubroutineType(di.getOrCreateTypeArray(types)),
-		location.line,
-		llvm::DINode::FlagPrototyped | llvm::DINode::FlagThunk,
-		llvm::DISubprogram::SPFlagDefinition);
-
-	function->setSubprogram(sp);
+void FunctionBuilder::emit_check_vm_state(llvm::Value* state)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
 
-	ir.SetCurrentDebugLocation(get_debug_location(m_context, 0, sp));
+	emit_check_boolean(
+		ir.CreateICmp(
+			llvm::CmpInst::ICMP_NE, state, llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::Ok))),
+		state);
 }
 
-llvm::Value* FunctionBuilder::load_global(asPWORD address, llvm::Type* type)
+void FunctionBuilder::emit_check_context_state()
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+
+	llvm::CallInst* status = ir.CreateCall(funcs.check_execution_status, {});
+	mark_no_script_global_access(status);
 
-	llvm::Value* global_address = ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, address), types.pi32);
-	return ir.CreateLoad(type, global_address);
+	emit_check_exception(
+		ir.CreateICmp(llvm::CmpInst::ICMP_NE, status, llvm::ConstantInt::get(types.vm_state, 0)),
+		VmState::ExceptionExternal);
 }
 
-void FunctionBuilder::emit_check_boolean(llvm::Value* value, llvm::Value* state_if_true)
+void FunctionBuilder::emit_safepoint(const asDWORD* bytecode)
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
 	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
 
-	llvm::Function* parent = ir.GetInsertBlock()->getParent();
+	// asSVMRegisters::doProcessSuspend, which the context sets for line callbacks, and suspend and abort requests.
+	// It may be set by another thread, e.g. a watchdog calling asIScriptContext::Abort().
+	llvm::Value* flag_pointer = ir.CreatePointerCast(
+		ir.CreateStructGEP(types.vm_registers, m_vm_registers, 6), types.pi8, "doProcessSuspendPointer");
+	llvm::LoadInst* flag = ir.CreateAlignedLoad(types.i8, flag_pointer, llvm::MaybeAlign(1), "doProcessSuspend");
+	flag->setAtomic(llvm::AtomicOrdering::Monotonic);
 
-	llvm::BasicBlock* on_true  = llvm::BasicBlock::Create(context, "setVmException", parent);
-	llvm::BasicBlock* on_false = llvm::BasicBlock::Create(context, "doNotSetVmException", parent);
+	llvm::BasicBlock* safepoint_block = llvm::BasicBlock::Create(context, "safepoint", m_context.llvm_function);
+	llvm::BasicBlock* resume_block    = llvm::BasicBlock::Create(context, "afterSafepoint", m_context.llvm_function);
 
-	ir.CreateCondBr(value, on_true, on_false);
+	ir.CreateCondBr(
+		ir.CreateICmpNE(flag, llvm::ConstantInt::get(types.i8, 0)),
+		safepoint_block,
+		resume_block,
+		llvm::MDBuilder(context).createUnlikelyBranchWeights());
 
-	ir.SetInsertPoint(on_true);
-	emit_vm_exception_return(state_if_true);
+	ir.SetInsertPoint(safepoint_block);
 
-	if (m_generated_type == GeneratedFunctionType::VmEntryThunk)
+	llvm::CallInst* state = ir.CreateCall(
+		funcs.process_safepoint,
+		{m_vm_registers,
+		 ir.CreateIntToPtr(
+			 llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(m_context.script_function)), types.pvoid),
+		 ir.CreateIntToPtr(llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(bytecode)), types.pvoid)});
+
+	emit_check_vm_state(state);
+	ir.CreateBr(resume_block);
+
+	ir.SetInsertPoint(resume_block);
+}
+
+void FunctionBuilder::emit_back_edge(const asDWORD* bytecode)
+{
+	Builder&           builder = m_context.compiler->builder();
+	llvm::IRBuilder<>& ir      = builder.ir();
+	StandardTypes&     types   = builder.standard_types();
+	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
+
+	emit_safepoint(bytecode);
+
+	if (m_budget_counter == nullptr)
 	{
-		ir.CreateBr(on_false);
+		return;
 	}
 
-	ir.SetInsertPoint(on_false);
+	// The counter is local to the frame, so that it lives in a register within loops
+	llvm::Value* remaining = ir.CreateSub(
+		ir.CreateLoad(types.i32, m_budget_counter), llvm::ConstantInt::get(types.i32, 1), "budgetRemaining");
+	ir.CreateStore(remaining, m_budget_counter);
+
+	llvm::BasicBlock* consume_block = llvm::BasicBlock::Create(context, "consumeBudget", m_context.llvm_function);
+	llvm::BasicBlock* resume_block  = llvm::BasicBlock::Create(context, "afterBudget", m_context.llvm_function);
+
+	ir.CreateCondBr(
+		ir.CreateICmpEQ(remaining, llvm::ConstantInt::get(types.i32, 0)),
+		consume_block,
+		resume_block,
+		llvm::MDBuilder(context).createUnlikelyBranchWeights());
+
+	ir.SetInsertPoint(consume_block);
+
+	llvm::CallInst* state = ir.CreateCall(
+		funcs.consume_execution_budget,
+		{m_vm_registers, llvm::ConstantInt::get(types.i32, runtime::execution_budget_batch_size)});
+	ir.CreateStore(llvm::ConstantInt::get(types.i32, runtime::execution_budget_batch_size), m_budget_counter);
+
+	emit_check_vm_state(state);
+	ir.CreateBr(resume_block);
+
+	ir.SetInsertPoint(resume_block);
 }
 
-void FunctionBuilder::emit_check_null_pointer(llvm::Value* pointer)
+llvm::Value* FunctionBuilder::load_call_site_cache_epoch()
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
 
-	emit_check_boolean(
-		ir.CreateICmp(llvm::CmpInst::ICMP_EQ, pointer, llvm::ConstantInt::getNullValue(pointer->getType()), "isNull"),
-		llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::ExceptionNullPointer)));
+	llvm::LoadInst* epoch = ir.CreateAlignedLoad(
+		types.i32,
+		ir.CreateIntToPtr(
+			llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&runtime::call_site_cache_epoch)),
+			types.pi32),
+		llvm::MaybeAlign(alignof(asUINT)),
+		"cacheEpoch");
+	epoch->setAtomic(llvm::AtomicOrdering::Monotonic);
+
+	return epoch;
 }
 
-void FunctionBuilder::emit_check_vm_state(llvm::Value* state)
+llvm::Value* FunctionBuilder::emit_is_discard_epoch_current()
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
 
-	emit_check_boolean(
-		ir.CreateICmp(
-			llvm::CmpInst::ICMP_NE, state, llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::Ok))),
-		state);
+	const asUINT build_epoch = runtime::function_discard_epoch.load(std::memory_order_relaxed);
+
+	llvm::LoadInst* epoch = ir.CreateAlignedLoad(
+		types.i32,
+		ir.CreateIntToPtr(
+			llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(&runtime::function_discard_epoch)),
+			types.pi32),
+		llvm::MaybeAlign(alignof(asUINT)),
+		"discardEpoch");
+	epoch->setAtomic(llvm::AtomicOrdering::Monotonic);
+
+	return ir.CreateICmpEQ(epoch, llvm::ConstantInt::get(types.i32, build_epoch), "isDiscardEpochCurrent");
 }
 
-void FunctionBuilder::emit_check_context_state()
+void FunctionBuilder::emit_function_entry_budget()
 {
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 	StandardTypes&     types   = builder.standard_types();
 	StandardFunctions& funcs   = m_context.module_builder->standard_functions();
+	llvm::LLVMContext& context = *m_context.compiler->builder().llvm_context().getContext();
 
-	emit_check_boolean(
-		ir.CreateICmp(
-			llvm::CmpInst::ICMP_NE,
-			ir.CreateCall(funcs.check_execution_status, {}),
-			llvm::ConstantInt::get(types.vm_state, 0)),
-		llvm::ConstantInt::get(types.vm_state, std::uint64_t(VmState::ExceptionExternal)));
+	if (m_budget_counter == nullptr)
+	{
+		return;
+	}
+
+	// Recursion does not iterate any loop, yet may never return, e.g. once turned into a loop by tail calls
+	llvm::StructType* counter_type = llvm::StructType::get(context, {types.pvoid, types.i32});
+
+	// Same as runtime::get_function_entry_counter_index()
+	llvm::Value* registers = ir.CreatePtrToInt(m_vm_registers, types.i64);
+	llvm::Value* index     = ir.CreateLShr(
+		ir.CreateMul(
+			ir.CreateLShr(registers, llvm::ConstantInt::get(types.i64, 4)),
+			llvm::ConstantInt::get(types.i64, 0x9E3779B97F4A7C15ull)),
+		llvm::ConstantInt::get(types.i64, 64 - runtime::function_entry_counter_bits),
+		"entryCounterIndex");
+
+	llvm::Value* counters = ir.CreateIntToPtr(
+		llvm::ConstantInt::get(types.iptr, reinterpret_cast<asPWORD>(runtime::function_entry_counters.data())),
+		counter_type->getPointerTo());
+	llvm::Value* counter = ir.CreateInBoundsGEP(counter_type, counters, {index}, "entryCounter");
+
+	llvm::LoadInst* owner = ir.CreateAlignedLoad(
+		types.pvoid,
+		ir.CreateStructGEP(counter_type, counter, 0),
+		llvm::MaybeAlign(alignof(void*)),
+		"entryCounterOwner");
+	owner->setAtomic(llvm::AtomicOrdering::Monotonic);
+
+	llvm::BasicBlock* count_block  = llvm::BasicBlock::Create(context, "countEntry", m_context.llvm_function);
+	llvm::BasicBlock* charge_block = llvm::BasicBlock::Create(context, "chargeEntry", m_context.llvm_function);
+	llvm::BasicBlock* resume_block = llvm::BasicBlock::Create(context, "afterEntryBudget", m_context.llvm_function);
+
+	ir.CreateCondBr(
+		ir.CreateICmpEQ(owner, ir.CreatePointerCast(m_vm_registers, types.pvoid)),
+		count_block,
+		charge_block,
+		llvm::MDBuilder(context).createLikelyBranchWeights());
+
+	ir.SetInsertPoint(count_block);
+
+	llvm::Value*    entries_left_pointer = ir.CreateStructGEP(counter_type, counter, 1);
+	llvm::LoadInst* entries_left         = ir.CreateAlignedLoad(
+		types.i32, entries_left_pointer, llvm::MaybeAlign(alignof(asUINT)), "entriesLeft");
+	entries_left->setAtomic(llvm::AtomicOrdering::Monotonic);
+
+	llvm::Value*     remaining = ir.CreateSub(entries_left, llvm::ConstantInt::get(types.i32, 1), "entriesRemaining");
+	llvm::StoreInst* store
+		= ir.CreateAlignedStore(remaining, entries_left_pointer, llvm::MaybeAlign(alignof(asUINT)));
+	store->setAtomic(llvm::AtomicOrdering::Monotonic);
+
+	ir.CreateCondBr(
+		ir.CreateICmpEQ(remaining, llvm::ConstantInt::get(types.i32, 0)),
+		charge_block,
+		resume_block,
+		llvm::MDBuilder(context).createUnlikelyBranchWeights());
+
+	ir.SetInsertPoint(charge_block);
+	emit_check_vm_state(ir.CreateCall(funcs.charge_function_entry, {m_vm_registers}));
+	ir.CreateBr(resume_block);
+
+	ir.SetInsertPoint(resume_block);
 }
 
 void FunctionBuilder::emit_vm_exception_return(llvm::Value* state)
@@ -2092,7 +4631,6 @@ void FunctionBuilder::emit_vm_exception_return(llvm::Value* state)
 
 	if (m_generated_type == GeneratedFunctionType::Implementation)
 	{
-		// TODO: object cleanup as the VM does
 		ir.CreateRet(state);
 	}
 	else if (m_generated_type == GeneratedFunctionType::VmEntryThunk)
@@ -2,14 +2,21 @@
 
 #include <asllvm/detail/assert.hpp>
 #include <asllvm/detail/builder.hpp>
+#include <asllvm/detail/faulthandler.hpp>
 #include <asllvm/detail/functionbuilder.hpp>
 #include <asllvm/detail/llvmglobals.hpp>
 #include <asllvm/detail/modulebuilder.hpp>
 #include <asllvm/detail/modulecommon.hpp>
+#include <algorithm>
 #include <fmt/core.h>
 #include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
 #include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/Support/CommandLine.h>
 #include <llvm/Support/TargetSelect.h>
+#include <math.h>
+#include <stdlib.h>
+#include <utility>
 
 #if !LLVM_USE_PERF
 #	pragma message("warning: LLVM was not build with perf support. Disabling perf listener support")
@@ -17,6 +24,31 @@
 
 namespace asllvm::detail
 {
+namespace
+{
+//! \brief Called by the engine for each function that had a JIT'd implementation, when it is destroyed.
+void release_function(asIScriptFunction* function)
+{
+	auto* compiler = static_cast<JitCompiler*>(function->GetEngine()->GetUserData(compiler_userdata_identifier));
+
+	if (compiler != nullptr)
+	{
+		compiler->discard_function(static_cast<asCScriptFunction&>(*function));
+	}
+}
+
+//! \brief Called by the engine for each script class that had a dispatch table, when it is destroyed.
+void release_type(asITypeInfo* type)
+{
+	auto* compiler = static_cast<JitCompiler*>(type->GetEngine()->GetUserData(compiler_userdata_identifier));
+
+	if (compiler != nullptr)
+	{
+		compiler->discard_type(static_cast<asCObjectType&>(*type));
+	}
+}
+} // namespace
+
 LibraryInitializer::LibraryInitializer()
 {
 	llvm::InitializeNativeTarget();
@@ -33,7 +65,17 @@ JitCompiler::JitCompiler(JitConfig config) :
 	m_config{config},
 	m_builder{*this},
 	m_module_map{*this}
-{}
+{
+	if (m_config.use_implicit_null_checks && are_implicit_null_checks_supported())
+	{
+		llvm::StringMap<llvm::cl::Option*>& options = llvm::cl::getRegisteredOptions();
+		if (auto it = options.find("enable-implicit-null-checks"); it != options.end())
+		{
+			static_cast<llvm::cl::opt<bool>*>(it->second)->setValue(true);
+			install_fault_handler();
+		}
+	}
+}
 
 int JitCompiler::jit_compile(asIScriptFunction* function, asJITFunction* output)
 {
@@ -41,15 +83,39 @@ int JitCompiler::jit_compile(asIScriptFunction* function, asJITFunction* output)
 		!(m_engine != nullptr && function->GetEngine() != m_engine)
 		&& "JIT compiler expects to be used against the same asIScriptEngine during its lifetime");
 
+	if (m_engine == nullptr)
+	{
+		asIScriptEngine& engine = *function->GetEngine();
+
+		// ModuleBuilder::link() sets the vtable user data of every function it built, and the dispatch table user
+		// data of every class
+		engine.SetUserData(this, compiler_userdata_identifier);
+		engine.SetFunctionUserDataCleanupCallback(release_function, vtable_userdata_identifier);
+		engine.SetTypeInfoUserDataCleanupCallback(release_type, dispatch_table_userdata_identifier);
+
+		if (m_config.allow_suspend)
+		{
+			engine.SetContextUserDataCleanupCallback(runtime::release_execution, execution_userdata_identifier);
+		}
+	}
+
 	m_engine = static_cast<asCScriptEngine*>(function->GetEngine());
 
 	m_module_map[function->GetModule()].append({static_cast<asCScriptFunction*>(function), output});
 	return 0;
 }
 
-void JitCompiler::jit_free(asJITFunction func)
+void JitCompiler::jit_free(asJITFunction function)
 {
-	// TODO
+	for (auto& [module, functions] : m_compiled_functions)
+	{
+		functions.erase(
+			std::remove_if(
+				functions.begin(),
+				functions.end(),
+				[&](const CompiledFunction& compiled) { return compiled.entry == function; }),
+			functions.end());
+	}
 }
 
 void JitCompiler::diagnostic(const std::string& text, asEMsgType message_type) const
@@ -62,11 +128,282 @@ void JitCompiler::diagnostic(const std::string& text, asEMsgType message_type) c
 	m_engine->WriteMessage("", 0, 0, message_type, edited_text.c_str());
 }
 
-void JitCompiler::build_modules() { m_module_map.build_modules(); }
+void JitCompiler::build_modules()
+{
+	m_module_map.build_modules();
+	m_fault_map_listener.register_pending_fault_maps();
+}
+
+int JitCompiler::recompile_module(asIScriptModule* module)
+{
+	auto it = m_compiled_functions.find(module);
+	if (!m_config.instrument_for_profile || module == nullptr || it == m_compiled_functions.end()
+		|| it->second.empty())
+	{
+		return asINVALID_ARG;
+	}
+
+	if (m_config.verbose)
+	{
+		diagnostic(fmt::format("recompiling module {} using the gathered profile", module->GetName()));
+	}
+
+	// Symbols of the recompiled module have the same names as the ones of the previous build
+	llvm::orc::JITDylib& dylib
+		= ExitOnError(m_jit->createJITDylib(fmt::format("asllvm.recompiled.{}", ++m_recompilation_count)));
+	dylib.addToLinkOrder(m_jit->getMainJITDylib());
+
+	// Building the module registers the functions again
+	const std::vector<CompiledFunction> functions = std::move(it->second);
+	it->second.clear();
+
+	ModuleBuilder module_builder{*this, module};
+	module_builder.set_recompilation(dylib);
+
+	for (const CompiledFunction& function : functions)
+	{
+		module_builder.append({function.function, function.jit_function});
+	}
+
+	module_builder.build();
+	module_builder.link();
+	m_fault_map_listener.register_pending_fault_maps();
+
+	// Cached entries refer to the code of the previous build
+	runtime::invalidate_call_site_caches();
+
+	return asSUCCESS;
+}
+
+int JitCompiler::set_execution_budget(
+	asIScriptContext* context, asQWORD iterations, std::chrono::nanoseconds time_limit)
+{
+	if (!m_config.enforce_execution_budget || context == nullptr)
+	{
+		return asINVALID_ARG;
+	}
+
+	auto* budget = static_cast<runtime::ExecutionBudget*>(context->GetUserData(budget_userdata_identifier));
+
+	if (budget == nullptr)
+	{
+		context->GetEngine()->SetContextUserDataCleanupCallback(
+			runtime::release_execution_budget, budget_userdata_identifier);
+
+		budget = new runtime::ExecutionBudget;
+		context->SetUserData(budget, budget_userdata_identifier);
+	}
+
+	budget->iterations.reset();
+	budget->deadline.reset();
+
+	if (iterations != 0)
+	{
+		budget->iterations = iterations;
+	}
+
+	if (time_limit != std::chrono::nanoseconds::zero())
+	{
+		budget->deadline = std::chrono::steady_clock::now() + time_limit;
+	}
+
+	return asSUCCESS;
+}
+
+void* JitCompiler::get_native_entry(asIScriptFunction* function) const
+{
+	if (!m_config.generate_native_entries || function == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Set by ModuleBuilder::link() for the functions it built an entry point for
+	return function->GetUserData(native_entry_userdata_identifier);
+}
+
+void* JitCompiler::get_batch_entry(asIScriptFunction* function) const
+{
+	if (!m_config.generate_native_entries || function == nullptr)
+	{
+		return nullptr;
+	}
+
+	return function->GetUserData(batch_entry_userdata_identifier);
+}
+
+void JitCompiler::register_compiled_function(asIScriptModule* module, CompiledFunction function)
+{
+	m_compiled_functions[module].push_back(function);
+}
+
+void JitCompiler::discard_function(const asCScriptFunction& function)
+{
+	// The ID may be reused by a function that has nothing to do with the profile
+	m_function_profiles.erase(function.GetId());
+
+	// The address of the function may be reused as well
+	runtime::invalidate_call_site_caches();
+	runtime::function_discard_epoch.fetch_add(1, std::memory_order_acq_rel);
+
+	// Recompiling a call site must not promote calls to a function that no longer exists
+	for (auto& [id, profile] : m_function_profiles)
+	{
+		for (auto& [offset, call_profile] : profile.virtual_calls)
+		{
+			call_profile.forget(&function);
+		}
+	}
+}
+
+void JitCompiler::discard_type(const asCObjectType& object_type)
+{
+	m_dispatch_tables.erase(&object_type);
+
+	// The address of the class may be reused by another class, which interface call caches must not mistake
+	runtime::invalidate_call_site_caches();
+}
+
+FunctionProfile& JitCompiler::get_function_profile(int function_id) { return m_function_profiles[function_id]; }
+
+runtime::DispatchTable& JitCompiler::get_dispatch_table(const asCObjectType& object_type)
+{
+	return m_dispatch_tables[&object_type];
+}
+
+const FunctionProfile* JitCompiler::find_function_profile(int function_id) const
+{
+	if (auto it = m_function_profiles.find(function_id); it != m_function_profiles.end())
+	{
+		return &it->second;
+	}
+
+	return nullptr;
+}
+
+int JitCompiler::set_system_function_bitcode(
+	asIScriptFunction* function, const char* symbol, const void* bitcode, std::size_t size)
+{
+	if (function == nullptr || symbol == nullptr || bitcode == nullptr)
+	{
+		return asINVALID_ARG;
+	}
+
+	auto& system_function = static_cast<asCScriptFunction&>(*function);
+
+	if (system_function.funcType != asFUNC_SYSTEM || system_function.sysFuncIntf == nullptr)
+	{
+		return asINVALID_ARG;
+	}
+
+	switch (system_function.sysFuncIntf->callConv)
+	{
+	case ICC_CDECL:
+	case ICC_THISCALL:
+	case ICC_CDECL_OBJFIRST:
+	case ICC_CDECL_OBJLAST: break;
+	default: return asINVALID_ARG;
+	}
+
+	m_system_function_bitcode[function->GetId()] = {
+		symbol,
+		llvm::MemoryBuffer::getMemBufferCopy(
+			llvm::StringRef(static_cast<const char*>(bitcode), size), fmt::format("bitcode.{}", symbol))};
+
+	return asSUCCESS;
+}
+
+int JitCompiler::set_math_intrinsic(asIScriptFunction* function, MathIntrinsic intrinsic)
+{
+	if (function == nullptr)
+	{
+		return asINVALID_ARG;
+	}
+
+	auto& system_function = static_cast<asCScriptFunction&>(*function);
+
+	if (system_function.funcType != asFUNC_SYSTEM || system_function.sysFuncIntf == nullptr
+		|| system_function.sysFuncIntf->callConv != ICC_CDECL)
+	{
+		return asINVALID_ARG;
+	}
+
+	m_math_intrinsics[function->GetId()] = intrinsic;
+	return asSUCCESS;
+}
+
+std::optional<MathIntrinsic> JitCompiler::get_math_intrinsic(const asCScriptFunction& function) const
+{
+	if (auto it = m_math_intrinsics.find(function.GetId()); it != m_math_intrinsics.end())
+	{
+		return it->second;
+	}
+
+	if (function.sysFuncIntf == nullptr || function.sysFuncIntf->callConv != ICC_CDECL)
+	{
+		return {};
+	}
+
+	const auto to_function = [](auto* function) { return reinterpret_cast<asFUNCTION_t>(function); };
+
+	// Overloads are selected explicitly as some of these are overloaded in C++, e.g. ::abs
+	const std::pair<asFUNCTION_t, MathIntrinsic> known_functions[] = {
+		{to_function(static_cast<float (*)(float)>(sqrtf)), MathIntrinsic::Sqrt},
+		{to_function(static_cast<double (*)(double)>(sqrt)), MathIntrinsic::Sqrt},
+		{to_function(static_cast<float (*)(float)>(fabsf)), MathIntrinsic::Abs},
+		{to_function(static_cast<double (*)(double)>(fabs)), MathIntrinsic::Abs},
+		{to_function(static_cast<int (*)(int)>(abs)), MathIntrinsic::Abs},
+		{to_function(static_cast<long (*)(long)>(labs)), MathIntrinsic::Abs},
+		{to_function(static_cast<long long (*)(long long)>(llabs)), MathIntrinsic::Abs},
+		{to_function(static_cast<float (*)(float)>(floorf)), MathIntrinsic::Floor},
+		{to_function(static_cast<double (*)(double)>(floor)), MathIntrinsic::Floor},
+		{to_function(static_cast<float (*)(float)>(ceilf)), MathIntrinsic::Ceil},
+		{to_function(static_cast<double (*)(double)>(ceil)), MathIntrinsic::Ceil},
+		{to_function(static_cast<float (*)(float, float)>(fminf)), MathIntrinsic::Min},
+		{to_function(static_cast<double (*)(double, double)>(fmin)), MathIntrinsic::Min},
+		{to_function(static_cast<float (*)(float, float)>(fmaxf)), MathIntrinsic::Max},
+		{to_function(static_cast<double (*)(double, double)>(fmax)), MathIntrinsic::Max},
+		{to_function(static_cast<float (*)(float)>(sinf)), MathIntrinsic::Sin},
+		{to_function(static_cast<double (*)(double)>(sin)), MathIntrinsic::Sin},
+		{to_function(static_cast<float (*)(float)>(cosf)), MathIntrinsic::Cos},
+		{to_function(static_cast<double (*)(double)>(cos)), MathIntrinsic::Cos},
+		{to_function(static_cast<float (*)(float, float)>(powf)), MathIntrinsic::Pow},
+		{to_function(static_cast<double (*)(double, double)>(pow)), MathIntrinsic::Pow}};
+
+	for (const auto& [address, intrinsic] : known_functions)
+	{
+		if (function.sysFuncIntf->func == address)
+		{
+			return intrinsic;
+		}
+	}
+
+	return {};
+}
+
+const SystemFunctionBitcode* JitCompiler::get_system_function_bitcode(int function_id) const
+{
+	if (auto it = m_system_function_bitcode.find(function_id); it != m_system_function_bitcode.end())
+	{
+		return &it->second;
+	}
+
+	return nullptr;
+}
 
 std::unique_ptr<llvm::orc::LLJIT> JitCompiler::setup_jit()
 {
-	auto jit = ExitOnError(llvm::orc::LLJITBuilder().create());
+	auto target_machine_builder = ExitOnError(llvm::orc::JITTargetMachineBuilder::detectHost());
+
+	// Globals are bound to arbitrary addresses by ModuleBuilder::link_symbols(), so they may not be reachable through a
+	// 32-bit displacement from generated code. Go through the GOT instead.
+	target_machine_builder.setRelocationModel(llvm::Reloc::PIC_);
+
+	auto jit = ExitOnError(
+		llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(target_machine_builder)).create());
+
+	// Bitcode provided through set_system_function_bitcode() may reference arbitrary symbols of the application.
+	jit->getMainJITDylib().addGenerator(ExitOnError(
+		llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(jit->getDataLayout().getGlobalPrefix())));
 
 	auto& object_linking_layer = static_cast<llvm::orc::RTDyldObjectLinkingLayer&>(jit->getObjLinkingLayer());
 	object_linking_layer.setNotifyLoaded([this](
@@ -85,6 +422,7 @@ std::unique_ptr<llvm::orc::LLJIT> JitCompiler::setup_jit()
 	});
 
 	object_linking_layer.setProcessAllSections(true);
+	object_linking_layer.registerJITEventListener(m_fault_map_listener);
 
 	return jit;
 }
@@ -1,36 +1,60 @@
 #include <asllvm/detail/modulebuilder.hpp>
 
+#include <asllvm/detail/ashelper.hpp>
 #include <asllvm/detail/assert.hpp>
 #include <asllvm/detail/functionbuilder.hpp>
 #include <asllvm/detail/jitcompiler.hpp>
 #include <asllvm/detail/llvmglobals.hpp>
 #include <asllvm/detail/modulecommon.hpp>
 #include <asllvm/detail/runtime.hpp>
+#include <asllvm/detail/unsupported.hpp>
 #include <asllvm/detail/vmstate.hpp>
+#include <cstring>
 #include <fmt/core.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/ExecutionEngine/JITSymbol.h>
 #include <llvm/ExecutionEngine/Orc/Core.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
 #include <llvm/ExecutionEngine/Orc/Mangling.h>
 #include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/IPO/Internalize.h>
 
 namespace asllvm::detail
 {
 ModuleBuilder::ModuleBuilder(JitCompiler& compiler, asIScriptModule* module) :
 	m_compiler{compiler},
 	m_script_module{module},
+	m_dylib{&compiler.jit().getMainJITDylib()},
 	m_llvm_module{
 		std::make_unique<llvm::Module>(make_module_name(module), *compiler.builder().llvm_context().getContext())},
 	m_di_builder{std::make_unique<llvm::DIBuilder>(*m_llvm_module)},
 	m_debug_info{setup_debug_info()},
 	m_internal_functions{setup_runtime()},
 	m_global_variables{setup_global_variables()}
-{}
+{
+	m_llvm_module->setDataLayout(compiler.jit().getDataLayout());
+	m_llvm_module->setTargetTriple(compiler.jit().getTargetTriple().str());
+}
 
 void ModuleBuilder::append(PendingFunction function) { m_pending_functions.push_back(function); }
 
+void ModuleBuilder::set_recompilation(llvm::orc::JITDylib& dylib)
+{
+	m_dylib            = &dylib;
+	m_is_recompilation = true;
+}
+
+bool ModuleBuilder::is_instrumented() const
+{
+	// Shared functions may be called from any module, so they are not recompiled along with a module
+	return m_compiler.config().instrument_for_profile && !m_is_recompilation && m_script_module != nullptr;
+}
+
 llvm::Function* ModuleBuilder::get_script_function(const asCScriptFunction& function)
 {
 	asllvm_assert(
@@ -57,10 +81,42 @@ llvm::Function* ModuleBuilder::get_script_function(const asCScriptFunction& func
 		make_function_name(function),
 		*m_llvm_module);
 
+	// Guarantees tail calls between script functions, see FunctionBuilder::emit_script_call
+	internal_function->setCallingConv(llvm::CallingConv::Tail);
+
+	if (const asCObjectType* object_type = function.objectType; object_type != nullptr)
+	{
+		// Callers check the object for null before calling any method, see FunctionBuilder::emit_script_call
+		const unsigned this_index = function.returnType.GetTokenType() != ttVoid ? 1 : 0;
+
+		internal_function->addParamAttr(this_index, llvm::Attribute::NonNull);
+
+		if (object_type->size > 0)
+		{
+			internal_function->addDereferenceableParamAttr(this_index, object_type->size);
+		}
+	}
+
 	m_script_functions.emplace(function.GetId(), internal_function);
 	return internal_function;
 }
 
+llvm::Function* ModuleBuilder::create_osr_function(const asCScriptFunction& function)
+{
+	llvm::Function* script_function = get_script_function(function);
+
+	llvm::Function* osr_function = llvm::Function::Create(
+		script_function->getFunctionType(),
+		llvm::Function::ExternalLinkage,
+		make_osr_function_name(function),
+		*m_llvm_module);
+
+	osr_function->setCallingConv(script_function->getCallingConv());
+	osr_function->setAttributes(script_function->getAttributes());
+
+	return osr_function;
+}
+
 llvm::FunctionType* ModuleBuilder::get_script_function_type(const asCScriptFunction& script_function)
 {
 	asCScriptEngine& engine  = m_compiler.engine();
@@ -95,6 +151,9 @@ llvm::FunctionType* ModuleBuilder::get_script_function_type(const asCScriptFunct
 		parameter_types.push_back(builder.to_llvm_type(script_function.parameterTypes[i]));
 	}
 
+	// Registers of the executing context, polled at safepoints, see FunctionBuilder::emit_safepoint
+	parameter_types.push_back(types.vm_registers->getPointerTo());
+
 	return llvm::FunctionType::get(types.vm_state, parameter_types, false);
 }
 
@@ -127,9 +186,126 @@ llvm::Function* ModuleBuilder::get_system_function(const asCScriptFunction& syst
 
 	m_system_functions.emplace(id, function);
 
+	if (const SystemFunctionBitcode* bitcode = m_compiler.get_system_function_bitcode(id); bitcode != nullptr)
+	{
+		link_system_function_bitcode(*function, *bitcode);
+	}
+
 	return function;
 }
 
+void ModuleBuilder::link_system_function_bitcode(llvm::Function& declaration, const SystemFunctionBitcode& bitcode)
+{
+	llvm::LLVMContext& context = *m_compiler.builder().llvm_context().getContext();
+
+	const auto warn = [&](std::string_view reason) {
+		m_compiler.diagnostic(fmt::format("ignoring bitcode for {}: {}", bitcode.symbol, reason), asMSGTYPE_WARNING);
+	};
+
+	auto source = llvm::parseBitcodeFile(bitcode.bitcode->getMemBufferRef(), context);
+	if (!source)
+	{
+		warn(llvm::toString(source.takeError()));
+		return;
+	}
+
+	llvm::Function* implementation = (*source)->getFunction(bitcode.symbol);
+	if (implementation == nullptr || implementation->isDeclaration())
+	{
+		warn("symbol not defined within the bitcode");
+		return;
+	}
+
+	llvm::FunctionType* declaration_type    = declaration.getFunctionType();
+	llvm::FunctionType* implementation_type = implementation->getFunctionType();
+
+	// Types may differ nominally (e.g. %class.Foo* and our own object types), but must be ABI-compatible
+	const auto is_compatible = [&](llvm::Type* from, llvm::Type* to) {
+		return from == to || llvm::CastInst::isBitOrNoopPointerCastable(from, to, m_llvm_module->getDataLayout());
+	};
+
+	bool compatible = declaration_type->getNumParams() == implementation_type->getNumParams()
+		&& !implementation_type->isVarArg()
+		&& is_compatible(implementation_type->getReturnType(), declaration_type->getReturnType());
+
+	for (unsigned i = 0; compatible && i < declaration_type->getNumParams(); ++i)
+	{
+		compatible = is_compatible(declaration_type->getParamType(i), implementation_type->getParamType(i));
+	}
+
+	if (!compatible)
+	{
+		warn("incompatible function type");
+		return;
+	}
+
+	// Linking a mutable global would give every module its own copy of it. Refer to the definition of the application
+	// instead, which must then be exported; state private to the bitcode cannot be shared that way.
+	for (llvm::GlobalVariable& variable : (*source)->globals())
+	{
+		if (variable.isConstant() || variable.isDeclaration())
+		{
+			continue;
+		}
+
+		if (variable.hasLocalLinkage())
+		{
+			if (!variable.use_empty())
+			{
+				warn(fmt::format("private mutable global {}", variable.getName().str()));
+				return;
+			}
+
+			continue;
+		}
+
+		variable.setInitializer(nullptr);
+		variable.setLinkage(llvm::GlobalValue::ExternalLinkage);
+		variable.setComdat(nullptr);
+	}
+
+	// Only link the implementation and what it references, and make sure nothing clashes with other modules.
+	const std::string implementation_name = fmt::format("{}.impl", declaration.getName().str());
+	implementation->setName(implementation_name);
+	m_llvm_module->getOrInsertFunction(implementation_name, implementation_type);
+
+	const bool failed = llvm::Linker::linkModules(
+		*m_llvm_module,
+		std::move(*source),
+		llvm::Linker::LinkOnlyNeeded,
+		[](llvm::Module& module, const llvm::StringSet<>& linked_symbols) {
+			llvm::internalizeModule(
+				module, [&](const llvm::GlobalValue& value) { return linked_symbols.count(value.getName()) == 0; });
+		});
+
+	asllvm_assert(!failed && "failed to link system function bitcode");
+
+	implementation = m_llvm_module->getFunction(implementation_name);
+
+	// Turn the declaration into a forwarding function, which will always get inlined.
+	llvm::IRBuilder<> ir{llvm::BasicBlock::Create(context, "entry", &declaration)};
+
+	std::vector<llvm::Value*> args;
+	for (llvm::Argument& arg : declaration.args())
+	{
+		args.push_back(ir.CreateBitOrPointerCast(&arg, implementation_type->getParamType(arg.getArgNo())));
+	}
+
+	llvm::CallInst* result = ir.CreateCall(implementation_type, implementation, args);
+
+	if (declaration_type->getReturnType()->isVoidTy())
+	{
+		ir.CreateRetVoid();
+	}
+	else
+	{
+		ir.CreateRet(ir.CreateBitOrPointerCast(result, declaration_type->getReturnType()));
+	}
+
+	declaration.setLinkage(llvm::Function::InternalLinkage);
+	declaration.addFnAttr(llvm::Attribute::AlwaysInline);
+}
+
 llvm::FunctionType* ModuleBuilder::get_system_function_type(const asCScriptFunction& system_function)
 {
 	StandardTypes&              types = m_compiler.builder().standard_types();
@@ -176,12 +352,174 @@ llvm::FunctionType* ModuleBuilder::get_system_function_type(const asCScriptFunct
 	// C calling convention: nothing special to do
 	case ICC_CDECL: break;
 
-	default: asllvm_assert(false && "unsupported calling convention");
+	default: throw UnsupportedFeature{"unsupported calling convention"};
 	}
 
 	return llvm::FunctionType::get(return_type, parameter_types, false);
 }
 
+llvm::GlobalVariable* ModuleBuilder::get_global_variable(asPWORD address, llvm::Type* type)
+{
+	if (auto it = m_global_variables_by_address.find(address); it != m_global_variables_by_address.end())
+	{
+		return it->second;
+	}
+
+	auto* variable = new llvm::GlobalVariable(
+		*m_llvm_module,
+		type,
+		false,
+		llvm::GlobalValue::ExternalLinkage,
+		nullptr,
+		make_global_variable_name(address));
+
+	// AngelScript allocates global variables with at least a 4-byte alignment
+	variable->setAlignment(llvm::MaybeAlign(4));
+
+	m_global_variables_by_address.emplace(address, variable);
+	return variable;
+}
+
+llvm::Constant* ModuleBuilder::get_constant_global_value(asPWORD address, llvm::IntegerType* type)
+{
+	const auto& globals = script_globals();
+
+	if (const auto it = globals.find(address); it == globals.end() || !it->second.is_foldable_constant)
+	{
+		return nullptr;
+	}
+
+	// Global primitives are stored in at least 8 bytes, so this is reading the same bytes as the VM would.
+	std::uint64_t value = 0;
+	std::memcpy(&value, reinterpret_cast<const void*>(address), type->getBitWidth() / 8);
+	return llvm::ConstantInt::get(type, value);
+}
+
+bool ModuleBuilder::is_script_global(asPWORD address) { return script_globals().count(address) != 0; }
+
+llvm::Function* ModuleBuilder::get_integer_pow_function(llvm::IntegerType* type, bool is_signed)
+{
+	StandardTypes&     types   = m_compiler.builder().standard_types();
+	llvm::LLVMContext& context = *m_compiler.builder().llvm_context().getContext();
+
+	if (auto it = m_integer_pow_functions.find({type, is_signed}); it != m_integer_pow_functions.end())
+	{
+		return it->second;
+	}
+
+	llvm::StructType* result_type = llvm::StructType::get(context, {type, types.i1});
+
+	llvm::Function* function = llvm::Function::Create(
+		llvm::FunctionType::get(result_type, {type, type}, false),
+		llvm::Function::InternalLinkage,
+		fmt::format("asllvm.private.pow.{}{}", is_signed ? 'i' : 'u', type->getBitWidth()),
+		m_llvm_module.get());
+
+	function->addFnAttr(llvm::Attribute::AlwaysInline);
+	function->setDoesNotAccessMemory();
+
+	llvm::Argument* base     = function->getArg(0);
+	llvm::Argument* exponent = function->getArg(1);
+
+	llvm::Constant* zero = llvm::ConstantInt::get(type, 0);
+	llvm::Constant* one  = llvm::ConstantInt::get(type, 1);
+
+	const llvm::Intrinsic::ID multiply
+		= is_signed ? llvm::Intrinsic::smul_with_overflow : llvm::Intrinsic::umul_with_overflow;
+
+	// Not using the builder from FunctionBuilder, as this may get called while emitting a function.
+	llvm::IRBuilder<> ir{llvm::BasicBlock::Create(context, "entry", function)};
+
+	const auto make_result = [&](llvm::Value* value, llvm::Value* is_overflow) {
+		llvm::Value* result = llvm::UndefValue::get(result_type);
+		result              = ir.CreateInsertValue(result, value, 0);
+		return ir.CreateInsertValue(result, is_overflow, 1);
+	};
+
+	llvm::BasicBlock* domain_check_block = llvm::BasicBlock::Create(context, "domainCheck", function);
+	llvm::BasicBlock* domain_error_block = llvm::BasicBlock::Create(context, "domainError", function);
+	llvm::BasicBlock* loop_block         = llvm::BasicBlock::Create(context, "loop", function);
+	llvm::BasicBlock* body_block         = llvm::BasicBlock::Create(context, "body", function);
+	llvm::BasicBlock* exit_block         = llvm::BasicBlock::Create(context, "exit", function);
+
+	if (is_signed)
+	{
+		llvm::BasicBlock* negative_exponent_block
+			= llvm::BasicBlock::Create(context, "negativeExponent", function, domain_check_block);
+
+		ir.CreateCondBr(ir.CreateICmpSLT(exponent, zero), negative_exponent_block, domain_check_block);
+
+		// The result is less than 1 and truncates to 0, or this is a division by zero
+		ir.SetInsertPoint(negative_exponent_block);
+		ir.CreateRet(make_result(zero, ir.CreateICmpEQ(base, zero)));
+	}
+	else
+	{
+		ir.CreateBr(domain_check_block);
+	}
+
+	// 0 ** 0
+	ir.SetInsertPoint(domain_check_block);
+	ir.CreateCondBr(
+		ir.CreateAnd(ir.CreateICmpEQ(base, zero), ir.CreateICmpEQ(exponent, zero)), domain_error_block, loop_block);
+
+	ir.SetInsertPoint(domain_error_block);
+	ir.CreateRet(make_result(zero, ir.getTrue()));
+
+	// Exponentiation by squaring. The loop runs once per significant bit of the exponent, so it is fully unrolled for
+	// constant exponents.
+	ir.SetInsertPoint(loop_block);
+	llvm::PHINode* result             = ir.CreatePHI(type, 2, "result");
+	llvm::PHINode* factor             = ir.CreatePHI(type, 2, "factor");
+	llvm::PHINode* remaining_exponent = ir.CreatePHI(type, 2, "remainingExponent");
+	llvm::PHINode* is_overflow        = ir.CreatePHI(types.i1, 2, "isOverflow");
+	ir.CreateCondBr(ir.CreateICmpEQ(remaining_exponent, zero), exit_block, body_block);
+
+	ir.SetInsertPoint(body_block);
+	llvm::Value* is_odd = ir.CreateTrunc(remaining_exponent, types.i1);
+
+	llvm::Value* product     = ir.CreateBinaryIntrinsic(multiply, result, factor);
+	llvm::Value* next_result = ir.CreateSelect(is_odd, ir.CreateExtractValue(product, 0), result);
+
+	llvm::Value* next_exponent = ir.CreateLShr(remaining_exponent, one);
+	llvm::Value* square        = ir.CreateBinaryIntrinsic(multiply, factor, factor);
+	llvm::Value* next_factor   = ir.CreateExtractValue(square, 0);
+
+	// Squaring the factor only matters if it is used later on
+	llvm::Value* next_is_overflow = ir.CreateOr(
+		ir.CreateOr(is_overflow, ir.CreateAnd(is_odd, ir.CreateExtractValue(product, 1))),
+		ir.CreateAnd(ir.CreateICmpNE(next_exponent, zero), ir.CreateExtractValue(square, 1)));
+
+	ir.CreateBr(loop_block);
+
+	result->addIncoming(one, domain_check_block);
+	result->addIncoming(next_result, body_block);
+	factor->addIncoming(base, domain_check_block);
+	factor->addIncoming(next_factor, body_block);
+	remaining_exponent->addIncoming(exponent, domain_check_block);
+	remaining_exponent->addIncoming(next_exponent, body_block);
+	is_overflow->addIncoming(ir.getFalse(), domain_check_block);
+	is_overflow->addIncoming(next_is_overflow, body_block);
+
+	ir.SetInsertPoint(exit_block);
+	llvm::Value* is_result_overflow = is_overflow;
+
+	if (is_signed)
+	{
+		// The VM bounds the magnitude of results by the maximum value, so that e.g. `(-2) ** 31` overflows for int32
+		// even though it is representable. The base is never bounded for an exponent of 1.
+		llvm::Value* is_minimum = ir.CreateICmpEQ(
+			result, llvm::ConstantInt::get(type, llvm::APInt::getSignedMinValue(type->getBitWidth())));
+
+		is_result_overflow = ir.CreateOr(is_overflow, ir.CreateAnd(is_minimum, ir.CreateICmpNE(exponent, one)));
+	}
+
+	ir.CreateRet(make_result(ir.CreateSelect(is_result_overflow, zero, result), is_result_overflow));
+
+	m_integer_pow_functions.emplace(std::pair{type, is_signed}, function);
+	return function;
+}
+
 llvm::DIType* ModuleBuilder::get_debug_type(ModuleDebugInfo::AsTypeIdentifier script_type_id)
 {
 	asCScriptEngine& engine = m_compiler.engine();
@@ -279,18 +617,88 @@ void ModuleBuilder::build()
 	m_compiler.builder().optimizer().run(*m_llvm_module);
 
 	ExitOnError(m_compiler.jit().addIRModule(
-		llvm::orc::ThreadSafeModule(std::move(m_llvm_module), m_compiler.builder().llvm_context())));
+		*m_dylib, llvm::orc::ThreadSafeModule(std::move(m_llvm_module), m_compiler.builder().llvm_context())));
 }
 
 void ModuleBuilder::link()
 {
 	for (JitSymbol& symbol : m_jit_functions)
 	{
-		auto function = ExitOnError(m_compiler.jit().lookup(symbol.name));
+		auto function = ExitOnError(m_compiler.jit().lookup(*m_dylib, symbol.name));
 		symbol.script_function->SetUserData(reinterpret_cast<void*>(function.getAddress()), vtable_userdata_identifier);
 
-		auto entry           = ExitOnError(m_compiler.jit().lookup(symbol.entry_name));
-		*symbol.jit_function = reinterpret_cast<asJITFunction>(entry.getAddress());
+		// Functions left to the VM have no entry point, so that the VM interprets them
+		if (!symbol.entry_name.empty())
+		{
+			auto entry           = ExitOnError(m_compiler.jit().lookup(*m_dylib, symbol.entry_name));
+			*symbol.jit_function = reinterpret_cast<asJITFunction>(entry.getAddress());
+		}
+
+		if (!symbol.native_entry_name.empty())
+		{
+			auto native_entry = ExitOnError(m_compiler.jit().lookup(*m_dylib, symbol.native_entry_name));
+			symbol.script_function->SetUserData(
+				reinterpret_cast<void*>(native_entry.getAddress()), native_entry_userdata_identifier);
+
+			auto batch_entry = ExitOnError(m_compiler.jit().lookup(*m_dylib, symbol.batch_entry_name));
+			symbol.script_function->SetUserData(
+				reinterpret_cast<void*>(batch_entry.getAddress()), batch_entry_userdata_identifier);
+		}
+
+		if (m_script_module != nullptr)
+		{
+			m_compiler.register_compiled_function(
+				m_script_module, {symbol.script_function, symbol.jit_function, *symbol.jit_function});
+		}
+	}
+
+	if (m_script_module != nullptr)
+	{
+		build_dispatch_tables();
+	}
+}
+
+void ModuleBuilder::build_dispatch_tables()
+{
+	asCScriptEngine& engine = m_compiler.engine();
+
+	for (asUINT i = 0; i < m_script_module->GetObjectTypeCount(); ++i)
+	{
+		auto& object_type = *static_cast<asCObjectType*>(m_script_module->GetObjectTypeByIndex(i));
+
+		// The tables of a class never change, so they only are built once, e.g. not again on recompilation.
+		// They may be in use by running code at that point.
+		if ((object_type.flags & asOBJ_SCRIPT_OBJECT) == 0 || object_type.IsInterface()
+			|| object_type.GetUserData(dispatch_table_userdata_identifier) != nullptr)
+		{
+			continue;
+		}
+
+		runtime::DispatchTable& table = m_compiler.get_dispatch_table(object_type);
+
+		for (asUINT j = 0; j < object_type.interfaces.GetLength(); ++j)
+		{
+			const asCObjectType&    interface_type = *object_type.interfaces[j];
+			runtime::InterfaceTable interface_table{&interface_type, {}};
+
+			for (asUINT k = 0; k < interface_type.methods.GetLength(); ++k)
+			{
+				asCScriptFunction* method
+					= get_interface_implementation(object_type, *engine.scriptFunctions[interface_type.methods[k]]);
+				asllvm_assert(method != nullptr && "class does not implement all the methods of its interfaces");
+
+				interface_table.methods.push_back(method);
+			}
+
+			table.interfaces.push_back(std::move(interface_table));
+		}
+
+		for (const asCObjectType* type = &object_type; type != nullptr; type = type->derivedFrom)
+		{
+			table.supertypes.insert(table.supertypes.begin(), type);
+		}
+
+		object_type.SetUserData(&table, dispatch_table_userdata_identifier);
 	}
 }
 
@@ -340,6 +748,9 @@ StandardFunctions ModuleBuilder::setup_runtime()
 		// The object we created is unique as it was dynamically allocated
 		function->addAttribute(0, llvm::Attribute::NoAlias);
 
+		// Like the VM, allocation failures are not handled and the memory is used right away
+		function->addAttribute(0, llvm::Attribute::NonNull);
+
 		function->setOnlyAccessesInaccessibleMemory();
 
 		funcs.alloc = function;
@@ -367,6 +778,9 @@ StandardFunctions ModuleBuilder::setup_runtime()
 		// The object we created is unique as it was dynamically allocated
 		function->addAttribute(0, llvm::Attribute::NoAlias);
 
+		// The object is constructed before returning, so this could not be null
+		function->addAttribute(0, llvm::Attribute::NonNull);
+
 		funcs.new_script_object = function;
 	}
 
@@ -380,6 +794,16 @@ StandardFunctions ModuleBuilder::setup_runtime()
 		funcs.script_vtable_lookup = function;
 	}
 
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.pvoid, {types.pvoid, types.pvoid, types.pvoid}, false),
+			linkage,
+			"asllvm.private.profiled_script_vtable_lookup",
+			m_llvm_module.get());
+
+		funcs.profiled_script_vtable_lookup = function;
+	}
+
 	{
 		llvm::Function* function = llvm::Function::Create(
 			llvm::FunctionType::get(types.pvoid, {types.pvoid, types.pvoid}, false),
@@ -391,6 +815,68 @@ StandardFunctions ModuleBuilder::setup_runtime()
 		funcs.system_vtable_lookup = function;
 	}
 
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.pvoid, {types.pvoid, types.pvoid, types.i32, types.pvoid}, false),
+			linkage,
+			"asllvm.private.resolve_interface_method",
+			m_llvm_module.get());
+
+		funcs.resolve_interface_method = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.pvoid, {types.pvoid, types.pvoid, types.i32, types.pvoid}, false),
+			linkage,
+			"asllvm.private.cast_script_object",
+			m_llvm_module.get());
+
+		funcs.cast_script_object = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.pvoid, {types.pvoid, types.pvoid->getPointerTo(), types.pvoid}, false),
+			linkage,
+			"asllvm.private.resolve_function_pointer",
+			m_llvm_module.get());
+
+		funcs.resolve_function_pointer = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.vm_state, {types.pvoid, types.pvoid, types.pi64, types.pvoid}, false),
+			linkage,
+			"asllvm.private.call_system_function_pointer",
+			m_llvm_module.get());
+
+		funcs.call_system_function_pointer = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.pvoid, {types.i32}, false),
+			linkage,
+			"asllvm.private.resolve_imported_function",
+			m_llvm_module.get());
+
+		funcs.resolve_imported_function = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.tvoid, {types.pvoid, types.pvoid}, false),
+			linkage,
+			"asllvm.private.profile_call_target",
+			m_llvm_module.get());
+
+		function->setOnlyAccessesInaccessibleMemOrArgMem();
+
+		funcs.profile_call_target = function;
+	}
+
 	{
 		llvm::Function* function = llvm::Function::Create(
 			llvm::FunctionType::get(types.tvoid, {types.pvoid, types.pvoid}, false),
@@ -406,6 +892,7 @@ StandardFunctions ModuleBuilder::setup_runtime()
 			llvm::FunctionType::get(types.tvoid, {}, false), linkage, "asllvm.private.panic", m_llvm_module.get());
 
 		function->setDoesNotReturn();
+		function->addFnAttr(llvm::Attribute::Cold);
 
 		funcs.panic = function;
 	}
@@ -417,9 +904,24 @@ StandardFunctions ModuleBuilder::setup_runtime()
 			"asllvm.private.set_internal_exception",
 			m_llvm_module.get());
 
+		function->addFnAttr(llvm::Attribute::Cold);
+
 		funcs.set_internal_exception = function;
 	}
 
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.i1, {types.vm_state}, false),
+			linkage,
+			"asllvm.private.catch_exception",
+			m_llvm_module.get());
+
+		function->addFnAttr(llvm::Attribute::Cold);
+		function->addAttribute(llvm::AttributeList::ReturnIndex, llvm::Attribute::ZExt);
+
+		funcs.catch_exception = function;
+	}
+
 	{
 		llvm::Function* function = llvm::Function::Create(
 			llvm::FunctionType::get(types.tvoid, {types.pvoid}, false),
@@ -440,6 +942,120 @@ StandardFunctions ModuleBuilder::setup_runtime()
 		funcs.check_execution_status = function;
 	}
 
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(
+				types.vm_state, {types.vm_registers->getPointerTo(), types.pvoid, types.pvoid}, false),
+			linkage,
+			"asllvm.private.process_safepoint",
+			m_llvm_module.get());
+
+		function->addFnAttr(llvm::Attribute::Cold);
+
+		funcs.process_safepoint = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.tvoid, {types.vm_registers->getPointerTo(), types.i64, types.pvoid}, false),
+			linkage,
+			"asllvm.private.run_suspendable",
+			m_llvm_module.get());
+
+		funcs.run_suspendable = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.vm_state, {types.vm_registers->getPointerTo(), types.i32}, false),
+			linkage,
+			"asllvm.private.consume_execution_budget",
+			m_llvm_module.get());
+
+		function->addFnAttr(llvm::Attribute::Cold);
+
+		funcs.consume_execution_budget = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.vm_state, {types.vm_registers->getPointerTo()}, false),
+			linkage,
+			"asllvm.private.charge_function_entry",
+			m_llvm_module.get());
+
+		funcs.charge_function_entry = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(
+				types.vm_state,
+				{types.vm_registers->getPointerTo(), types.pvoid, types.pvoid, types.pi32, types.pvoid},
+				false),
+			linkage,
+			"asllvm.private.call_interpreted_function",
+			m_llvm_module.get());
+
+		funcs.call_interpreted_function = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(
+				types.vm_state,
+				{types.vm_registers->getPointerTo(),
+				 types.pvoid,
+				 types.i32,
+				 types.pi32,
+				 types.pi32,
+				 types.i32,
+				 types.i64,
+				 types.pvoid,
+				 types.pi64},
+				false),
+			linkage,
+			"asllvm.private.deoptimize",
+			m_llvm_module.get());
+
+		function->addFnAttr(llvm::Attribute::Cold);
+
+		funcs.deoptimize = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.i1, {types.vm_registers->getPointerTo(), types.pvoid}, false),
+			linkage,
+			"asllvm.private.resume_deoptimized",
+			m_llvm_module.get());
+
+		function->addAttribute(llvm::AttributeList::ReturnIndex, llvm::Attribute::ZExt);
+
+		funcs.resume_deoptimized = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(
+				types.vm_registers->getPointerTo(), {types.pvoid, types.pvoid, types.pvoid}, false),
+			linkage,
+			"asllvm.private.enter_native_call",
+			m_llvm_module.get());
+
+		funcs.enter_native_call = function;
+	}
+
+	{
+		llvm::Function* function = llvm::Function::Create(
+			llvm::FunctionType::get(types.tvoid, {types.pvoid, types.pvoid, types.vm_state}, false),
+			linkage,
+			"asllvm.private.leave_native_call",
+			m_llvm_module.get());
+
+		funcs.leave_native_call = function;
+	}
+
 	return funcs;
 }
 
@@ -450,8 +1066,67 @@ GlobalVariables ModuleBuilder::setup_global_variables()
 	return globals;
 }
 
+const std::map<asPWORD, ScriptGlobal>& ModuleBuilder::script_globals()
+{
+	if (m_script_globals.has_value())
+	{
+		return *m_script_globals;
+	}
+
+	m_script_globals.emplace();
+
+	if (m_script_module == nullptr)
+	{
+		return *m_script_globals;
+	}
+
+	asCScriptEngine& engine = m_compiler.engine();
+
+	// Without this, globals are only initialized later on and we would be reading garbage when folding them.
+	const bool are_initialized = engine.GetEngineProperty(asEP_INIT_GLOBAL_VARS_AFTER_BUILD) != 0;
+
+	std::map<const void*, asCGlobalProperty*> properties;
+	for (asUINT i = 0; i < engine.globalProperties.GetLength(); ++i)
+	{
+		if (asCGlobalProperty* property = engine.globalProperties[i]; property != nullptr)
+		{
+			properties.emplace(property->GetAddressOfValue(), property);
+		}
+	}
+
+	for (asUINT i = 0; i < m_script_module->GetGlobalVarCount(); ++i)
+	{
+		int  type_id  = 0;
+		bool is_const = false;
+		m_script_module->GetGlobalVar(i, nullptr, nullptr, &type_id, &is_const);
+
+		void* address = m_script_module->GetAddressOfGlobalVar(i);
+
+		// Other initializers may result in another value when run again, e.g. by asIScriptModule::ResetGlobalVars()
+		const auto property = properties.find(address);
+		const bool is_literal = property != properties.end() && has_literal_initializer(*property->second);
+
+		ScriptGlobal global;
+		global.is_foldable_constant
+			= are_initialized && is_const && is_literal && (type_id & asTYPEID_MASK_OBJECT) == 0;
+
+		m_script_globals->emplace(reinterpret_cast<asPWORD>(address), global);
+	}
+
+	return *m_script_globals;
+}
+
 void ModuleBuilder::build_functions()
 {
+	const auto report_interpreted = [&](const asCScriptFunction& function, const UnsupportedFeature& error) {
+		m_compiler.diagnostic(
+			fmt::format(
+				"function {} cannot be compiled and is left to the VM: {}",
+				function.GetDeclaration(true, true, true),
+				error.what()),
+			asMSGTYPE_WARNING);
+	};
+
 	for (const auto& pending : m_pending_functions)
 	{
 		if (std::find_if(
@@ -468,26 +1143,70 @@ void ModuleBuilder::build_functions()
 			continue;
 		}
 
+		auto& script_function = *static_cast<asCScriptFunction*>(pending.function);
+
 		FunctionContext context;
 		context.compiler        = &m_compiler;
 		context.module_builder  = this;
-		context.script_function = static_cast<asCScriptFunction*>(pending.function);
-		context.llvm_function   = get_script_function(*static_cast<asCScriptFunction*>(pending.function));
-
-		FunctionBuilder builder{context};
+		context.script_function = &script_function;
 
-		asUINT   length;
-		asDWORD* bytecode = pending.function->GetByteCode(&length);
-
-		builder.translate_bytecode(bytecode, length);
-
-		llvm::Function* entry = builder.create_vm_entry_thunk();
+		try
+		{
+			context.llvm_function = get_script_function(script_function);
+		}
+		catch (const UnsupportedFeature& error)
+		{
+			// JIT'd code cannot call the function either, so callers will be left to the VM as well
+			report_interpreted(script_function, error);
+			continue;
+		}
 
 		JitSymbol symbol;
 		symbol.script_function = pending.function;
 		symbol.name            = make_function_name(*pending.function); // TODO: get it from somewhere
-		symbol.entry_name      = entry->getName();
 		symbol.jit_function    = pending.jit_function;
+
+		try
+		{
+			FunctionBuilder builder{context};
+
+			asUINT   length;
+			asDWORD* bytecode = pending.function->GetByteCode(&length);
+
+			builder.translate_bytecode(bytecode, length);
+
+			// Only functions with loops the VM may be interpreting get a variant to switch to
+			llvm::Function* osr_function = nullptr;
+			if (builder.has_osr_entries())
+			{
+				FunctionContext osr_context = context;
+				osr_context.llvm_function   = create_osr_function(script_function);
+
+				osr_function = FunctionBuilder{osr_context}.translate_osr_entries(bytecode, length);
+			}
+
+			symbol.entry_name = builder.create_vm_entry_thunk(osr_function)->getName();
+		}
+		catch (const UnsupportedFeature& error)
+		{
+			report_interpreted(script_function, error);
+
+			// The function may have been translated before its OSR variant failed
+			context.llvm_function->deleteBody();
+
+			// JIT'd callers reach it through a stub, while the VM keeps interpreting it as it has no VM entry point
+			FunctionBuilder{context}.create_interpreter_stub();
+		}
+
+		if (m_compiler.config().generate_native_entries)
+		{
+			if (llvm::Function* native_entry = FunctionBuilder{context}.create_native_entry(); native_entry != nullptr)
+			{
+				symbol.native_entry_name = native_entry->getName();
+				symbol.batch_entry_name  = FunctionBuilder{context}.create_batch_entry()->getName();
+			}
+		}
+
 		m_jit_functions.push_back(symbol);
 
 		m_di_builder->finalize();
@@ -507,23 +1226,35 @@ void ModuleBuilder::link_symbols()
 
 	auto& dylib = m_compiler.jit().getMainJITDylib();
 
-	const auto define_function = [&](auto& function, llvm::StringRef name) {
+	const auto define_symbol = [&](llvm::JITTargetAddress address, llvm::StringRef name, llvm::JITSymbolFlags flags) {
 		if (m_compiler.jit().lookup(name))
 		{
 			return;
 		}
 
-		llvm::JITEvaluatedSymbol symbol(
-			llvm::pointerToJITTargetAddress(function),
-			llvm::JITSymbolFlags::Callable |
-			llvm::JITSymbolFlags::Absolute
-		);
+		symbols.insert({mangle(name), llvm::JITEvaluatedSymbol(address, flags)});
+	};
 
-		symbols.insert({mangle(name), symbol});
+	const auto define_function = [&](auto& function, llvm::StringRef name) {
+		define_symbol(
+			llvm::pointerToJITTargetAddress(function),
+			name,
+			llvm::JITSymbolFlags::Callable | llvm::JITSymbolFlags::Absolute);
 	};
 
+	for (const auto& [address, variable] : m_global_variables_by_address)
+	{
+		define_symbol(address, variable->getName(), llvm::JITSymbolFlags::Absolute);
+	}
+
 	for (const auto& it : m_system_functions)
 	{
+		// Implemented by bitcode provided by the application
+		if (!it.second->isDeclaration())
+		{
+			continue;
+		}
+
 		auto& script_func = static_cast<asCScriptFunction&>(*m_compiler.engine().GetFunctionById(it.first));
 		define_function(script_func.sysFuncIntf->func, it.second->getName());
 	}
@@ -533,12 +1264,29 @@ void ModuleBuilder::link_symbols()
 	define_function(*userFree, "asllvm.private.free");
 	define_function(runtime::new_script_object, "asllvm.private.new_script_object");
 	define_function(runtime::script_vtable_lookup, "asllvm.private.script_vtable_lookup");
+	define_function(runtime::profiled_script_vtable_lookup, "asllvm.private.profiled_script_vtable_lookup");
 	define_function(runtime::system_vtable_lookup, "asllvm.private.system_vtable_lookup");
+	define_function(runtime::resolve_interface_method, "asllvm.private.resolve_interface_method");
+	define_function(runtime::cast_script_object, "asllvm.private.cast_script_object");
+	define_function(runtime::resolve_function_pointer, "asllvm.private.resolve_function_pointer");
+	define_function(runtime::call_system_function_pointer, "asllvm.private.call_system_function_pointer");
+	define_function(runtime::resolve_imported_function, "asllvm.private.resolve_imported_function");
+	define_function(runtime::profile_call_target, "asllvm.private.profile_call_target");
 	define_function(runtime::call_object_method, "asllvm.private.call_object_method");
 	define_function(runtime::panic, "asllvm.private.panic");
 	define_function(runtime::set_internal_exception, "asllvm.private.set_internal_exception");
+	define_function(runtime::catch_exception, "asllvm.private.catch_exception");
 	define_function(runtime::prepare_system_call, "asllvm.private.prepare_system_call");
 	define_function(runtime::check_execution_status, "asllvm.private.check_execution_status");
+	define_function(runtime::process_safepoint, "asllvm.private.process_safepoint");
+	define_function(runtime::run_suspendable, "asllvm.private.run_suspendable");
+	define_function(runtime::consume_execution_budget, "asllvm.private.consume_execution_budget");
+	define_function(runtime::charge_function_entry, "asllvm.private.charge_function_entry");
+	define_function(runtime::call_interpreted_function, "asllvm.private.call_interpreted_function");
+	define_function(runtime::deoptimize, "asllvm.private.deoptimize");
+	define_function(runtime::resume_deoptimized, "asllvm.private.resume_deoptimized");
+	define_function(runtime::enter_native_call, "asllvm.private.enter_native_call");
+	define_function(runtime::leave_native_call, "asllvm.private.leave_native_call");
 
 	define_function(fmodf, "fmodf");
 	define_function(fmod, "fmod");
@@ -25,6 +25,15 @@ std::string make_vm_entry_thunk_name(const asIScriptFunction& function)
 	return make_function_name(function) + ".vmthunk";
 }
 
+std::string make_osr_function_name(const asIScriptFunction& function) { return make_function_name(function) + ".osr"; }
+
+std::string make_native_entry_name(const asIScriptFunction& function)
+{
+	return make_function_name(function) + ".native";
+}
+
+std::string make_batch_entry_name(const asIScriptFunction& function) { return make_function_name(function) + ".batch"; }
+
 std::string make_system_function_name(const asIScriptFunction& function)
 {
 	return fmt::format("asllvm.external.{}", function.GetDeclaration(true, true, false));
@@ -50,4 +59,6 @@ std::string make_debug_name(const asIScriptFunction& function)
 
 	return name;
 }
+
+std::string make_global_variable_name(asPWORD address) { return fmt::format("asllvm.global.{:x}", address); }
 } // namespace asllvm::detail
@@ -0,0 +1,84 @@
+#include <asllvm/detail/nullcheckelimination.hpp>
+
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/InitializePasses.h>
+
+namespace asllvm::detail
+{
+namespace
+{
+class NullCheckElimination final : public llvm::FunctionPass
+{
+	public:
+	static char ID;
+
+	NullCheckElimination() : llvm::FunctionPass(ID)
+	{
+		llvm::initializeDominatorTreeWrapperPassPass(*llvm::PassRegistry::getPassRegistry());
+	}
+
+	llvm::StringRef getPassName() const override { return "asllvm null check elimination"; }
+
+	void getAnalysisUsage(llvm::AnalysisUsage& usage) const override
+	{
+		usage.addRequired<llvm::DominatorTreeWrapperPass>();
+		usage.addPreserved<llvm::DominatorTreeWrapperPass>();
+		usage.setPreservesCFG();
+	}
+
+	bool runOnFunction(llvm::Function& function) override
+	{
+		const llvm::DataLayout& data_layout    = function.getParent()->getDataLayout();
+		llvm::DominatorTree&    dominator_tree = getAnalysis<llvm::DominatorTreeWrapperPass>().getDomTree();
+
+		bool changed = false;
+
+		for (llvm::Instruction& instruction : llvm::make_early_inc_range(llvm::instructions(function)))
+		{
+			auto* compare = llvm::dyn_cast<llvm::ICmpInst>(&instruction);
+			if (compare == nullptr || !compare->isEquality())
+			{
+				continue;
+			}
+
+			llvm::Value* pointer = nullptr;
+
+			if (llvm::isa<llvm::ConstantPointerNull>(compare->getOperand(1)))
+			{
+				pointer = compare->getOperand(0);
+			}
+			else if (llvm::isa<llvm::ConstantPointerNull>(compare->getOperand(0)))
+			{
+				pointer = compare->getOperand(1);
+			}
+
+			// Dominating conditions are only considered with a context instruction and the dominator tree
+			if (pointer == nullptr || !llvm::isKnownNonZero(pointer, data_layout, 0, nullptr, compare, &dominator_tree))
+			{
+				continue;
+			}
+
+			// The pointer is not null, so only `p != null` holds
+			compare->replaceAllUsesWith(
+				llvm::ConstantInt::getBool(compare->getType(), compare->getPredicate() == llvm::CmpInst::ICMP_NE));
+			compare->eraseFromParent();
+
+			changed = true;
+		}
+
+		return changed;
+	}
+};
+
+char NullCheckElimination::ID = 0;
+} // namespace
+
+llvm::FunctionPass* create_null_check_elimination_pass() { return new NullCheckElimination(); }
+} // namespace asllvm::detail
@@ -0,0 +1,87 @@
+#include <asllvm/detail/profile.hpp>
+
+#include <asllvm/detail/modulecommon.hpp>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace asllvm::detail
+{
+void VirtualCallProfile::record(asCScriptFunction* receiver)
+{
+	if (auto it = std::find(receivers.begin(), receivers.end(), receiver); it != receivers.end())
+	{
+		++counts[std::distance(receivers.begin(), it)];
+		return;
+	}
+
+	// Forgotten receivers leave holes, so that the first free slot is not necessarily the last one
+	const auto free_slot = std::find(receivers.begin(), receivers.end(), nullptr);
+
+	// The JIT is told about JIT'd functions being discarded, see JitCompiler::discard_function()
+	if (free_slot == receivers.end() || receiver->funcType != asFUNC_SCRIPT
+		|| receiver->GetUserData(vtable_userdata_identifier) == nullptr)
+	{
+		++other_count;
+		return;
+	}
+
+	*free_slot                                         = receiver;
+	counts[std::distance(receivers.begin(), free_slot)] = 1;
+}
+
+void VirtualCallProfile::forget(const asCScriptFunction* receiver)
+{
+	for (std::size_t i = 0; i < max_receivers; ++i)
+	{
+		if (receivers[i] == receiver)
+		{
+			other_count += counts[i];
+			receivers[i] = nullptr;
+			counts[i]    = 0;
+		}
+	}
+}
+
+asCScriptFunction* VirtualCallProfile::get_dominant_receiver(double min_ratio) const
+{
+	const std::uint64_t total = std::accumulate(counts.begin(), counts.end(), other_count);
+	if (total == 0)
+	{
+		return nullptr;
+	}
+
+	const auto it = std::max_element(counts.begin(), counts.end());
+	if (double(*it) < double(total) * min_ratio)
+	{
+		return nullptr;
+	}
+
+	return receivers[std::distance(counts.begin(), it)];
+}
+
+std::vector<std::uint32_t> VirtualCallProfile::get_guard_weights(asCScriptFunction* receiver) const
+{
+	const auto          it    = std::find(receivers.begin(), receivers.end(), receiver);
+	const std::uint64_t count = it != receivers.end() ? counts[std::distance(receivers.begin(), it)] : 0;
+	const std::uint64_t total = std::accumulate(counts.begin(), counts.end(), other_count);
+
+	return to_branch_weights({count, total - count});
+}
+
+std::vector<std::uint32_t> to_branch_weights(llvm::ArrayRef<std::uint64_t> counts)
+{
+	const std::uint64_t max_count = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+	const std::uint64_t scale     = max_count / std::numeric_limits<std::uint32_t>::max() + 1;
+
+	std::vector<std::uint32_t> weights;
+	weights.reserve(counts.size());
+
+	for (std::uint64_t count : counts)
+	{
+		weights.push_back(std::uint32_t(count / scale));
+	}
+
+	return weights;
+}
+} // namespace asllvm::detail
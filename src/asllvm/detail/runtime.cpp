@@ -1,10 +1,356 @@
 #include <asllvm/detail/runtime.hpp>
 
+#include <asllvm/detail/ashelper.hpp>
 #include <asllvm/detail/assert.hpp>
 #include <asllvm/detail/modulecommon.hpp>
+#include <asllvm/jit.hpp>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
 
 namespace asllvm::detail::runtime
 {
+namespace
+{
+//! \brief
+//!		Fill a call site cache with \p entry for \p key, unless it was filled already during the current epoch. Only
+//!		the first key is ever cached, but its entry is refreshed once stale.
+//! \see call_site_cache_epoch
+template<typename Key>
+void fill_call_site_cache(
+	std::atomic<Key*>&   cached_key,
+	std::atomic<void*>&  cached_entry,
+	std::atomic<asUINT>& cached_epoch,
+	Key*                 key,
+	void*                entry)
+{
+	const asUINT epoch = call_site_cache_epoch.load(std::memory_order_acquire);
+
+	// The address of the cache is a key that no generated code compares against while the entry is written. A call
+	// site only hits once the key matches and the epoch is current, so that it sees the refreshed entry of the key.
+	Key*  expected = nullptr;
+	auto* updating = reinterpret_cast<Key*>(&cached_key);
+	if (cached_key.compare_exchange_strong(expected, updating, std::memory_order_acquire)
+		|| (expected == key && cached_epoch.load(std::memory_order_relaxed) != epoch
+			&& cached_key.compare_exchange_strong(expected, updating, std::memory_order_acquire)))
+	{
+		cached_entry.store(entry, std::memory_order_relaxed);
+		cached_epoch.store(epoch, std::memory_order_release);
+		cached_key.store(key, std::memory_order_release);
+	}
+}
+
+//! \brief Memory mapping for the stack scripts run on, with an inaccessible guard page below it.
+//! \details Overflowing the stack faults on the guard page rather than silently overwriting other memory.
+class ScriptStack
+{
+	public:
+	//! \brief Size of the stack, excluding the guard page. Pages are only committed as the stack grows.
+	static constexpr std::size_t size = 8 * 1024 * 1024;
+
+	ScriptStack() : m_guard_size{std::size_t(sysconf(_SC_PAGESIZE))}
+	{
+		void* mapping = mmap(
+			nullptr, m_guard_size + size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+		if (mapping == MAP_FAILED)
+		{
+			throw std::bad_alloc{};
+		}
+
+		m_mapping = static_cast<char*>(mapping);
+
+		// The stack grows down, towards the guard page
+		if (mprotect(m_mapping, m_guard_size, PROT_NONE) != 0)
+		{
+			munmap(m_mapping, m_guard_size + size);
+			throw std::bad_alloc{};
+		}
+	}
+
+	~ScriptStack() { munmap(m_mapping, m_guard_size + size); }
+
+	ScriptStack(const ScriptStack&) = delete;
+	ScriptStack& operator=(const ScriptStack&) = delete;
+
+	//! \brief Lowest address of the usable stack, right above the guard page.
+	char* base() const { return m_mapping + m_guard_size; }
+
+	private:
+	std::size_t m_guard_size;
+	char*       m_mapping = nullptr;
+};
+
+//! \brief Script execution entered from the VM on its own stack, so that it can be suspended at a safepoint.
+//! \details Owned by the context, as user data, and reused for every execution of the context.
+//! \see run_suspendable()
+struct SuspendableExecution
+{
+	ScriptStack stack;
+
+	ucontext_t host{}, script{};
+
+	asSVMRegisters* registers = nullptr;
+	asPWORD         argument  = 0;
+	asJITFunction   thunk     = nullptr;
+
+	//! \brief
+	//!		Instruction the context resumes from, which enters the JIT again with \ref resume_argument(). It points
+	//!		within \ref resume_buffer, past the end of the bytecode of the function the VM entered the JIT from.
+	//! \see place_resume_bytecode()
+	asDWORD* resume_bytecode = nullptr;
+
+	//! \brief Storage for \ref resume_bytecode, large enough to place it at any offset from a function.
+	std::vector<asDWORD> resume_buffer;
+
+	//! \brief Whether the script is running on \ref stack, or suspended within it.
+	bool running = false, suspended = false;
+
+	//! \brief Whether the suspended script is being unwound because it will never be resumed.
+	bool discarding = false;
+
+	asPWORD resume_argument() const { return reinterpret_cast<asPWORD>(this); }
+};
+
+thread_local SuspendableExecution* starting_execution = nullptr;
+
+void run_script_stack()
+{
+	SuspendableExecution& execution = *starting_execution;
+	execution.thunk(execution.registers, execution.argument);
+	execution.running = false;
+
+	// Returns to execution.host, see uc_link
+}
+
+void switch_to_script(SuspendableExecution& execution)
+{
+	execution.running = true;
+	swapcontext(&execution.host, &execution.script);
+}
+
+//! \brief Unwind a suspended script that will not be resumed, releasing the objects its frames hold.
+void discard(SuspendableExecution& execution)
+{
+	// The generated code unwinding the script writes to the registers as when raising exceptions
+	const asSVMRegisters registers = *execution.registers;
+
+	execution.discarding = true;
+	switch_to_script(execution);
+	execution.discarding = false;
+	execution.suspended  = false;
+
+	*execution.registers = registers;
+}
+
+//! \brief Place the resume instruction of \p execution past the end of the bytecode of \p entry_function.
+//! \details
+//!		The VM determines which objects of the frame are alive from the program pointer when cleaning up a suspended
+//!		context, and finds none past the end of the function. It computes the offset of the program pointer as an
+//!		`asUINT`, which is truncated for an instruction that lies elsewhere in memory. Offsets grow by one for each
+//!		word of the buffer, which spans more words than the function, so one of them is always at or past the end.
+void place_resume_bytecode(SuspendableExecution& execution, asCScriptFunction& entry_function)
+{
+	const asDWORD* byte_code = entry_function.scriptData->byteCode.AddressOf();
+	const asUINT   length    = entry_function.scriptData->byteCode.GetLength();
+
+	execution.resume_buffer.resize(std::size_t(length) + 1 + AS_PTR_SIZE);
+
+	asDWORD*     resume_bytecode = execution.resume_buffer.data();
+	const asUINT offset          = asUINT(resume_bytecode - byte_code);
+	if (offset < length)
+	{
+		resume_bytecode += length - offset;
+	}
+
+	asllvm_assert(asUINT(resume_bytecode - byte_code) >= length);
+	execution.resume_bytecode = resume_bytecode;
+}
+
+//! \brief A frame of a JIT'd function, passed from deoptimize() to resume_deoptimized() through the VM.
+struct DeoptimizedFrame
+{
+	asCScriptFunction* function;
+
+	//! \brief Bytecode offset the VM resumes the function at.
+	asUINT offset;
+
+	//! \brief Parameters laid out like on the VM stack, starting with the object for methods.
+	asDWORD* parameters;
+
+	//! \brief Local variables and the temporary stack, in the order of the VM frame, ending with the variable at `-1`.
+	asDWORD* frame;
+	asUINT   frame_dwords;
+
+	asQWORD value_register;
+};
+
+thread_local const DeoptimizedFrame* pending_deoptimization = nullptr;
+
+//! \brief Prepare \p function to run as a nested execution of \p context, like a system function calling back into
+//! scripts would.
+//! \returns Whether the function was prepared. Otherwise, \p failure was raised as an exception.
+bool prepare_nested_execution(asCContext* context, asCScriptFunction* function, void* object, const char* failure)
+{
+	if (context->PushState() < 0)
+	{
+		context->SetException(failure);
+		return false;
+	}
+
+	if (context->Prepare(function) < 0)
+	{
+		context->PopState();
+		context->SetException(failure);
+		return false;
+	}
+
+	if (object != nullptr)
+	{
+		context->SetObject(object);
+	}
+
+	return true;
+}
+
+//! \brief Run \p function, prepared by prepare_nested_execution(), and leave the nested execution.
+//! \details
+//!		The return value is written to \p return_value as a JIT'd function would. Exceptions are raised again within
+//!		the calling frame, so that they can be caught there.
+VmState run_nested_execution(asCContext* context, asCScriptFunction* function, void* return_value, const char* failure)
+{
+	int  status        = context->Execute();
+	bool was_suspended = false;
+
+	// Nested executions cannot be suspended, so the request is passed on to the outer execution instead
+	while (status == asEXECUTION_SUSPENDED)
+	{
+		was_suspended = true;
+		status        = context->Execute();
+	}
+
+	std::string exception;
+	if (status == asEXECUTION_FINISHED && return_value != nullptr)
+	{
+		// References are returned in the value register, even to objects
+		if ((function->returnType.IsObject() || function->returnType.IsObjectHandle())
+			&& !function->returnType.IsReference())
+		{
+			// Take over the reference held by the context, as when returning from a JIT'd function
+			*static_cast<void**>(return_value) = context->m_regs.objectRegister;
+			context->m_regs.objectRegister    = nullptr;
+		}
+		else
+		{
+			// Only write the returned type, as callers may not pass a whole value register, e.g. native entry points
+			// returning into the result array of a batch
+			const std::size_t size = function->returnType.IsReference()
+				? sizeof(void*)
+				: std::size_t(function->returnType.GetSizeInMemoryBytes());
+			std::memcpy(return_value, &context->m_regs.valueRegister, size);
+		}
+	}
+	else if (status == asEXECUTION_EXCEPTION)
+	{
+		exception = context->GetExceptionString();
+	}
+
+	context->PopState();
+
+	if (was_suspended)
+	{
+		context->Suspend();
+	}
+
+	switch (status)
+	{
+	case asEXECUTION_FINISHED: return VmState::Ok;
+
+	case asEXECUTION_ABORTED:
+	{
+		context->Abort();
+		context->m_status = asEXECUTION_ABORTED;
+		return VmState::Aborted;
+	}
+
+	default:
+	{
+		context->SetException(exception.empty() ? failure : exception.c_str());
+		return VmState::ExceptionExternal;
+	}
+	}
+}
+//! \brief Get the method a \p delegate of a script method calls, resolving virtual and interface methods.
+asCScriptFunction* resolve_delegate_method(const asCScriptFunction& delegate)
+{
+	asCScriptFunction* method      = delegate.funcForDelegate;
+	auto*              object      = static_cast<asCScriptObject*>(delegate.objForDelegate);
+	auto&              object_type = *static_cast<asCObjectType*>(object->GetObjectType());
+
+	if (method->funcType == asFUNC_INTERFACE)
+	{
+		method = get_interface_implementation(object_type, *method);
+	}
+	else if (method->funcType == asFUNC_VIRTUAL)
+	{
+		method = object_type.virtualFunctionTable[method->vfTableIdx];
+	}
+
+	return method;
+}
+
+//! \brief
+//!		Call \p function, a script function or a delegate of a script method that was not built by this JIT, with the
+//!		arguments of call_system_function_pointer().
+VmState call_unbuilt_function_pointer(
+	asCContext*        context,
+	asCScriptFunction* function,
+	asDWORD*           arguments,
+	asQWORD*           value_register,
+	void**             object_register)
+{
+	void*              object = nullptr;
+	asCScriptFunction* callee = function;
+
+	if (function->funcType == asFUNC_DELEGATE)
+	{
+		object = function->objForDelegate;
+		callee = resolve_delegate_method(*function);
+	}
+
+	// Like functions left to the VM, nested executions cannot return objects on the stack of the caller
+	if (callee->DoesReturnOnStack())
+	{
+		context->SetException("Failed to call a function that was not built by the JIT");
+		return VmState::ExceptionExternal;
+	}
+
+	void* return_value = nullptr;
+	if (callee->returnType.GetTokenType() != ttVoid)
+	{
+		const bool is_object = (callee->returnType.IsObject() || callee->returnType.IsObjectHandle())
+			&& !callee->returnType.IsReference();
+		return_value = is_object ? static_cast<void*>(object_register) : static_cast<void*>(value_register);
+	}
+
+	return call_interpreted_function(&context->m_regs, callee, object, arguments, return_value);
+}
+} // namespace
+
+std::atomic<asUINT> call_site_cache_epoch{0};
+std::atomic<asUINT> function_discard_epoch{0};
+
+std::array<FunctionEntryCounter, std::size_t(1) << function_entry_counter_bits> function_entry_counters{};
+
+static_assert(
+	sizeof(FunctionEntryCounter) == 2 * sizeof(void*) && sizeof(std::atomic<asSVMRegisters*>) == sizeof(void*)
+		&& sizeof(std::atomic<asUINT>) == sizeof(asUINT),
+	"FunctionEntryCounter must match the layout the generated code accesses it with");
+
 void* script_vtable_lookup(asCScriptObject* object, asCScriptFunction* function)
 {
 	auto& object_type = *static_cast<asCObjectType*>(object->GetObjectType());
@@ -12,6 +358,16 @@ void* script_vtable_lookup(asCScriptObject* object, asCScriptFunction* function)
 		object_type.virtualFunctionTable[function->vfTableIdx]->GetUserData(vtable_userdata_identifier));
 }
 
+void* profiled_script_vtable_lookup(asCScriptObject* object, asCScriptFunction* function, VirtualCallProfile* profile)
+{
+	auto&              object_type = *static_cast<asCObjectType*>(object->GetObjectType());
+	asCScriptFunction* resolved    = object_type.virtualFunctionTable[function->vfTableIdx];
+
+	profile->record(resolved);
+
+	return reinterpret_cast<void*>(resolved->GetUserData(vtable_userdata_identifier));
+}
+
 void* system_vtable_lookup(void* object, asPWORD func)
 {
 	// TODO: this likely does not have to be a function
@@ -24,6 +380,272 @@ void* system_vtable_lookup(void* object, asPWORD func)
 #endif
 }
 
+void* resolve_interface_method(
+	asCScriptObject* object, asCScriptFunction* function, asUINT method_index, InterfaceCallCache* cache)
+{
+	auto&              object_type = *static_cast<asCObjectType*>(object->GetObjectType());
+	const auto*        table
+		= static_cast<const DispatchTable*>(object_type.GetUserData(dispatch_table_userdata_identifier));
+	asCScriptFunction* method = nullptr;
+
+	if (table != nullptr)
+	{
+		for (const InterfaceTable& interface_table : table->interfaces)
+		{
+			if (interface_table.interface_type == function->objectType)
+			{
+				method = interface_table.methods[method_index];
+				break;
+			}
+		}
+	}
+
+	// Classes of modules that were not built by the JIT have no dispatch table
+	if (method == nullptr)
+	{
+		method = get_interface_implementation(object_type, *function);
+	}
+
+	void* entry = method->GetUserData(vtable_userdata_identifier);
+
+	// Only classes with a dispatch table start a new epoch when discarded, see JitCompiler::discard_type()
+	if (table != nullptr)
+	{
+		fill_call_site_cache(cache->object_type, cache->entry, cache->epoch, &object_type, entry);
+	}
+
+	return entry;
+}
+
+void* cast_script_object(asCScriptObject* object, asCObjectType* target, asUINT target_depth, CastCache* cache)
+{
+	auto&       object_type = *static_cast<asCObjectType*>(object->GetObjectType());
+	const auto* table
+		= static_cast<const DispatchTable*>(object_type.GetUserData(dispatch_table_userdata_identifier));
+	bool is_subtype = false;
+
+	if (table != nullptr)
+	{
+		if (target->IsInterface())
+		{
+			is_subtype = std::any_of(
+				table->interfaces.begin(), table->interfaces.end(), [&](const InterfaceTable& interface_table) {
+					return interface_table.interface_type == target;
+				});
+		}
+		else
+		{
+			is_subtype = target_depth < table->supertypes.size() && table->supertypes[target_depth] == target;
+		}
+	}
+	else
+	{
+		is_subtype = object_type.Implements(target) || object_type.DerivesFrom(target);
+	}
+
+	if (!is_subtype)
+	{
+		return nullptr;
+	}
+
+	// Only classes with a dispatch table start a new epoch when discarded, see JitCompiler::discard_type(). Unlike
+	// the other caches, any class found in this one can be used as is, so it can simply be overwritten.
+	if (table != nullptr)
+	{
+		const asUINT epoch = call_site_cache_epoch.load(std::memory_order_acquire);
+		cache->object_type.store(&object_type, std::memory_order_relaxed);
+		cache->epoch.store(epoch, std::memory_order_release);
+	}
+
+	return object;
+}
+
+void* resolve_function_pointer(asCScriptFunction* function, void** delegate_object, FunctionPointerCache* cache)
+{
+	*delegate_object = nullptr;
+
+	switch (function->funcType)
+	{
+	case asFUNC_SCRIPT:
+	{
+		void* entry = function->GetUserData(vtable_userdata_identifier);
+
+		// Functions that were not built by this JIT, e.g. of modules that are not built yet, are left to the VM
+		if (entry != nullptr)
+		{
+			// Only the first function gets cached, which is what monomorphic call sites need
+			fill_call_site_cache(cache->function, cache->entry, cache->epoch, function, entry);
+		}
+
+		return entry;
+	}
+
+	case asFUNC_DELEGATE:
+	{
+		if (function->funcForDelegate->funcType == asFUNC_SYSTEM)
+		{
+			return nullptr;
+		}
+
+		// Delegates are created at runtime and short-lived, so they are not cached
+		*delegate_object = function->objForDelegate;
+		return resolve_delegate_method(*function)->GetUserData(vtable_userdata_identifier);
+	}
+
+	default: return nullptr;
+	}
+}
+
+VmState call_system_function_pointer(
+	asCScriptFunction* function, asDWORD* arguments, asQWORD* value_register, void** object_register)
+{
+	asCContext* context = static_cast<asCContext*>(asGetActiveContext());
+
+	// Script functions get here when resolve_function_pointer() found no JIT'd entry for them
+	if (function->funcType == asFUNC_SCRIPT
+		|| (function->funcType == asFUNC_DELEGATE && function->funcForDelegate->funcType != asFUNC_SYSTEM))
+	{
+		return call_unbuilt_function_pointer(context, function, arguments, value_register, object_register);
+	}
+
+	asDWORD* const     old_stack_pointer = context->m_regs.stackPointer;
+	asCScriptFunction* callee            = function;
+
+	// The arguments are laid out like on the VM stack, see FunctionBuilder::emit_function_pointer_call()
+	context->m_regs.stackPointer = arguments;
+
+	if (function->funcType == asFUNC_DELEGATE)
+	{
+		// Like the VM, push the object in the stack space reserved for it
+		context->m_regs.stackPointer -= AS_PTR_SIZE;
+		*reinterpret_cast<asPWORD*>(context->m_regs.stackPointer) = reinterpret_cast<asPWORD>(function->objForDelegate);
+		callee = function->funcForDelegate;
+	}
+
+	CallSystemFunction(callee->GetId(), context);
+
+	context->m_regs.stackPointer = old_stack_pointer;
+
+	if (callee->returnType.GetTokenType() != ttVoid && !callee->DoesReturnOnStack())
+	{
+		if (callee->returnType.IsObject() || callee->returnType.IsObjectHandle())
+		{
+			*object_register               = context->m_regs.objectRegister;
+			context->m_regs.objectRegister = nullptr;
+		}
+		else
+		{
+			*value_register = context->m_regs.valueRegister;
+		}
+	}
+
+	return check_execution_status();
+}
+
+void invalidate_call_site_caches() { call_site_cache_epoch.fetch_add(1, std::memory_order_acq_rel); }
+
+VmState call_interpreted_function(
+	asSVMRegisters* registers, asCScriptFunction* function, void* object, asDWORD* arguments, void* return_value)
+{
+	asCContext* context = static_cast<asCContext*>(registers->ctx);
+
+	constexpr const char* failure = "Failed to call a function left to the VM";
+
+	// The nested execution would return the object in its own stack, rather than in the frame of the caller
+	if (function->DoesReturnOnStack())
+	{
+		context->SetException(failure);
+		return VmState::ExceptionExternal;
+	}
+
+	if (!prepare_nested_execution(context, function, object, failure))
+	{
+		return VmState::ExceptionExternal;
+	}
+
+	// The arguments are laid out like on the VM stack, see FunctionBuilder::create_interpreter_stub(). Handles are
+	// passed on as they are, as the callee releases its handle parameters like a JIT'd function does.
+	for (asUINT i = 0; i < function->parameterTypes.GetLength(); ++i)
+	{
+		const asUINT dwords = function->parameterTypes[i].GetSizeOnStackDWords();
+		std::memcpy(context->GetAddressOfArg(i), arguments, dwords * sizeof(asDWORD));
+		arguments += dwords;
+	}
+
+	return run_nested_execution(context, function, return_value, failure);
+}
+
+VmState deoptimize(
+	asSVMRegisters*    registers,
+	asCScriptFunction* function,
+	asUINT             offset,
+	asDWORD*           parameters,
+	asDWORD*           frame,
+	asUINT             frame_dwords,
+	asQWORD            value_register,
+	void*              return_value,
+	std::uint64_t*     counter)
+{
+	asCContext* context = static_cast<asCContext*>(registers->ctx);
+
+	constexpr const char* failure = "Failed to resume a function in the VM";
+
+	++*counter;
+
+	void* object = function->objectType != nullptr ? *reinterpret_cast<void**>(parameters) : nullptr;
+	if (!prepare_nested_execution(context, function, object, failure))
+	{
+		return VmState::ExceptionExternal;
+	}
+
+	// The frame is written once the VM enters the function, see resume_deoptimized()
+	const DeoptimizedFrame deoptimized_frame{function, offset, parameters, frame, frame_dwords, value_register};
+	pending_deoptimization = &deoptimized_frame;
+
+	const VmState state = run_nested_execution(context, function, return_value, failure);
+
+	// The VM enters the function through its JIT entry point, which resumes the frame
+	asllvm_assert(pending_deoptimization == nullptr);
+	pending_deoptimization = nullptr;
+
+	return state;
+}
+
+bool resume_deoptimized(asSVMRegisters* registers, asCScriptFunction* function)
+{
+	const DeoptimizedFrame* frame = pending_deoptimization;
+	if (frame == nullptr || frame->function != function)
+	{
+		return false;
+	}
+
+	pending_deoptimization = nullptr;
+
+	// The frame of the JIT'd function mirrors the VM frame, see StackFrame
+	const asUINT parameter_dwords
+		= function->GetSpaceNeededForArguments() + (function->objectType != nullptr ? AS_PTR_SIZE : 0);
+
+	asDWORD* frame_pointer = registers->stackFramePointer;
+	std::memcpy(frame_pointer, frame->parameters, parameter_dwords * sizeof(asDWORD));
+	std::memcpy(frame_pointer - frame->frame_dwords, frame->frame, frame->frame_dwords * sizeof(asDWORD));
+
+	registers->stackPointer   = frame_pointer - frame->frame_dwords;
+	registers->valueRegister  = frame->value_register;
+	registers->programPointer = function->scriptData->byteCode.AddressOf() + frame->offset;
+
+	return true;
+}
+
+void* resolve_imported_function(int function_id)
+{
+	auto& engine = *static_cast<asCScriptEngine*>(asGetActiveContext()->GetEngine());
+
+	const int bound_id = engine.importedFunctions[function_id & ~FUNC_IMPORTED]->boundFunctionId;
+	return bound_id >= 0 ? engine.scriptFunctions[bound_id] : nullptr;
+}
+
+void profile_call_target(asCScriptFunction* function, VirtualCallProfile* profile) { profile->record(function); }
+
 void call_object_method(void* object, asCScriptFunction* function)
 {
 	// TODO: this is not very efficient: this performs an extra call into AS that is more generic than we require: we
@@ -47,12 +669,44 @@ void set_internal_exception(VmState state)
 
 	switch (state)
 	{
-	case VmState::ExceptionExternal: break;
+	case VmState::ExceptionExternal:
+	case VmState::Aborted: break;
 	case VmState::ExceptionNullPointer: context->SetInternalException(TXT_NULL_POINTER_ACCESS); break;
+	case VmState::ExceptionPowOverflow: context->SetInternalException(TXT_POW_OVERFLOW); break;
+	case VmState::ExceptionDivideByZero: context->SetInternalException(TXT_DIVIDE_BY_ZERO); break;
+	case VmState::ExceptionDivideOverflow: context->SetInternalException(TXT_DIVIDE_OVERFLOW); break;
+	case VmState::ExceptionUnboundFunction: context->SetInternalException(TXT_UNBOUND_FUNCTION); break;
+	// Same messages as the add-ons raise
+	case VmState::ExceptionArrayOutOfBounds: context->SetException("Index out of bounds"); break;
+	case VmState::ExceptionStringOutOfRange: context->SetException("Out of range"); break;
 	default: asllvm_assert(false && "unexpected");
 	}
 }
 
+bool catch_exception(VmState state)
+{
+	if (state == VmState::Aborted)
+	{
+		return false;
+	}
+
+	asCContext* context = static_cast<asCContext*>(asGetActiveContext());
+
+	// The exception was raised by JIT'd code, so the context does not know about it yet: let the exception callback
+	// and the exception information see it, as they would in the VM
+	if (state != VmState::ExceptionExternal)
+	{
+		set_internal_exception(state);
+	}
+
+	// Resume execution as the VM does when unwinding to a catch block
+	context->m_status                = asEXECUTION_ACTIVE;
+	context->m_exceptionWillBeCaught = false;
+	context->m_regs.doProcessSuspend = context->m_doSuspend || context->m_lineCallback;
+
+	return true;
+}
+
 void prepare_system_call(asCScriptFunction* callee)
 {
 	asCContext* context = static_cast<asCContext*>(asGetActiveContext());
@@ -66,9 +720,249 @@ VmState check_execution_status()
 	{
 	case asEXECUTION_EXCEPTION:
 	case asEXECUTION_ERROR: return VmState::ExceptionExternal;
+	case asEXECUTION_ABORTED: return VmState::Aborted;
 	default: break;
 	}
 
 	return VmState::Ok;
 }
+
+VmState process_safepoint(asSVMRegisters* registers, asCScriptFunction* function, asDWORD* bytecode)
+{
+	asCContext* context   = static_cast<asCContext*>(registers->ctx);
+	auto*       execution = static_cast<SuspendableExecution*>(context->GetUserData(execution_userdata_identifier));
+
+	if (context->m_lineCallback)
+	{
+		// Let the callback see where the script is, e.g. through asIScriptContext::GetLineNumber()
+		asCScriptFunction* current_function = context->m_currentFunction;
+		asDWORD*           program_pointer  = registers->programPointer;
+
+		context->m_currentFunction = function;
+		registers->programPointer  = bytecode;
+		context->CallLineCallback();
+		context->m_currentFunction = current_function;
+		registers->programPointer  = program_pointer;
+	}
+
+	if (context->m_doAbort)
+	{
+		// The VM clears m_doAbort once the JIT'd code returned to it
+		context->m_status = asEXECUTION_ABORTED;
+		return VmState::Aborted;
+	}
+
+	// Scripts that do not run on their own stack are suspended by the VM once they return to it
+	if (!context->m_doSuspend || execution == nullptr || !execution->running || context->IsNested())
+	{
+		return VmState::Ok;
+	}
+
+	// Enter the JIT again when the context is resumed, see asBC_JitEntry in asCContext::ExecuteNext()
+	place_resume_bytecode(*execution, *context->m_currentFunction);
+	*reinterpret_cast<asBYTE*>(&execution->resume_bytecode[0]) = asBC_JitEntry;
+	asBC_PTRARG(execution->resume_bytecode)                    = execution->resume_argument();
+
+	execution->running   = false;
+	execution->suspended = true;
+	context->m_status    = asEXECUTION_SUSPENDED;
+	swapcontext(&execution->script, &execution->host);
+
+	if (execution->discarding)
+	{
+		return VmState::Aborted;
+	}
+
+	// Resumed by asIScriptContext::Execute()
+	context->m_doSuspend        = false;
+	registers->doProcessSuspend = context->m_lineCallback;
+
+	return VmState::Ok;
+}
+
+void run_suspendable(asSVMRegisters* registers, asPWORD argument, asJITFunction thunk)
+{
+	asIScriptContext* context = registers->ctx;
+	auto* execution = static_cast<SuspendableExecution*>(context->GetUserData(execution_userdata_identifier));
+
+	// e.g. a system function calling a script function of the same context, already running on the script stack
+	if (execution != nullptr && execution->running)
+	{
+		thunk(registers, argument);
+		return;
+	}
+
+	if (execution == nullptr)
+	{
+		execution = new SuspendableExecution;
+		context->SetUserData(execution, execution_userdata_identifier);
+	}
+
+	if (execution->suspended && argument == execution->resume_argument())
+	{
+		execution->suspended = false;
+		switch_to_script(*execution);
+	}
+	else
+	{
+		// The context was prepared again since the script was suspended
+		if (execution->suspended)
+		{
+			discard(*execution);
+		}
+
+		execution->registers = registers;
+		execution->argument  = argument;
+		execution->thunk     = thunk;
+
+		getcontext(&execution->script);
+		execution->script.uc_stack.ss_sp   = execution->stack.base();
+		execution->script.uc_stack.ss_size = ScriptStack::size;
+		execution->script.uc_link          = &execution->host;
+		makecontext(&execution->script, run_script_stack, 0);
+
+		starting_execution = execution;
+		switch_to_script(*execution);
+	}
+
+	if (execution->suspended)
+	{
+		registers->programPointer = execution->resume_bytecode;
+	}
+}
+
+void release_execution(asIScriptContext* context)
+{
+	auto* execution = static_cast<SuspendableExecution*>(context->GetUserData(execution_userdata_identifier));
+
+	if (execution != nullptr && execution->suspended)
+	{
+		discard(*execution);
+	}
+
+	delete execution;
+}
+
+VmState consume_execution_budget(asSVMRegisters* registers, asUINT iterations)
+{
+	asCContext* context = static_cast<asCContext*>(registers->ctx);
+	auto*       budget  = static_cast<ExecutionBudget*>(context->GetUserData(budget_userdata_identifier));
+
+	if (budget == nullptr)
+	{
+		return VmState::Ok;
+	}
+
+	bool is_exhausted = false;
+
+	if (budget->iterations.has_value())
+	{
+		is_exhausted        = *budget->iterations <= iterations;
+		*budget->iterations = is_exhausted ? 0 : *budget->iterations - iterations;
+	}
+
+	if (budget->deadline.has_value() && std::chrono::steady_clock::now() >= *budget->deadline)
+	{
+		is_exhausted = true;
+	}
+
+	if (!is_exhausted)
+	{
+		return VmState::Ok;
+	}
+
+	// Unwind as for asIScriptContext::Abort(), so that `catch` blocks cannot keep a runaway script going
+	context->Abort();
+	context->m_status = asEXECUTION_ABORTED;
+	return VmState::Aborted;
+}
+
+VmState charge_function_entry(asSVMRegisters* registers)
+{
+	FunctionEntryCounter& counter
+		= function_entry_counters[get_function_entry_counter_index(reinterpret_cast<std::uintptr_t>(registers))];
+
+	// Taken over from another context, whose partial batch is dropped
+	if (counter.registers.load(std::memory_order_relaxed) != registers)
+	{
+		counter.registers.store(registers, std::memory_order_relaxed);
+		counter.entries_left.store(execution_budget_batch_size - 1, std::memory_order_relaxed);
+		return VmState::Ok;
+	}
+
+	counter.entries_left.store(execution_budget_batch_size, std::memory_order_relaxed);
+	return consume_execution_budget(registers, execution_budget_batch_size);
+}
+
+void release_execution_budget(asIScriptContext* context)
+{
+	delete static_cast<ExecutionBudget*>(context->GetUserData(budget_userdata_identifier));
+}
+
+asSVMRegisters* enter_native_call(NativeCallState* state, NativeCallFrame* frame, asCScriptFunction* function)
+{
+	auto* context    = static_cast<asCContext*>(state->context);
+	state->exception = nullptr;
+
+	if (context == nullptr || context->GetEngine() != function->GetEngine()
+		|| context->m_status == asEXECUTION_ACTIVE || context->m_status == asEXECUTION_SUSPENDED)
+	{
+		state->status = asEXECUTION_ERROR;
+		return nullptr;
+	}
+
+	// Nested executions, e.g. of functions left to the VM, push their state onto the stack of the context, which a
+	// context that never executed anything does not have yet
+	if (context->m_stackBlocks.GetLength() == 0 && !context->ReserveStackSpace(0))
+	{
+		state->status = asEXECUTION_ERROR;
+		return nullptr;
+	}
+
+	*frame = {
+		context->m_status,
+		context->m_currentFunction,
+		context->m_callingSystemFunction,
+		context->m_regs.programPointer};
+
+	// Look like an execution of the function to the runtime, to system functions and to nested executions
+	context->m_status                = asEXECUTION_ACTIVE;
+	context->m_currentFunction       = function;
+	context->m_callingSystemFunction = nullptr;
+	context->m_regs.programPointer   = function->scriptData->byteCode.AddressOf();
+	context->m_regs.doProcessSuspend = context->m_lineCallback;
+	asCThreadManager::GetLocalData()->activeContexts.PushLast(context);
+
+	return &context->m_regs;
+}
+
+void leave_native_call(NativeCallState* state, NativeCallFrame* frame, VmState vm_state)
+{
+	auto* context = static_cast<asCContext*>(state->context);
+
+	switch (vm_state)
+	{
+	case VmState::Ok: state->status = asEXECUTION_FINISHED; break;
+	case VmState::Aborted: state->status = asEXECUTION_ABORTED; break;
+	default:
+	{
+		// Exceptions raised by JIT'd code are not known to the context yet, see catch_exception()
+		set_internal_exception(vm_state);
+		state->status    = asEXECUTION_EXCEPTION;
+		state->exception = context->m_exceptionString.AddressOf();
+		break;
+	}
+	}
+
+	asCThreadManager::GetLocalData()->activeContexts.PopLast();
+
+	// The context is left as it was, so that it does not unwind a stack frame that never existed when prepared again
+	context->m_status                = frame->status;
+	context->m_currentFunction       = frame->current_function;
+	context->m_callingSystemFunction = frame->calling_system_function;
+	context->m_regs.programPointer   = frame->program_pointer;
+	context->m_doAbort               = false;
+	context->m_doSuspend             = false;
+	context->m_regs.doProcessSuspend = context->m_lineCallback;
+}
 } // namespace asllvm::detail::runtime
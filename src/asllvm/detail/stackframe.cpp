@@ -78,7 +78,9 @@ llvm::Value* StackFrame::load(StackFrame::AsStackOffset offset, llvm::Type* type
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 
-	return ir.CreateLoad(type, pointer_to(offset, type), fmt::format("local@{}.value", offset));
+	llvm::LoadInst* load = ir.CreateLoad(type, pointer_to(offset, type), fmt::format("local@{}.value", offset));
+	load->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().stack);
+	return load;
 }
 
 void StackFrame::store(StackFrame::AsStackOffset offset, llvm::Value* value)
@@ -86,7 +88,8 @@ void StackFrame::store(StackFrame::AsStackOffset offset, llvm::Value* value)
 	Builder&           builder = m_context.compiler->builder();
 	llvm::IRBuilder<>& ir      = builder.ir();
 
-	ir.CreateStore(value, pointer_to(offset, value->getType()));
+	llvm::StoreInst* store = ir.CreateStore(value, pointer_to(offset, value->getType()));
+	store->setMetadata(llvm::LLVMContext::MD_tbaa, builder.tbaa().stack);
 }
 
 llvm::Value* StackFrame::pointer_to(StackFrame::AsStackOffset offset, llvm::Type* pointee_type)
@@ -126,6 +129,8 @@ llvm::Value* StackFrame::pointer_to(StackFrame::AsStackOffset offset)
 
 llvm::AllocaInst* StackFrame::storage_alloca() { return m_storage; }
 
+const std::map<StackFrame::AsStackOffset, Parameter>& StackFrame::parameters() const { return m_parameters; }
+
 void StackFrame::allocate_parameter_storage()
 {
 	Builder&           builder = m_context.compiler->builder();
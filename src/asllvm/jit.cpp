@@ -16,4 +16,26 @@ int JitInterface::CompileFunction(asIScriptFunction* function, asJITFunction* ou
 void JitInterface::ReleaseJITFunction(asJITFunction func) { return m_compiler->jit_free(func); }
 
 void JitInterface::BuildModules() { m_compiler->build_modules(); }
+
+int JitInterface::SetSystemFunctionBitcode(
+	asIScriptFunction* function, const char* symbol, const void* bitcode, std::size_t size)
+{
+	return m_compiler->set_system_function_bitcode(function, symbol, bitcode, size);
+}
+
+int JitInterface::SetMathIntrinsic(asIScriptFunction* function, MathIntrinsic intrinsic)
+{
+	return m_compiler->set_math_intrinsic(function, intrinsic);
+}
+
+int JitInterface::RecompileModule(asIScriptModule* module) { return m_compiler->recompile_module(module); }
+
+int JitInterface::SetExecutionBudget(asIScriptContext* context, asQWORD iterations, std::chrono::nanoseconds time_limit)
+{
+	return m_compiler->set_execution_budget(context, iterations, time_limit);
+}
+
+void* JitInterface::GetNativeEntry(asIScriptFunction* function) { return m_compiler->get_native_entry(function); }
+
+void* JitInterface::GetBatchEntry(asIScriptFunction* function) { return m_compiler->get_batch_entry(function); }
 } // namespace asllvm
@@ -21,6 +21,27 @@ TEST_REQUIRE(
 	"[array][factory]",
 	run("scripts/arrays/initializationlists.as") == "123\n456\n789\nhello\nhi\n123\n");
 
+TEST_CASE("array and string intrinsics", "[array][str]")
+{
+	asllvm::JitConfig config      = default_jit_config();
+	config.allow_addon_intrinsics = true;
+
+	EngineContext context(config);
+	REQUIRE(run(context, "scripts/arrays/intrinsics.as") == "24\nnonempty\nempty\nhello\nAbc\n3\n");
+}
+
+TEST_CASE("implicit null checks", "[array][nullchecks]")
+{
+	asllvm::JitConfig config        = default_jit_config();
+	config.allow_llvm_optimizations = true;
+	config.allow_addon_intrinsics   = true;
+	config.use_implicit_null_checks = true;
+
+	EngineContext context(config);
+	REQUIRE(run_string_exception(context, "array<int>@ a = null; print(a.length())") == "Null pointer access");
+	REQUIRE(run_string(context, "array<int>@ a = {1, 2, 3}; print(a.length())") == "3\n");
+}
+
 TEST_CASE("user classes", "[userclass][simpleuserclass]")
 {
 	REQUIRE(run("scripts/userclasses.as", "void test()") == "hello\n");
@@ -37,13 +58,167 @@ TEST_CASE("user classes", "[userclass][simpleuserclass]")
 		== "hello\nhello\n10\n20\n30\n40\n50\n60\n70\n80\n90\n100\n");
 }
 
+TEST_CASE("redundant null checks", "[userclass][nullchecks]")
+{
+	asllvm::JitConfig config        = default_jit_config();
+	config.allow_llvm_optimizations = true;
+
+	EngineContext context(config);
+	REQUIRE(run(context, "scripts/nullchecks.as") == "30\n");
+}
+
 TEST_CASE("user class Vec3f", "[userclass][vec3f]")
 {
 	REQUIRE(run("scripts/vec3f.as") == "150\nx: -50; y: 100; z: -50\nx: 10; y: 7.5; z: 5\n");
 }
 
+TEST_CASE("interface method calls", "[userclass][interfaces]")
+{
+	REQUIRE(run("scripts/interfaces.as") == "90\n32\nsquare\n");
+}
+
+TEST_CASE("interface method calls and casts to discarded modules", "[userclass][interfaces][casts]")
+{
+	EngineContext context(default_jit_config());
+
+	asIScriptModule& host = context.build("host", "scripts/shared/host.as");
+
+	const auto call = [&](asIScriptFunction* function, void* object) {
+		asIScriptContext* script_context = context.engine->CreateContext();
+		asllvm_test_check(script_context->Prepare(function) >= 0);
+		if (object != nullptr)
+		{
+			asllvm_test_check(script_context->SetArgObject(0, object) >= 0);
+		}
+		asllvm_test_check(script_context->Execute() == asEXECUTION_FINISHED);
+		return script_context;
+	};
+
+	const auto measure = [&](const char* make_decl, const char* measure_decl) -> int {
+		context.prepare_execution();
+
+		asIScriptModule&  shapes       = *context.engine->GetModule("shapes");
+		asIScriptContext* make_context = call(shapes.GetFunctionByDecl(make_decl), nullptr);
+		void*             object       = make_context->GetReturnObject();
+
+		asIScriptContext* measure_context = call(host.GetFunctionByDecl(measure_decl), object);
+		const int         result          = int(measure_context->GetReturnDWord());
+
+		measure_context->Release();
+		make_context->Release();
+		return result;
+	};
+
+	context.build("shapes", "scripts/shared/square.as");
+	REQUIRE(measure("Shape@ make()", "int measure(Shape@)") == 9);
+	REQUIRE(measure("Item@ make_item()", "int measure_item(Item@)") == 9);
+
+	// New classes may be allocated where the discarded ones were, which call site and cast caches must not mistake
+	context.engine->DiscardModule("shapes");
+	context.engine->GarbageCollect();
+
+	context.build("shapes", "scripts/shared/rectangle.as");
+	REQUIRE(measure("Shape@ make()", "int measure(Shape@)") == 12);
+	REQUIRE(measure("Item@ make_item()", "int measure_item(Item@)") == -1);
+}
+
+TEST_CASE("handle casts", "[userclass][casts]") { REQUIRE(run("scripts/casts.as") == "30\n10\n30\n90\n"); }
+
 TEST_CASE("devirtualization", "[devirt]") { REQUIRE(run("scripts/devirt.as") == "hello\n"); }
 
+TEST_CASE("profile-guided recompilation", "[devirt][pgo]")
+{
+	asllvm::JitConfig config        = default_jit_config();
+	config.allow_llvm_optimizations = true;
+	config.instrument_for_profile   = true;
+
+	EngineContext    context(config);
+	asIScriptModule& module = context.build("build", "scripts/profile.as");
+
+	out = {};
+	context.run(module, "void main()");
+	REQUIRE(out.str() == "340\n");
+
+	messages.clear();
+	REQUIRE(context.jit.RecompileModule(&module) == asSUCCESS);
+	REQUIRE(has_message("promoting virtual call to int Shape::area() at offset"));
+	REQUIRE(has_message("to int Square::area()"));
+
+	out = {};
+	context.run(module, "void main()");
+	REQUIRE(out.str() == "340\n");
+}
+
+TEST_CASE("profile-guided recompilation after discarding a module", "[devirt][pgo]")
+{
+	asllvm::JitConfig config        = default_jit_config();
+	config.allow_llvm_optimizations = true;
+	config.instrument_for_profile   = true;
+
+	EngineContext context(config);
+	context.run(context.build("build", "scripts/profile.as"), "void main()");
+
+	// Functions of the new module may reuse the IDs of discarded ones, but must not inherit their profiles
+	context.engine->DiscardModule("build");
+	context.engine->GarbageCollect();
+	asIScriptModule& module = context.build("build", "scripts/deoptimize.as");
+
+	out = {};
+	context.run(module, "void main()");
+	REQUIRE(out.str() == "135\n");
+
+	REQUIRE(context.jit.RecompileModule(&module) == asSUCCESS);
+
+	out = {};
+	context.run(module, "void main()");
+	REQUIRE(out.str() == "135\n");
+}
+
+TEST_CASE("deoptimization", "[devirt][pgo][deopt]")
+{
+	asllvm::JitConfig config        = default_jit_config();
+	config.allow_llvm_optimizations = true;
+	config.instrument_for_profile   = true;
+
+	EngineContext    context(config);
+	asIScriptModule& module = context.build("build", "scripts/deoptimize.as");
+
+	out = {};
+	context.run(module, "void main()");
+	context.run(module, "void main_tracked()");
+	REQUIRE(out.str() == "135\nreleased\n180\n");
+
+	// Each of the three call sites only saw Square::area so far
+	messages.clear();
+	REQUIRE(context.jit.RecompileModule(&module) == asSUCCESS);
+	REQUIRE(count_messages("promoting virtual call") == 3);
+	REQUIRE(count_messages("leaving other receivers to the VM") == 3);
+
+	out = {};
+	context.run(module, "void main()");
+	context.run(module, "void main_tracked()");
+	REQUIRE(out.str() == "135\nreleased\n180\n");
+
+	// The loops are resumed in the VM from the first Circle::area call, which releases the objects of the frames
+	context.run(module, "void use_circle()");
+
+	out = {};
+	context.run(module, "void main()");
+	context.run(module, "void main_tracked()");
+	REQUIRE(out.str() == "105\nreleased\n150\n");
+
+	// Call sites that deoptimized are now guarded instead, while the call on `held` still speculates
+	messages.clear();
+	REQUIRE(context.jit.RecompileModule(&module) == asSUCCESS);
+	REQUIRE(count_messages("promoting virtual call") == 3);
+	REQUIRE(count_messages("leaving other receivers to the VM") == 1);
+
+	out = {};
+	context.run(module, "void main()");
+	context.run(module, "void main_tracked()");
+	REQUIRE(out.str() == "105\nreleased\n150\n");
+}
+
 TEST_CASE("virtual system functions", "[sysvirt]")
 {
 	class Base
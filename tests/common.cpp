@@ -2,6 +2,7 @@
 
 //#define DEBUG_DISABLE_JIT
 
+#include <algorithm>
 #include <iostream>
 #include <scriptarray/scriptarray.h>
 #include <scriptbuilder/scriptbuilder.h>
@@ -10,6 +11,17 @@
 
 std::stringstream out;
 
+std::vector<std::string> messages;
+
+bool has_message(std::string_view text) { return count_messages(text) != 0; }
+
+std::size_t count_messages(std::string_view text)
+{
+	return std::size_t(std::count_if(messages.begin(), messages.end(), [&](const std::string& message) {
+		return message.find(text) != std::string::npos;
+	}));
+}
+
 namespace bindings
 {
 void message_callback(const asSMessageInfo* info, [[maybe_unused]] void* param)
@@ -37,6 +49,8 @@ void message_callback(const asSMessageInfo* info, [[maybe_unused]] void* param)
 	}
 	}
 
+	messages.emplace_back(info->message);
+
 	std::cerr << info->section << ':' << info->row << ':' << info->col << ": " << message_type << ": " << info->message
 			  << '\n';
 }
@@ -150,3 +164,37 @@ std::string run_string(EngineContext& context, const char* str)
 
 	return out.str();
 }
+
+std::string run_string_exception(const char* str)
+{
+	EngineContext context(default_jit_config());
+	return run_string_exception(context, str);
+}
+
+std::string run_string_exception(EngineContext& context, const char* str)
+{
+	out = {};
+
+	CScriptBuilder builder;
+	builder.StartNewModule(context.engine, "build");
+	builder.AddSectionFromMemory("str", (std::string("void main() {") + str + ";}").c_str());
+	builder.BuildModule();
+
+	context.prepare_execution();
+
+	asIScriptFunction* function = context.engine->GetModule("build")->GetFunctionByDecl("void main()");
+	asllvm_test_check(function != nullptr);
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+	asllvm_test_check(script_context->Prepare(function) >= 0);
+
+	std::string exception;
+	if (script_context->Execute() == asEXECUTION_EXCEPTION)
+	{
+		exception = script_context->GetExceptionString();
+	}
+
+	script_context->Release();
+
+	return exception;
+}
@@ -8,6 +8,8 @@
 #include <catch2/catch.hpp>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #define TEST_REQUIRE(name, tag, cond)                                                                                  \
 	TEST_CASE(name, tag) { REQUIRE(cond); }
@@ -21,6 +23,15 @@
 
 extern std::stringstream out;
 
+//! \brief Messages written to the engine message callback, including the diagnostics of a verbose JIT.
+extern std::vector<std::string> messages;
+
+//! \brief Whether any of \ref messages contains \p text.
+bool has_message(std::string_view text);
+
+//! \brief Number of \ref messages containing \p text.
+std::size_t count_messages(std::string_view text);
+
 struct EngineContext
 {
 	EngineContext(asllvm::JitConfig config);
@@ -45,3 +56,8 @@ std::string run(const char* path, const char* entry = "void main()");
 std::string run(EngineContext& context, const char* path, const char* entry = "void main()");
 std::string run_string(const char* str);
 std::string run_string(EngineContext& context, const char* str);
+
+//! \brief Run \p str like run_string(), expecting it to raise a script exception.
+//! \returns The exception string, or an empty string if no exception was raised.
+std::string run_string_exception(const char* str);
+std::string run_string_exception(EngineContext& context, const char* str);
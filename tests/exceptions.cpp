@@ -0,0 +1,54 @@
+#include "common.hpp"
+
+TEST_CASE("try catch", "[exceptions]")
+{
+	REQUIRE(
+		run("scripts/trycatch.as")
+		== "released inner\n"
+		   "caught division\n"
+		   "caught null access\n"
+		   "released callee\n"
+		   "caught from callee\n"
+		   "released callee\n"
+		   "released nested\n"
+		   "caught inner\n"
+		   "caught outer\n"
+		   "done\n"
+		   "released outer\n");
+
+	// Objects are released before the exception leaves the function
+	REQUIRE(run_string_exception("array<int> a = {1, 2}; int b = 0; print(a[0] / b)") == "Divide by zero");
+}
+
+TEST_CASE("uncaught exceptions", "[exceptions]")
+{
+	EngineContext    context(default_jit_config());
+	asIScriptModule& module = context.build("build", "scripts/trycatch.as");
+	context.prepare_execution();
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+	asllvm_test_check(script_context->Prepare(module.GetFunctionByDecl("void main_uncaught()")) >= 0);
+
+	out = {};
+	REQUIRE(script_context->Execute() == asEXECUTION_EXCEPTION);
+
+	// Released by the JIT'd code while unwinding, rather than by the context when it is released
+	REQUIRE(out.str() == "released uncaught\n");
+
+	script_context->Release();
+}
+
+TEST_CASE("funcdef handles when unwinding", "[exceptions]")
+{
+	EngineContext context(default_jit_config());
+	run(context, "scripts/trycatch.as", "void main_callback()");
+
+	// Delegates may be left to the garbage collector, which can only destroy them once their handles are released
+	context.engine->GarbageCollect();
+
+	const std::string output = out.str();
+	REQUIRE(output.find("reported delegated\n") == 0);
+	REQUIRE(output.find("caught callback\n") != std::string::npos);
+	REQUIRE(output.find("released delegated\n") != std::string::npos);
+	REQUIRE(output.find("released delegated callee\n") != std::string::npos);
+}
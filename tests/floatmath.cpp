@@ -1,5 +1,18 @@
 #include "common.hpp"
 
+#include <math.h>
+
+namespace
+{
+int max_wrapper_calls = 0;
+
+int max_wrapper(int a, int b)
+{
+	++max_wrapper_calls;
+	return a > b ? a : b;
+}
+} // namespace
+
 TEST_CASE("32-bit float math", "[floatmath32]")
 {
 	REQUIRE(run_string("float a = 3.141f; print(''+a);") == "3.141\n");
@@ -72,3 +85,36 @@ TEST_CASE("Floating-point <-> integral conversions", "[castfpint]")
 	REQUIRE(run_string("int64 a = -123; print(''+double(a))") == "-123\n");
 	REQUIRE(run_string("uint64 a = 123; print(''+double(a))") == "123\n");
 }
+
+TEST_CASE("math intrinsics", "[floatmath][intrinsics]")
+{
+	EngineContext context(default_jit_config());
+
+	asllvm_test_check(
+		context.engine->RegisterGlobalFunction("float sqrt(float)", asFUNCTIONPR(sqrtf, (float), float), asCALL_CDECL)
+		>= 0);
+	asllvm_test_check(
+		context.engine->RegisterGlobalFunction(
+			"double floor(double)", asFUNCTIONPR(floor, (double), double), asCALL_CDECL)
+		>= 0);
+
+	const int max_id
+		= context.engine->RegisterGlobalFunction("int max(int, int)", asFUNCTION(max_wrapper), asCALL_CDECL);
+	asllvm_test_check(max_id >= 0);
+	asIScriptFunction* max_function = context.engine->GetFunctionById(max_id);
+	REQUIRE(context.jit.SetMathIntrinsic(max_function, asllvm::MathIntrinsic::Max) == asSUCCESS);
+
+	REQUIRE(run_string(context, "print(''+sqrt(16.0f))") == "4\n");
+	REQUIRE(run_string(context, "print(''+floor(-2.5))") == "-3\n");
+
+	max_wrapper_calls = 0;
+	REQUIRE(run_string(context, "print(max(-5, 3))") == "3\n");
+	REQUIRE(max_wrapper_calls == 0);
+}
+
+TEST_CASE("floating-point exponentiation", "[pow]")
+{
+	REQUIRE(run_string("float a = 2.0f, b = 10.0f; print(''+(a ** b))") == "1024\n");
+	REQUIRE(run_string("double a = 4.0, b = 0.5; print(''+(a ** b))") == "2\n");
+	REQUIRE(run_string("double a = 1.5; int b = 2; print(''+(a ** b))") == "2.25\n");
+}
@@ -1,8 +1,71 @@
 #include "common.hpp"
-/*
+
 TEST_CASE("function pointer calls", "[funcdef]")
 {
 	REQUIRE(run("scripts/funcdefs.as", "void test_system()") == "hello\n");
 	REQUIRE(run("scripts/funcdefs.as", "void test_script()") == "hello\n");
+	REQUIRE(run("scripts/funcdefs.as", "void test_callbacks()") == "5050\n3628800\n55\n55\n");
+}
+
+TEST_CASE("function pointer calls to discarded modules", "[funcdef]")
+{
+	// Once recompiled with a profile, the call is promoted to a direct call guarded by the address of the function
+	const bool is_profiled = GENERATE(false, true);
+
+	asllvm::JitConfig config      = default_jit_config();
+	config.instrument_for_profile = is_profiled;
+
+	EngineContext context(config);
+	asllvm_test_check(context.engine->RegisterFuncdef("int BINARY_OP(int, int)") >= 0);
+
+	asIScriptModule& host = context.build("host", "scripts/funcdefs/apply.as");
+	context.prepare_execution();
+
+	asIScriptFunction* apply = host.GetFunctionByDecl("int apply(BINARY_OP@, int, int)");
+	asllvm_test_check(apply != nullptr);
+
+	const auto run_apply = [&](const char* module_name) -> int {
+		asIScriptFunction* op = context.engine->GetModule(module_name)->GetFunctionByDecl("int op(int, int)");
+		asllvm_test_check(op != nullptr);
+
+		asIScriptContext* script_context = context.engine->CreateContext();
+		asllvm_test_check(script_context->Prepare(apply) >= 0);
+		asllvm_test_check(script_context->SetArgObject(0, op) >= 0);
+		asllvm_test_check(script_context->SetArgDWord(1, 6) >= 0);
+		asllvm_test_check(script_context->SetArgDWord(2, 7) >= 0);
+		asllvm_test_check(script_context->Execute() == asEXECUTION_FINISHED);
+
+		const int result = int(script_context->GetReturnDWord());
+		script_context->Release();
+		return result;
+	};
+
+	context.build("ops", "scripts/funcdefs/add.as");
+	context.prepare_execution();
+	REQUIRE(run_apply("ops") == 13);
+
+	if (is_profiled)
+	{
+		messages.clear();
+		REQUIRE(context.jit.RecompileModule(&host) == asSUCCESS);
+		REQUIRE(has_message("promoting function pointer call at offset"));
+		REQUIRE(run_apply("ops") == 13);
+	}
+
+	// The new function may be allocated where the discarded one was, which the call site cache must not mistake
+	context.engine->DiscardModule("ops");
+	context.engine->GarbageCollect();
+	context.build("ops", "scripts/funcdefs/mul.as");
+
+	SECTION("before building the module")
+	{
+		// The function is called through the VM, as it has no JIT'd code yet
+		REQUIRE(run_apply("ops") == 42);
+	}
+
+	SECTION("after building the module")
+	{
+		context.prepare_execution();
+		REQUIRE(run_apply("ops") == 42);
+	}
 }
-*/
@@ -1,5 +1,53 @@
 #include "common.hpp"
 
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace
+{
+int native_add_calls = 0;
+
+int native_add(int a, int b)
+{
+	++native_add_calls;
+	return a + b;
+}
+
+//! \brief
+//!		Build the bitcode an application would get from compiling `native_add` with clang, counting calls in a
+//!		`static` variable of its own if \p count_calls is set.
+std::string make_add_bitcode(bool count_calls = false)
+{
+	llvm::LLVMContext context;
+	llvm::Module      module{"bitcode", context};
+	llvm::Type*       i32 = llvm::Type::getInt32Ty(context);
+
+	llvm::Function* function = llvm::Function::Create(
+		llvm::FunctionType::get(i32, {i32, i32}, false), llvm::Function::ExternalLinkage, "add_impl", module);
+
+	llvm::IRBuilder<> ir{llvm::BasicBlock::Create(context, "entry", function)};
+
+	if (count_calls)
+	{
+		auto* calls = new llvm::GlobalVariable(
+			module, i32, false, llvm::GlobalValue::InternalLinkage, llvm::ConstantInt::get(i32, 0), "calls");
+		ir.CreateStore(ir.CreateAdd(ir.CreateLoad(i32, calls), ir.getInt32(1)), calls);
+	}
+
+	ir.CreateRet(ir.CreateAdd(function->getArg(0), function->getArg(1)));
+
+	std::string              bitcode;
+	llvm::raw_string_ostream stream{bitcode};
+	llvm::WriteBitcodeToFile(module, stream);
+	stream.flush();
+
+	return bitcode;
+}
+} // namespace
+
 TEST_CASE("simple parameterized function", "[params]") { REQUIRE(run("scripts/functions.as") == "10000\n"); }
 
 TEST_CASE("references to primitives in parameters", "[refparams]")
@@ -7,6 +55,11 @@ TEST_CASE("references to primitives in parameters", "[refparams]")
 	REQUIRE(run("scripts/refprimitives.as") == "10\n");
 }
 
+TEST_CASE("functions left to the VM", "[fallback]")
+{
+	REQUIRE(run("scripts/fallback.as") == "42\n3\ncaught\n");
+}
+
 TEST_CASE("shared functions", "[shared][sharedfuncs]")
 {
 	EngineContext context(default_jit_config());
@@ -33,3 +86,127 @@ TEST_CASE("shared functions", "[shared][sharedfuncs]")
 
 	REQUIRE(out.str() == "10\n10\n");
 }
+
+TEST_CASE("system functions implemented by bitcode", "[bitcode]")
+{
+	EngineContext context(default_jit_config());
+
+	const int id
+		= context.engine->RegisterGlobalFunction("int native_add(int, int)", asFUNCTION(native_add), asCALL_CDECL);
+	asllvm_test_check(id >= 0);
+
+	const std::string bitcode = make_add_bitcode();
+	REQUIRE(
+		context.jit.SetSystemFunctionBitcode(
+			context.engine->GetFunctionById(id), "add_impl", bitcode.data(), bitcode.size())
+		== asSUCCESS);
+
+	native_add_calls = 0;
+	REQUIRE(run_string(context, "print(native_add(20, 22))") == "42\n");
+	REQUIRE(native_add_calls == 0);
+}
+
+TEST_CASE("system function bitcode with private state", "[bitcode]")
+{
+	EngineContext context(default_jit_config());
+
+	const int id
+		= context.engine->RegisterGlobalFunction("int native_add(int, int)", asFUNCTION(native_add), asCALL_CDECL);
+	asllvm_test_check(id >= 0);
+
+	const std::string bitcode = make_add_bitcode(true);
+	REQUIRE(
+		context.jit.SetSystemFunctionBitcode(
+			context.engine->GetFunctionById(id), "add_impl", bitcode.data(), bitcode.size())
+		== asSUCCESS);
+
+	// Every module would get its own copy of the counter, so the application function is called instead
+	messages.clear();
+	native_add_calls = 0;
+	REQUIRE(run_string(context, "print(native_add(20, 22))") == "42\n");
+	REQUIRE(native_add_calls == 1);
+	REQUIRE(has_message("private mutable global calls"));
+}
+
+TEST_CASE("imported functions", "[imports]")
+{
+	EngineContext context(default_jit_config());
+
+	out = {};
+
+	asIScriptModule& library = context.build("lib", "scripts/importlib.as");
+	asIScriptModule& module  = context.build("main", "scripts/imports.as");
+
+	// Bound before building, so calls to the import are direct
+	REQUIRE(module.BindImportedFunction(0, library.GetFunctionByDecl("int square(int)")) >= 0);
+
+	context.prepare_execution();
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+
+	const auto run = [&] {
+		asllvm_test_check(script_context->Prepare(module.GetFunctionByDecl("void main()")) >= 0);
+		return script_context->Execute();
+	};
+
+	REQUIRE(run() == asEXECUTION_FINISHED);
+
+	REQUIRE(module.BindImportedFunction(0, library.GetFunctionByDecl("int cube(int)")) >= 0);
+	REQUIRE(run() == asEXECUTION_FINISHED);
+
+	REQUIRE(out.str() == "385\n3025\n");
+
+	REQUIRE(module.UnbindAllImportedFunctions() >= 0);
+	REQUIRE(run() == asEXECUTION_EXCEPTION);
+	REQUIRE(std::string(script_context->GetExceptionString()) == "Unbound function called");
+
+	script_context->Release();
+}
+
+TEST_CASE("imported functions rebound to discarded modules", "[imports]")
+{
+	EngineContext context(default_jit_config());
+
+	out = {};
+
+	asIScriptModule& library = context.build("lib", "scripts/importlib.as");
+	asIScriptModule& module  = context.build("main", "scripts/imports.as");
+
+	asIScriptFunction* square    = library.GetFunctionByDecl("int square(int)");
+	const int          square_id = square->GetId();
+	REQUIRE(module.BindImportedFunction(0, square) >= 0);
+
+	context.prepare_execution();
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+
+	const auto run = [&] {
+		asllvm_test_check(script_context->Prepare(module.GetFunctionByDecl("void main()")) >= 0);
+		return script_context->Execute();
+	};
+
+	REQUIRE(run() == asEXECUTION_FINISHED);
+
+	REQUIRE(module.UnbindAllImportedFunctions() >= 0);
+	context.engine->DiscardModule("lib");
+	context.engine->GarbageCollect();
+
+	// Both functions compute the same, so bind whichever reuses the ID of the discarded function the call was built for
+	asIScriptModule&   rebuilt = context.build("lib", "scripts/importlib_negated.as");
+	asIScriptFunction* target  = rebuilt.GetFunctionByDecl("int negate(int)");
+	for (asUINT i = 0; i < rebuilt.GetFunctionCount(); ++i)
+	{
+		if (rebuilt.GetFunctionByIndex(i)->GetId() == square_id)
+		{
+			target = rebuilt.GetFunctionByIndex(i);
+		}
+	}
+
+	context.prepare_execution();
+	REQUIRE(module.BindImportedFunction(0, target) >= 0);
+
+	REQUIRE(run() == asEXECUTION_FINISHED);
+	REQUIRE(out.str() == "385\n-55\n");
+
+	script_context->Release();
+}
@@ -3,4 +3,39 @@
 TEST_CASE("globals", "[globals]")
 {
 	REQUIRE(run("scripts/globals.as", "void assign_read()") == "123\n123\n123\n123\n");
+	REQUIRE(run("scripts/globals.as", "void read_const()") == "42\n");
+}
+
+TEST_CASE("constant globals", "[globals]")
+{
+	EngineContext context(default_jit_config());
+
+	int answer_offset = 0;
+	asllvm_test_check(context.engine->RegisterGlobalProperty("int answer_offset", &answer_offset) >= 0);
+
+	out                     = {};
+	asIScriptModule& module = context.build("build", "scripts/constglobals.as");
+	context.run(module, "void main()");
+	REQUIRE(out.str() == "42\n42\n");
+
+	// Resetting runs the initializer of answer again, so it must be read rather than folded
+	answer_offset = 1;
+	REQUIRE(module.ResetGlobalVars() >= 0);
+
+	// Clobbering the storage of literal_answer is not observed, as its value is folded
+	*static_cast<int*>(module.GetAddressOfGlobalVar(module.GetGlobalVarIndexByName("literal_answer"))) = 0;
+
+	out = {};
+	context.run(module, "void main()");
+	REQUIRE(out.str() == "43\n42\n");
+}
+
+TEST_CASE("globals promoted across system calls", "[globals]")
+{
+	asllvm::JitConfig config                             = default_jit_config();
+	config.allow_llvm_optimizations                      = true;
+	config.assume_system_calls_dont_touch_script_globals = true;
+
+	EngineContext context(config);
+	REQUIRE(run(context, "scripts/globals.as", "void accumulate()") == "..........45\n");
 }
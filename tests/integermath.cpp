@@ -99,3 +99,38 @@ TEST_CASE("64-bit bitwise logic", "[bitwise64]")
 	REQUIRE(run_string("int64 a = -4354352, b = 2; print(a >>> b)") == "-1088588\n");
 	REQUIRE(run_string("int64 a = 0xF0F0F0F0F0F0F0F0; print(~a)") == "1085102592571150095\n");
 }
+
+TEST_CASE("integer exponentiation", "[pow]")
+{
+	REQUIRE(run_string("int a = 3, b = 4; print(a ** b)") == "81\n");
+	REQUIRE(run_string("int a = -2, b = 3; print(a ** b)") == "-8\n");
+	REQUIRE(run_string("int a = 7; print(a ** 2)") == "49\n");
+	REQUIRE(run_string("int a = 5, b = 0; print(a ** b)") == "1\n");
+	REQUIRE(run_string("int a = 2, b = -1; print(a ** b)") == "0\n");
+	REQUIRE(run_string("int a = -1, b = 101; print(a ** b)") == "-1\n");
+	REQUIRE(run_string("uint a = 2, b = 31; print(a ** b)") == "2147483648\n");
+	REQUIRE(run_string("int64 a = 3, b = 39; print(a ** b)") == "4052555153018976267\n");
+	REQUIRE(run_string("uint64 a = 2, b = 63; print(a ** b)") == "9223372036854775808\n");
+	REQUIRE(run_string("int a = -2147483647 - 1, b = 1; print(a ** b)") == "-2147483648\n");
+}
+
+TEST_CASE("integer exponentiation exceptions", "[pow]")
+{
+	// Like the VM, results are bounded by the maximum value, even when the minimum value would be exact
+	REQUIRE(run_string_exception("int a = -2, b = 31; print(a ** b)") == "Overflow in exponent operation");
+	REQUIRE(run_string_exception("int64 a = -2, b = 63; print(a ** b)") == "Overflow in exponent operation");
+	REQUIRE(run_string_exception("int64 a = -8, b = 21; print(a ** b)") == "Overflow in exponent operation");
+	REQUIRE(run_string_exception("int a = 2, b = 31; print(a ** b)") == "Overflow in exponent operation");
+	REQUIRE(run_string_exception("int a = 0, b = 0; print(a ** b)") == "Overflow in exponent operation");
+	REQUIRE(run_string_exception("int a = -2, b = 30; print(a ** b)") == "");
+}
+
+TEST_CASE("division exceptions", "[divexceptions]")
+{
+	REQUIRE(run_string_exception("int a = 10, b = 0; print(a / b)") == "Divide by zero");
+	REQUIRE(run_string_exception("int a = 10, b = 0; print(a % b)") == "Divide by zero");
+	REQUIRE(run_string_exception("uint64 a = 10, b = 0; print(a / b)") == "Divide by zero");
+	REQUIRE(run_string_exception("double a = 10, b = 0; print(''+(a / b))") == "Divide by zero");
+	REQUIRE(run_string_exception("int a = -2147483647 - 1, b = -1; print(a / b)") == "Overflow in integer division");
+	REQUIRE(run_string_exception("int64 a = 10, b = -1; print(a / b)") == "");
+}
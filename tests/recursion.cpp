@@ -26,3 +26,243 @@ TEST_CASE("recursive fibonacci", "[fib]")
 	REQUIRE(run_fib(25) == 75025);
 	REQUIRE(run_fib(35) == 9227465);
 }
+
+TEST_CASE("tail calls", "[tailcalls]") { REQUIRE(run("scripts/tailcalls.as") == "2000000\nodd\n"); }
+
+TEST_CASE("native entry points", "[fib][native]")
+{
+	asllvm::JitConfig config       = default_jit_config();
+	config.generate_native_entries = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/native.as");
+	context.prepare_execution();
+
+	using FibEntry    = int(asllvm::NativeCallState*, int);
+	using DivideEntry = int(asllvm::NativeCallState*, int, int);
+
+	auto* fib    = context.jit.GetNativeEntry<FibEntry>(module.GetFunctionByDecl("int fib(int)"));
+	auto* divide = context.jit.GetNativeEntry<DivideEntry>(module.GetFunctionByDecl("int divide(int, int)"));
+	asllvm_test_check(fib != nullptr && divide != nullptr);
+
+	asllvm::NativeCallState state;
+	state.context = context.engine->CreateContext();
+
+	SECTION("result")
+	{
+		REQUIRE(fib(&state, 25) == 75025);
+		REQUIRE(state.status == asEXECUTION_FINISHED);
+		REQUIRE(state.context->GetState() == asEXECUTION_UNINITIALIZED);
+	}
+
+	SECTION("exception")
+	{
+		divide(&state, 1, 0);
+		REQUIRE(state.status == asEXECUTION_EXCEPTION);
+		REQUIRE(std::string(state.exception) == "Divide by zero");
+
+		REQUIRE(divide(&state, 10, 2) == 5);
+		REQUIRE(state.status == asEXECUTION_FINISHED);
+		REQUIRE(state.exception == nullptr);
+	}
+
+	SECTION("no context")
+	{
+		state.context->Release();
+		state.context = nullptr;
+
+		fib(&state, 10);
+		REQUIRE(state.status == asEXECUTION_ERROR);
+	}
+
+	if (state.context != nullptr)
+	{
+		state.context->Release();
+	}
+}
+
+TEST_CASE("batch entry points", "[native]")
+{
+	asllvm::JitConfig config       = default_jit_config();
+	config.generate_native_entries = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/native.as");
+	context.prepare_execution();
+
+	struct DivideArguments
+	{
+		int a, b;
+	};
+
+	using DivideBatch = asUINT(asllvm::NativeCallState*, const DivideArguments*, int*, asUINT);
+
+	auto* divide = context.jit.GetBatchEntry<DivideBatch>(module.GetFunctionByDecl("int divide(int, int)"));
+	asllvm_test_check(divide != nullptr);
+
+	asllvm::NativeCallState state;
+	state.context = context.engine->CreateContext();
+
+	SECTION("results")
+	{
+		const DivideArguments arguments[] = {{10, 2}, {9, 3}, {-8, 4}};
+		int                   results[3]  = {};
+
+		REQUIRE(divide(&state, arguments, results, 3) == 3);
+		REQUIRE(state.status == asEXECUTION_FINISHED);
+		REQUIRE(results[0] == 5);
+		REQUIRE(results[1] == 3);
+		REQUIRE(results[2] == -2);
+
+		REQUIRE(divide(&state, arguments, results, 0) == 0);
+		REQUIRE(state.status == asEXECUTION_FINISHED);
+	}
+
+	SECTION("exception")
+	{
+		const DivideArguments arguments[] = {{10, 2}, {9, 3}, {1, 0}, {4, 2}};
+		int                   results[4]  = {};
+
+		REQUIRE(divide(&state, arguments, results, 4) == 2);
+		REQUIRE(state.status == asEXECUTION_EXCEPTION);
+		REQUIRE(std::string(state.exception) == "Divide by zero");
+		REQUIRE(results[0] == 5);
+		REQUIRE(results[1] == 3);
+		REQUIRE(results[3] == 0);
+	}
+
+	state.context->Release();
+}
+
+TEST_CASE("native entry points of methods", "[native]")
+{
+	asllvm::JitConfig config       = default_jit_config();
+	config.generate_native_entries = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/native.as");
+	context.prepare_execution();
+
+	asITypeInfo*       counter_type = module.GetTypeInfoByName("Counter");
+	asIScriptFunction* add          = counter_type->GetMethodByDecl("int add(int)");
+
+	struct AddArguments
+	{
+		void* object;
+		int   amount;
+	};
+
+	using AddEntry = int(asllvm::NativeCallState*, void*, int);
+	using AddBatch = asUINT(asllvm::NativeCallState*, const AddArguments*, int*, asUINT);
+
+	auto* add_entry = context.jit.GetNativeEntry<AddEntry>(add);
+	auto* add_batch = context.jit.GetBatchEntry<AddBatch>(add);
+	asllvm_test_check(add_entry != nullptr && add_batch != nullptr);
+
+	auto* counter = static_cast<asIScriptObject*>(context.engine->CreateScriptObject(counter_type));
+
+	asllvm::NativeCallState state;
+	state.context = context.engine->CreateContext();
+
+	SECTION("native entry")
+	{
+		REQUIRE(add_entry(&state, counter, 3) == 3);
+		REQUIRE(state.status == asEXECUTION_FINISHED);
+
+		// Execute() raises an exception for a null object, rather than calling the method
+		add_entry(&state, nullptr, 3);
+		REQUIRE(state.status == asEXECUTION_EXCEPTION);
+		REQUIRE(std::string(state.exception) == "Null pointer access");
+		REQUIRE(state.context->GetState() == asEXECUTION_UNINITIALIZED);
+	}
+
+	SECTION("batch entry")
+	{
+		const AddArguments arguments[] = {{counter, 1}, {counter, 2}, {nullptr, 3}, {counter, 4}};
+		int                results[4]  = {};
+
+		REQUIRE(add_batch(&state, arguments, results, 4) == 2);
+		REQUIRE(state.status == asEXECUTION_EXCEPTION);
+		REQUIRE(std::string(state.exception) == "Null pointer access");
+		REQUIRE(results[0] == 1);
+		REQUIRE(results[1] == 3);
+		REQUIRE(results[3] == 0);
+	}
+
+	state.context->Release();
+	counter->Release();
+}
+
+TEST_CASE("native entry points of functions left to the VM", "[native][fallback]")
+{
+	asllvm::JitConfig config       = default_jit_config();
+	config.generate_native_entries = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/fallback.as");
+	context.prepare_execution();
+
+	using CountNullsEntry = int(asllvm::NativeCallState*, int);
+
+	// The return value is written by the VM, which must not write past the returned `int`
+	auto* count_nulls = context.jit.GetNativeEntry<CountNullsEntry>(module.GetFunctionByDecl("int count_nulls(int)"));
+	asllvm_test_check(count_nulls != nullptr);
+
+	asllvm::NativeCallState state;
+	state.context = context.engine->CreateContext();
+
+	REQUIRE(count_nulls(&state, 5) == 5);
+	REQUIRE(state.status == asEXECUTION_FINISHED);
+
+	REQUIRE(count_nulls(&state, 7) == 7);
+	REQUIRE(state.status == asEXECUTION_FINISHED);
+	REQUIRE(state.context->GetState() == asEXECUTION_UNINITIALIZED);
+
+	state.context->Release();
+}
+
+TEST_CASE("batch entry points of functions left to the VM", "[native][fallback]")
+{
+	asllvm::JitConfig config       = default_jit_config();
+	config.generate_native_entries = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/fallback.as");
+	context.prepare_execution();
+
+	using CountNullsBatch = asUINT(asllvm::NativeCallState*, const int*, int*, asUINT);
+
+	auto* count_nulls = context.jit.GetBatchEntry<CountNullsBatch>(module.GetFunctionByDecl("int count_nulls(int)"));
+	asllvm_test_check(count_nulls != nullptr);
+
+	asllvm::NativeCallState state;
+	state.context = context.engine->CreateContext();
+
+	// The results are written by the VM, which must not write past each element
+	const int arguments[] = {1, 2, 3};
+	int       results[4]  = {0, 0, 0, 1234};
+
+	REQUIRE(count_nulls(&state, arguments, results, 3) == 3);
+	REQUIRE(state.status == asEXECUTION_FINISHED);
+	REQUIRE(results[0] == 1);
+	REQUIRE(results[1] == 2);
+	REQUIRE(results[2] == 3);
+	REQUIRE(results[3] == 1234);
+
+	state.context->Release();
+}
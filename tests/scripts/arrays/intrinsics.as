@@ -0,0 +1,30 @@
+void main()
+{
+    int[] ints = {1, 2, 3};
+    ints[1] = 20;
+
+    int sum = 0;
+    for (uint i = 0; i < ints.length(); ++i)
+    {
+        sum += ints[i];
+    }
+    print(sum);
+
+    int[] empty;
+    if (!ints.isEmpty())
+    {
+        print("nonempty");
+    }
+    if (empty.isEmpty())
+    {
+        print("empty");
+    }
+
+    string[] strings = {"hello"};
+    print(strings[0]);
+
+    string s = "abc";
+    s[0] = 65;
+    print(s);
+    print(s.length());
+}
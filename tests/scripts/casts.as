@@ -0,0 +1,68 @@
+interface Updatable
+{
+    void update();
+}
+
+class Entity
+{
+    int id;
+
+    Entity(int id) { this.id = id; }
+}
+
+class Player : Entity, Updatable
+{
+    int health = 100;
+
+    Player(int id) { super(id); }
+
+    void update() { health -= 1; }
+}
+
+final class Boss : Player
+{
+    Boss(int id) { super(id); }
+}
+
+class Prop : Entity
+{
+    Prop(int id) { super(id); }
+}
+
+void main()
+{
+    array<Entity@> entities = {Player(1), Prop(2), Boss(3), Player(4), null};
+
+    int players = 0;
+    int bosses = 0;
+    int updated = 0;
+
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        for (uint i = 0; i < entities.length(); ++i)
+        {
+            Player@ player = cast<Player>(entities[i]);
+            if (player !is null)
+            {
+                players += 1;
+            }
+
+            if (cast<Boss>(entities[i]) !is null)
+            {
+                bosses += 1;
+            }
+
+            Updatable@ updatable = cast<Updatable>(entities[i]);
+            if (updatable !is null)
+            {
+                updatable.update();
+                updated += 1;
+            }
+        }
+    }
+
+    print(players);
+    print(bosses);
+    print(updated);
+    print(cast<Player>(entities[2]).health);
+}
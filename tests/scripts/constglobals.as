@@ -0,0 +1,13 @@
+int compute_answer()
+{
+    return 6 * 7 + answer_offset;
+}
+
+const int answer = compute_answer();
+const int literal_answer = 42;
+
+void main()
+{
+    print(answer);
+    print(literal_answer);
+}
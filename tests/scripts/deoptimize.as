@@ -0,0 +1,75 @@
+class Shape
+{
+    int area() { return 0; }
+}
+
+class Square : Shape
+{
+    int side;
+
+    Square(int side) { this.side = side; }
+
+    int area() { return side * side; }
+}
+
+class Circle : Shape
+{
+    int area() { return 3; }
+}
+
+class Tracked
+{
+    ~Tracked()
+    {
+        print("released");
+    }
+}
+
+Shape@ square = Square(3);
+Shape@ circle = Circle();
+int circle_from = 1000;
+
+int measure(int count)
+{
+    int total = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        // Only resolves to Square::area until use_circle() is called
+        Shape@ shape = i >= circle_from ? circle : square;
+        total += shape.area() + i;
+    }
+
+    return total;
+}
+
+// Deoptimized with objects and handles in the frame, which the VM takes over
+int measure_tracked(int count)
+{
+    Tracked tracked;
+    Shape@ held = square;
+    int total = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        Shape@ shape = i >= circle_from ? circle : square;
+        total += shape.area() + held.area();
+    }
+
+    return total;
+}
+
+void main()
+{
+    print(measure(10));
+}
+
+void main_tracked()
+{
+    print(measure_tracked(10));
+}
+
+void use_circle()
+{
+    circle_from = 5;
+}
@@ -0,0 +1,47 @@
+class Node
+{
+    int value;
+}
+
+int describe(Node@ node)
+{
+    return node is null ? -1 : node.value;
+}
+
+// Passing null as an argument is not supported by the JIT, so this function is left to the VM
+int count_nulls(int count)
+{
+    int total = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        total += describe(null) == -1 ? 1 : 0;
+    }
+
+    return total;
+}
+
+int unsafe_value(Node@ node)
+{
+    describe(null);
+    return node.value;
+}
+
+void main()
+{
+    Node node;
+    node.value = 42;
+    print(describe(node));
+    print(count_nulls(3));
+
+    Node@ nothing;
+
+    try
+    {
+        unsafe_value(nothing);
+    }
+    catch
+    {
+        print("caught");
+    }
+}
@@ -16,3 +16,41 @@ void test_script()
     SOME_FUNCDEF@ printer = @print_proxy_test;
     printer("hello");
 }
+
+funcdef int BINARY_OP(int, int);
+
+int add(int a, int b) { return a + b; }
+int mul(int a, int b) { return a * b; }
+
+int fold(BINARY_OP@ op, int initial, int count)
+{
+    int result = initial;
+
+    for (int i = 1; i <= count; ++i)
+    {
+        result = op(result, i);
+    }
+
+    return result;
+}
+
+class Accumulator
+{
+    int total = 0;
+
+    int add(int a, int b)
+    {
+        total += b;
+        return a + b;
+    }
+}
+
+void test_callbacks()
+{
+    print(fold(@add, 0, 100));
+    print(fold(@mul, 1, 10));
+
+    Accumulator accumulator;
+    print(fold(BINARY_OP(accumulator.add), 0, 10));
+    print(accumulator.total);
+}
@@ -0,0 +1,4 @@
+int apply(BINARY_OP@ op, int a, int b)
+{
+    return op(a, b);
+}
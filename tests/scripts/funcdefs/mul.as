@@ -0,0 +1,4 @@
+int op(int a, int b)
+{
+    return a * b;
+}
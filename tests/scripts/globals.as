@@ -15,3 +15,28 @@ void assign_read()
     print(g32);
     print(g64);
 }
+
+int compute_answer()
+{
+    return 6 * 7;
+}
+
+const int answer = compute_answer();
+
+void read_const()
+{
+    print(answer);
+}
+
+int accumulator;
+
+void accumulate()
+{
+    for (int i = 0; i < 10; ++i)
+    {
+        accumulator += i;
+        putchar(46);
+    }
+
+    print(accumulator);
+}
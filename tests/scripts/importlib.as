@@ -0,0 +1,9 @@
+int square(int x)
+{
+    return x * x;
+}
+
+int cube(int x)
+{
+    return x * x * x;
+}
@@ -0,0 +1,9 @@
+int negate(int x)
+{
+    return -x;
+}
+
+int opposite(int x)
+{
+    return -x;
+}
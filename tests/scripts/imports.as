@@ -0,0 +1,13 @@
+import int transform(int) from "lib";
+
+void main()
+{
+    int total = 0;
+
+    for (int i = 1; i <= 10; ++i)
+    {
+        total += transform(i);
+    }
+
+    print(total);
+}
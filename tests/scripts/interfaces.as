@@ -0,0 +1,74 @@
+interface Shape
+{
+    int area();
+}
+
+interface Named
+{
+    string name();
+}
+
+class Square : Shape, Named
+{
+    int side;
+
+    Square(int side) { this.side = side; }
+
+    int area() { return side * side; }
+
+    string name() { return "square"; }
+}
+
+class Rectangle : Shape
+{
+    int width;
+    int height;
+
+    Rectangle(int width, int height)
+    {
+        this.width = width;
+        this.height = height;
+    }
+
+    int area() { return width * height; }
+}
+
+// Implements the interfaces through Square, overriding only some of the methods
+class Cube : Square
+{
+    Cube(int side) { super(side); }
+
+    int area() { return 6 * side * side; }
+}
+
+int total_area(array<Shape@>@ shapes)
+{
+    int total = 0;
+
+    for (uint i = 0; i < shapes.length(); ++i)
+    {
+        total += shapes[i].area();
+    }
+
+    return total;
+}
+
+void main()
+{
+    // Always resolves to Square::area
+    Shape@ square = Square(3);
+    int total = 0;
+
+    for (int i = 0; i < 10; ++i)
+    {
+        total += square.area();
+    }
+
+    print(total);
+
+    array<Shape@> shapes = {Square(2), Rectangle(2, 3), Cube(1), Square(4)};
+    print(total_area(shapes));
+
+    Named@ named = Cube(2);
+    print(named.name());
+}
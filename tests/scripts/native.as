@@ -0,0 +1,25 @@
+int fib(int n)
+{
+	if (n < 2)
+	{
+		return n;
+	}
+
+	return fib(n-1) + fib(n-2);
+}
+
+int divide(int a, int b)
+{
+	return a / b;
+}
+
+class Counter
+{
+	int value;
+
+	int add(int amount)
+	{
+		value += amount;
+		return value;
+	}
+}
@@ -0,0 +1,26 @@
+class Counter
+{
+    int value = 0;
+
+    // Every access to a field loads `this`, which is known to be non-null
+    void add(int amount)
+    {
+        value += amount;
+        value += amount;
+    }
+}
+
+void main()
+{
+    Counter counter;
+    Counter@ handle = counter;
+
+    // The handle is checked once, other checks are dominated by the first one
+    for (int i = 0; i < 5; ++i)
+    {
+        handle.add(i);
+        handle.add(1);
+    }
+
+    print(handle.value);
+}
@@ -0,0 +1,11 @@
+void main()
+{
+    int64 total = 0;
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        total += i;
+    }
+
+    print(total);
+}
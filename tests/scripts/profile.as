@@ -0,0 +1,38 @@
+class Shape
+{
+    int area() { return 0; }
+}
+
+class Square : Shape
+{
+    int side;
+
+    Square(int side) { this.side = side; }
+
+    int area() { return side * side; }
+}
+
+void main()
+{
+    Shape@ shape = Square(3);
+    int total = 0;
+
+    for (int i = 0; i < 100; ++i)
+    {
+        // Always resolves to Square::area
+        if (i % 10 == 0)
+        {
+            total += shape.area();
+        }
+
+        switch (i % 4)
+        {
+        case 0: total += 1; break;
+        case 1: total += 2; break;
+        case 2: total += 3; break;
+        default: total += 4; break;
+        }
+    }
+
+    print(total);
+}
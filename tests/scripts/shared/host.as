@@ -0,0 +1,19 @@
+shared interface Shape
+{
+    int area();
+}
+
+shared interface Item
+{
+}
+
+int measure(Shape@ shape)
+{
+    return shape.area();
+}
+
+int measure_item(Item@ item)
+{
+    Shape@ shape = cast<Shape>(item);
+    return shape is null ? -1 : shape.area();
+}
@@ -0,0 +1,28 @@
+shared interface Shape
+{
+    int area();
+}
+
+shared interface Item
+{
+}
+
+class Rectangle : Shape
+{
+    int area() { return 12; }
+}
+
+// Not a shape, so that casting it must not hit a cache filled for a discarded class
+class Label : Item
+{
+}
+
+Shape@ make()
+{
+    return Rectangle();
+}
+
+Item@ make_item()
+{
+    return Label();
+}
@@ -0,0 +1,23 @@
+shared interface Shape
+{
+    int area();
+}
+
+shared interface Item
+{
+}
+
+class Square : Shape, Item
+{
+    int area() { return 9; }
+}
+
+Shape@ make()
+{
+    return Square();
+}
+
+Item@ make_item()
+{
+    return Square();
+}
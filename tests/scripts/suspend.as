@@ -0,0 +1,44 @@
+class Tracked
+{
+    ~Tracked()
+    {
+        print("released");
+    }
+}
+
+int sum(int count)
+{
+    int total = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        total += i;
+    }
+
+    return total;
+}
+
+void main()
+{
+    Tracked tracked;
+    print(sum(10));
+}
+
+void spin()
+{
+    Tracked tracked;
+
+    while (true)
+    {
+    }
+}
+
+void recurse()
+{
+    recurse();
+}
+
+int recurse_deep(int depth)
+{
+    return recurse_deep(depth + 1) + 1;
+}
@@ -0,0 +1,37 @@
+int count_down(int n, int accumulator)
+{
+    if (n == 0)
+    {
+        return accumulator;
+    }
+
+    return count_down(n - 1, accumulator + 2);
+}
+
+// Mutual recursion with different signatures
+bool is_even(uint n)
+{
+    if (n == 0)
+    {
+        return true;
+    }
+
+    return is_odd(n - 1, 0);
+}
+
+bool is_odd(uint n, int unused)
+{
+    if (n == 0)
+    {
+        return false;
+    }
+
+    return is_even(n - 1);
+}
+
+void main()
+{
+    // Deep enough to overflow the native stack without tail calls
+    print(count_down(1000000, 0));
+    print(is_even(1000001) ? "even" : "odd");
+}
@@ -0,0 +1,118 @@
+funcdef void CALLBACK();
+
+class Tracked
+{
+    string name;
+
+    Tracked(const string &in name)
+    {
+        this.name = name;
+    }
+
+    ~Tracked()
+    {
+        print("released " + name);
+    }
+
+    void report()
+    {
+        print("reported " + name);
+    }
+}
+
+CALLBACK@ track(const string &in name)
+{
+    // Only the delegate keeps the object alive once this returns
+    Tracked tracked(name);
+    return CALLBACK(tracked.report);
+}
+
+int divide(int a, int b)
+{
+    // Not caught here, but still released when unwinding
+    Tracked callee("callee");
+    return a / b;
+}
+
+void main()
+{
+    Tracked outer("outer");
+
+    try
+    {
+        Tracked inner("inner");
+        int zero = 0;
+        print(10 / zero);
+    }
+    catch
+    {
+        print("caught division");
+    }
+
+    try
+    {
+        Tracked@ handle = null;
+        print(handle.name);
+    }
+    catch
+    {
+        print("caught null access");
+    }
+
+    try
+    {
+        print(divide(1, 0));
+    }
+    catch
+    {
+        print("caught from callee");
+    }
+
+    try
+    {
+        try
+        {
+            Tracked nested("nested");
+            divide(2, 0);
+        }
+        catch
+        {
+            print("caught inner");
+            int zero = 0;
+            print(1 / zero);
+        }
+    }
+    catch
+    {
+        print("caught outer");
+    }
+
+    print("done");
+}
+
+int divide_with_callback(int a, int b)
+{
+    CALLBACK@ callback = track("delegated callee");
+    return a / b;
+}
+
+void main_callback()
+{
+    try
+    {
+        CALLBACK@ callback = track("delegated");
+        callback();
+        print(divide_with_callback(1, 0));
+    }
+    catch
+    {
+        print("caught callback");
+    }
+}
+
+void main_uncaught()
+{
+    Tracked uncaught("uncaught");
+    int zero = 0;
+    print(1 / zero);
+}
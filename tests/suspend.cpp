@@ -0,0 +1,237 @@
+#include "common.hpp"
+
+namespace
+{
+void suspend_line_callback(asIScriptContext* context, int* callbacks)
+{
+	++*callbacks;
+	context->Suspend();
+}
+
+void suspend_late_line_callback(asIScriptContext* context, int* callbacks)
+{
+	if (++*callbacks >= 10)
+	{
+		context->Suspend();
+	}
+}
+
+void abort_line_callback(asIScriptContext* context, int* callbacks)
+{
+	if (++*callbacks == 1000)
+	{
+		context->Abort();
+	}
+}
+} // namespace
+
+TEST_CASE("suspend and resume", "[suspend]")
+{
+	asllvm::JitConfig config = default_jit_config();
+	config.allow_suspend     = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/suspend.as");
+	context.prepare_execution();
+
+	asIScriptFunction* main = module.GetFunctionByDecl("void main()");
+	asllvm_test_check(main != nullptr);
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+
+	int callbacks = 0;
+	asllvm_test_check(
+		script_context->SetLineCallback(asFUNCTION(suspend_line_callback), &callbacks, asCALL_CDECL) >= 0);
+	asllvm_test_check(script_context->Prepare(main) >= 0);
+
+	// The script is suspended at every safepoint, i.e. function entries and loop iterations
+	int suspensions = 0;
+	while (script_context->Execute() == asEXECUTION_SUSPENDED)
+	{
+		++suspensions;
+	}
+
+	REQUIRE(script_context->GetState() == asEXECUTION_FINISHED);
+	REQUIRE(suspensions >= 12);
+	REQUIRE(callbacks >= suspensions);
+	REQUIRE(out.str() == "45\nreleased\n");
+
+	// Releasing the context discards the suspended script, releasing its objects
+	asIScriptFunction* spin = module.GetFunctionByDecl("void spin()");
+	asllvm_test_check(spin != nullptr);
+
+	out = {};
+	asllvm_test_check(script_context->Prepare(spin) >= 0);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		REQUIRE(script_context->Execute() == asEXECUTION_SUSPENDED);
+	}
+
+	REQUIRE(out.str().empty());
+	script_context->Release();
+	REQUIRE(out.str() == "released\n");
+}
+
+TEST_CASE("abort from line callback", "[suspend]")
+{
+	EngineContext context(default_jit_config());
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/suspend.as");
+	context.prepare_execution();
+
+	asIScriptFunction* spin = module.GetFunctionByDecl("void spin()");
+	asllvm_test_check(spin != nullptr);
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+
+	int callbacks = 0;
+	asllvm_test_check(script_context->SetLineCallback(asFUNCTION(abort_line_callback), &callbacks, asCALL_CDECL) >= 0);
+	asllvm_test_check(script_context->Prepare(spin) >= 0);
+
+	REQUIRE(script_context->Execute() == asEXECUTION_ABORTED);
+	REQUIRE(callbacks == 1000);
+	REQUIRE(out.str() == "released\n");
+
+	script_context->Release();
+}
+
+TEST_CASE("execution budget", "[suspend]")
+{
+	asllvm::JitConfig config        = default_jit_config();
+	config.enforce_execution_budget = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/suspend.as");
+	context.prepare_execution();
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+
+	SECTION("within budget")
+	{
+		asIScriptFunction* main = module.GetFunctionByDecl("void main()");
+		asllvm_test_check(main != nullptr);
+
+		REQUIRE(context.jit.SetExecutionBudget(script_context, 1'000'000) == asSUCCESS);
+		asllvm_test_check(script_context->Prepare(main) >= 0);
+
+		REQUIRE(script_context->Execute() == asEXECUTION_FINISHED);
+		REQUIRE(out.str() == "45\nreleased\n");
+	}
+
+	SECTION("iteration budget")
+	{
+		asIScriptFunction* spin = module.GetFunctionByDecl("void spin()");
+		asllvm_test_check(spin != nullptr);
+
+		REQUIRE(context.jit.SetExecutionBudget(script_context, 1'000'000) == asSUCCESS);
+		asllvm_test_check(script_context->Prepare(spin) >= 0);
+
+		REQUIRE(script_context->Execute() == asEXECUTION_ABORTED);
+		REQUIRE(out.str() == "released\n");
+	}
+
+	SECTION("time budget")
+	{
+		asIScriptFunction* spin = module.GetFunctionByDecl("void spin()");
+		asllvm_test_check(spin != nullptr);
+
+		REQUIRE(context.jit.SetExecutionBudget(script_context, 0, std::chrono::milliseconds(50)) == asSUCCESS);
+		asllvm_test_check(script_context->Prepare(spin) >= 0);
+
+		REQUIRE(script_context->Execute() == asEXECUTION_ABORTED);
+		REQUIRE(out.str() == "released\n");
+	}
+
+	SECTION("recursion budget")
+	{
+		// Calls are budgeted like loop iterations, whether or not recursion turns into a loop through tail calls
+		for (const char* declaration : {"void recurse()", "int recurse_deep(int)"})
+		{
+			asIScriptFunction* recurse = module.GetFunctionByDecl(declaration);
+			asllvm_test_check(recurse != nullptr);
+
+			REQUIRE(context.jit.SetExecutionBudget(script_context, 10'000) == asSUCCESS);
+			asllvm_test_check(script_context->Prepare(recurse) >= 0);
+
+			REQUIRE(script_context->Execute() == asEXECUTION_ABORTED);
+		}
+	}
+
+	script_context->Release();
+}
+
+TEST_CASE("on-stack replacement", "[suspend][osr]")
+{
+	asllvm::JitConfig config        = default_jit_config();
+	config.allow_osr                = true;
+	config.enforce_execution_budget = true;
+
+	EngineContext context(config);
+
+	out = {};
+
+	asIScriptModule& module = context.build("build", "scripts/osr.as");
+
+	asIScriptFunction* main = module.GetFunctionByDecl("void main()");
+	asllvm_test_check(main != nullptr);
+
+	asIScriptContext* script_context = context.engine->CreateContext();
+
+	// Start interpreting the function before it is built, and build it while it is suspended
+	int callbacks = 0;
+	asllvm_test_check(
+		script_context->SetLineCallback(asFUNCTION(suspend_line_callback), &callbacks, asCALL_CDECL) >= 0);
+	asllvm_test_check(script_context->Prepare(main) >= 0);
+
+	REQUIRE(script_context->Execute() == asEXECUTION_SUSPENDED);
+
+	script_context->ClearLineCallback();
+	context.prepare_execution();
+
+	SECTION("result")
+	{
+		// Without JitConfig::allow_suspend, JIT'd code only gets suspended once it returns to the VM, so the loop
+		// only finishes if it switched to JIT'd code. The VM would be suspended within its first iterations.
+		callbacks = 0;
+		asllvm_test_check(
+			script_context->SetLineCallback(asFUNCTION(suspend_late_line_callback), &callbacks, asCALL_CDECL) >= 0);
+
+		const int status = script_context->Execute();
+		REQUIRE(out.str() == "4999950000\n");
+
+		script_context->ClearLineCallback();
+		if (status == asEXECUTION_SUSPENDED)
+		{
+			REQUIRE(script_context->Execute() == asEXECUTION_FINISHED);
+		}
+	}
+
+	SECTION("loop switches to JIT'd code")
+	{
+		// Only JIT'd code consumes the execution budget, so the loop would finish if the VM kept interpreting it
+		REQUIRE(context.jit.SetExecutionBudget(script_context, 10'000) == asSUCCESS);
+		REQUIRE(script_context->Execute() == asEXECUTION_ABORTED);
+		REQUIRE(out.str().empty());
+	}
+
+	script_context->Release();
+}
+
+TEST_CASE("regular calls with on-stack replacement", "[suspend][osr]")
+{
+	asllvm::JitConfig config = default_jit_config();
+	config.allow_osr         = true;
+
+	// Functions with an OSR variant are still entered at their start when called once built
+	EngineContext context(config);
+	REQUIRE(run(context, "scripts/osr.as") == "4999950000\n");
+}